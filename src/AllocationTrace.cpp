@@ -0,0 +1,413 @@
+/**
+ * \file AllocationTrace.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the allocation trace writer and reader
+ */
+
+#include "AllocationTrace.h"
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <system_error>
+
+namespace {
+  const size_t MAGIC_SIZE = sizeof(AllocationTrace::MAGIC) - 1; // Without the terminator
+
+  /*!
+   * \brief Reads the clock the records are timed with
+   *
+   * \return steady_clock nanoseconds
+   */
+  uint64_t trace_clock() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+  }
+} // namespace
+
+/*!
+ * \brief Creates the trace file and starts the background thread. Check Good for the outcome.
+ *
+ * \param path Where to write the trace, replaced if it exists
+ * \param object_size The object size of the traced allocator, recorded for the replay
+ */
+TraceWriter::TraceWriter(const char *path, size_t object_size) :
+    file(path, std::ios::binary | std::ios::trunc), mutex(), handed(), written(), filling(), pending(), writing(false),
+    stopping(false), good(false), records(0), last_time(trace_clock()), live_objects(), free_slots(), slot_count(0),
+    label_ids(), last_label(nullptr), last_label_text(nullptr), last_label_id(0), writer() {
+  if (!file) {
+    return;
+  }
+
+  try {
+    filling.reserve(BUFFER_SIZE + 64);
+    pending.reserve(BUFFER_SIZE + 64);
+    filling.insert(filling.end(), AllocationTrace::MAGIC, AllocationTrace::MAGIC + MAGIC_SIZE);
+    encode(object_size);
+
+    writer = std::thread(&TraceWriter::write_loop, this);
+    good = true;
+
+  } catch (const std::bad_alloc &) {
+  } catch (const std::system_error &) {
+  }
+}
+
+/*!
+ * \brief Writes what is left and closes the file (never throws)
+ */
+TraceWriter::~TraceWriter() {
+  if (!writer.joinable()) {
+    return;
+  }
+
+  Flush();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  handed.notify_one();
+  writer.join();
+}
+
+/*!
+ * \brief Records an allocation
+ *
+ * \param object The object handed to the client
+ * \param label The label it was allocated with, may be nullptr
+ */
+void TraceWriter::RecordAllocate(const void *object, const char *label) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!good) {
+    return;
+  }
+
+  try {
+    unsigned id = label_id(label);
+
+    unsigned slot;
+    if (!free_slots.empty()) {
+      slot = free_slots.back();
+      free_slots.pop_back();
+    } else {
+      slot = slot_count++;
+    }
+
+    // A live address allocated again was freed without being recorded, the newer allocation wins
+    live_objects[object] = slot;
+
+    encode(AllocationTrace::trAllocate);
+    encode(slot);
+    encode(id);
+    encode_time();
+
+  } catch (const std::bad_alloc &) {
+    good = false;
+    return;
+  }
+
+  records++;
+
+  if (filling.size() >= BUFFER_SIZE) {
+    hand_off(lock);
+  }
+}
+
+/*!
+ * \brief Records a free. Call it before the object is released, so another thread reusing the address is recorded
+ * after it. Objects the writer never saw allocated are ignored.
+ *
+ * \param object The object returned by the client
+ */
+void TraceWriter::RecordFree(const void *object) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  auto position = live_objects.find(object);
+  if (!good || position == live_objects.end()) {
+    return;
+  }
+
+  unsigned slot = position->second;
+  live_objects.erase(position);
+
+  try {
+    free_slots.push_back(slot);
+
+    encode(AllocationTrace::trFree);
+    encode(slot);
+    encode_time();
+
+  } catch (const std::bad_alloc &) {
+    good = false;
+    return;
+  }
+
+  records++;
+
+  if (filling.size() >= BUFFER_SIZE) {
+    hand_off(lock);
+  }
+}
+
+/*!
+ * \brief Waits until every record so far is in the file
+ */
+void TraceWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!writer.joinable()) {
+    return;
+  }
+
+  if (!filling.empty()) {
+    hand_off(lock);
+  }
+
+  written.wait(lock, [this]() { return pending.empty() && !writing; });
+  file.flush();
+
+  if (!file) {
+    good = false;
+  }
+}
+
+/*!
+ * \brief Returns whether every record so far made it to the trace
+ *
+ * \return False once the file couldn't be written or the writer ran out of memory
+ */
+bool TraceWriter::Good() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return good;
+}
+
+/*!
+ * \brief Returns how many allocations and frees were recorded
+ *
+ * \return The record count
+ */
+uint64_t TraceWriter::GetRecords() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return records;
+}
+
+/*!
+ * \brief Appends a varint to the buffer being filled
+ *
+ * \param value The value to encode
+ */
+void TraceWriter::encode(uint64_t value) {
+  while (value >= 0x80) {
+    filling.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+
+  filling.push_back(static_cast<unsigned char>(value));
+}
+
+/*!
+ * \brief Encodes the time since the previous record
+ */
+void TraceWriter::encode_time() {
+  uint64_t now = trace_clock();
+
+  encode(now - last_time);
+  last_time = now;
+}
+
+/*!
+ * \brief Returns the id of a label, defining it in the trace the first time. Throws std::bad_alloc if there is no
+ * memory.
+ *
+ * \param label The label, may be nullptr
+ * \return The id of the label, 0 for nullptr
+ */
+unsigned TraceWriter::label_id(const char *label) {
+  if (label == nullptr) {
+    return 0;
+  }
+
+  // The same pointer may hold a different string by now, so the contents are still compared
+  if (label == last_label && strcmp(label, last_label_text) == 0) {
+    return last_label_id;
+  }
+
+  std::string text(label);
+  auto position = label_ids.find(text);
+
+  if (position == label_ids.end()) {
+    unsigned id = static_cast<unsigned>(label_ids.size() + 1);
+    position = label_ids.emplace(text, id).first;
+
+    encode(AllocationTrace::trLabel);
+    encode(id);
+    encode(text.size());
+    filling.insert(filling.end(), text.begin(), text.end());
+  }
+
+  last_label = label;
+  last_label_text = position->first.c_str();
+  last_label_id = position->second;
+  return last_label_id;
+}
+
+/*!
+ * \brief Hands the buffer being filled to the background thread, once the previous one was written
+ *
+ * \param lock The lock on mutex, released while waiting
+ */
+void TraceWriter::hand_off(std::unique_lock<std::mutex> &lock) {
+  written.wait(lock, [this]() { return pending.empty(); });
+
+  // Both buffers keep their capacity, so the steady state doesn't allocate
+  filling.swap(pending);
+  handed.notify_one();
+}
+
+/*!
+ * \brief Body of the background thread, writes the buffers handed to it until the writer is destroyed
+ */
+void TraceWriter::write_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  for (;;) {
+    handed.wait(lock, [this]() { return !pending.empty() || stopping; });
+
+    if (pending.empty()) {
+      return;
+    }
+
+    writing = true;
+    lock.unlock();
+
+    // Only this thread touches pending while writing is set
+    file.write(reinterpret_cast<const char *>(pending.data()), static_cast<std::streamsize>(pending.size()));
+    bool failed = !file;
+
+    lock.lock();
+    pending.clear();
+    writing = false;
+    if (failed) {
+      good = false;
+    }
+
+    written.notify_all();
+  }
+}
+
+/*!
+ * \brief Loads a trace. Check Good for the outcome.
+ *
+ * \param path The trace file
+ */
+TraceReader::TraceReader(const char *path) : data(), position(0), object_size(0), good(false), labels(1) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return;
+  }
+
+  data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+  uint64_t size = 0;
+  if (data.size() < MAGIC_SIZE || memcmp(data.data(), AllocationTrace::MAGIC, MAGIC_SIZE) != 0) {
+    return;
+  }
+
+  position = MAGIC_SIZE;
+  good = decode(size);
+  object_size = static_cast<size_t>(size);
+}
+
+/*!
+ * \brief Reads the next allocation or free
+ *
+ * \param record Receives the record
+ * \return False at the end of the trace or if the rest of it is malformed (then Good turns false)
+ */
+bool TraceReader::Next(AllocationTrace::Record &record) {
+  while (good && position < data.size()) {
+    uint64_t type = 0;
+    uint64_t object = 0;
+    uint64_t label = 0;
+    uint64_t nanoseconds = 0;
+
+    good = decode(type);
+
+    if (good && type == AllocationTrace::trLabel) {
+      uint64_t length = 0;
+      good = decode(label) && decode(length) && label == labels.size() && length <= data.size() - position;
+
+      if (good) {
+        labels.push_back(std::string(data.begin() + static_cast<std::ptrdiff_t>(position),
+                                     data.begin() + static_cast<std::ptrdiff_t>(position + length)));
+        position += static_cast<size_t>(length);
+      }
+      continue;
+    }
+
+    good = good && decode(object) && (type != AllocationTrace::trAllocate || decode(label)) && decode(nanoseconds) &&
+           (type == AllocationTrace::trAllocate || type == AllocationTrace::trFree) && object <= UINT32_MAX &&
+           label < labels.size();
+
+    if (good) {
+      record.Type_ = static_cast<AllocationTrace::RECORD_TYPE>(type);
+      record.Object_ = static_cast<unsigned>(object);
+      record.Label_ = static_cast<unsigned>(label);
+      record.Nanoseconds_ = nanoseconds;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*!
+ * \brief Returns a label defined by the records read so far
+ *
+ * \param id The label id of a record
+ * \return The label, nullptr for id 0 or an unknown id
+ */
+const char *TraceReader::GetLabel(unsigned id) const {
+  return id != 0 && id < labels.size() ? labels[id].c_str() : nullptr;
+}
+
+/*!
+ * \brief Returns the object size recorded in the trace
+ *
+ * \return The object size
+ */
+size_t TraceReader::GetObjectSize() const { return object_size; }
+
+/*!
+ * \brief Returns whether the trace was loaded and is well formed so far
+ *
+ * \return False if the file couldn't be read or is malformed
+ */
+bool TraceReader::Good() const { return good; }
+
+/*!
+ * \brief Reads a varint
+ *
+ * \param value Receives the value
+ * \return False if the trace ended in the middle of it or it doesn't fit in 64 bits
+ */
+bool TraceReader::decode(uint64_t &value) {
+  value = 0;
+
+  for (unsigned shift = 0; shift < 64 && position < data.size(); shift += 7) {
+    unsigned char byte = data[position++];
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
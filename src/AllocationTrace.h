@@ -0,0 +1,240 @@
+/**
+ * @file AllocationTrace.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Binary traces of the Allocate/Free calls made to an ObjectAllocator, written live and read back by replay_c
+ */
+
+//---------------------------------------------------------------------------
+#ifndef ALLOCATIONTRACEH
+#define ALLOCATIONTRACEH
+//---------------------------------------------------------------------------
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*!
+  What a trace holds. Every integer of the file is an unsigned LEB128 varint:
+
+    "OATRACE1", object size
+    trAllocate: type, object, label id (0 = no label), nanoseconds since the previous record
+    trFree: type, object, nanoseconds since the previous record
+    trLabel: type, label id, length, the characters (right before the first allocation with that label)
+
+  Objects are numbered by slot, the number of a freed object is reused by the next allocation, so a replay needs a
+  table as large as the peak of live objects.
+*/
+namespace AllocationTrace {
+  static const char MAGIC[] = "OATRACE1"; //!< The first bytes of every trace
+
+  /*!
+    The kinds of record
+  */
+  enum RECORD_TYPE {
+    trAllocate, //!< an object was allocated
+    trFree, //!< an object was freed
+    trLabel //!< a label id was defined
+  };
+
+  /*!
+    POD that holds an Allocate or a Free of a trace
+  */
+  struct Record {
+    RECORD_TYPE Type_; //!< trAllocate or trFree
+    unsigned Object_; //!< the slot number of the object
+    unsigned Label_; //!< the label id of a trAllocate, see TraceReader::GetLabel
+    uint64_t Nanoseconds_; //!< time since the previous record
+  };
+} // namespace AllocationTrace
+
+/*!
+  Streams the Allocate/Free calls of the allocators it is given to (see OAConfig::TraceWriter_) into a trace file.
+  Records are encoded into a buffer, and full buffers are written by a background thread, so the allocating thread
+  only waits on the disk when the writer falls a whole buffer behind. Thread safe. The writer has to outlive every
+  allocator tracing into it.
+
+  A trace problem never fails the allocator: if the file can't be written or the bookkeeping runs out of memory, the
+  writer stops recording and Good turns false.
+*/
+class TraceWriter {
+public:
+  static const size_t BUFFER_SIZE = 64 * 1024; //!< Bytes encoded before a buffer is handed to the background thread
+
+  /*!
+   * \brief Creates the trace file and starts the background thread. Check Good for the outcome.
+   *
+   * \param path Where to write the trace, replaced if it exists
+   * \param object_size The object size of the traced allocator, recorded for the replay
+   */
+  TraceWriter(const char *path, size_t object_size);
+
+  /*!
+   * \brief Writes what is left and closes the file (never throws)
+   */
+  ~TraceWriter();
+
+  /*!
+   * \brief Records an allocation
+   *
+   * \param object The object handed to the client
+   * \param label The label it was allocated with, may be nullptr
+   */
+  void RecordAllocate(const void *object, const char *label);
+
+  /*!
+   * \brief Records a free. Call it before the object is released, so another thread reusing the address is recorded
+   * after it. Objects the writer never saw allocated are ignored.
+   *
+   * \param object The object returned by the client
+   */
+  void RecordFree(const void *object);
+
+  /*!
+   * \brief Waits until every record so far is in the file
+   */
+  void Flush();
+
+  /*!
+   * \brief Returns whether every record so far made it to the trace
+   *
+   * \return False once the file couldn't be written or the writer ran out of memory
+   */
+  bool Good() const;
+
+  /*!
+   * \brief Returns how many allocations and frees were recorded
+   *
+   * \return The record count
+   */
+  uint64_t GetRecords() const;
+
+  // Prevent copy construction and assignment
+  TraceWriter(const TraceWriter &writer) = delete; //!< Do not implement!
+  TraceWriter &operator=(const TraceWriter &writer) = delete; //!< Do not implement!
+
+private:
+  /*!
+   * \brief Appends a varint to the buffer being filled
+   *
+   * \param value The value to encode
+   */
+  void encode(uint64_t value);
+
+  /*!
+   * \brief Encodes the time since the previous record
+   */
+  void encode_time();
+
+  /*!
+   * \brief Returns the id of a label, defining it in the trace the first time. Throws std::bad_alloc if there is no
+   * memory.
+   *
+   * \param label The label, may be nullptr
+   * \return The id of the label, 0 for nullptr
+   */
+  unsigned label_id(const char *label);
+
+  /*!
+   * \brief Hands the buffer being filled to the background thread, once the previous one was written
+   *
+   * \param lock The lock on mutex, released while waiting
+   */
+  void hand_off(std::unique_lock<std::mutex> &lock);
+
+  /*!
+   * \brief Body of the background thread, writes the buffers handed to it until the writer is destroyed
+   */
+  void write_loop();
+
+  std::ofstream file; //!< The trace
+  mutable std::mutex mutex; //!< Guards everything below
+  std::condition_variable handed; //!< Signaled when a buffer is handed off or the writer stops
+  std::condition_variable written; //!< Signaled when the background thread finished a buffer
+  std::vector<unsigned char> filling; //!< The buffer records are encoded into
+  std::vector<unsigned char> pending; //!< The buffer handed to the background thread, empty once written
+  bool writing; //!< Whether the background thread is writing pending
+  bool stopping; //!< Tells the background thread to finish
+  bool good; //!< Whether every record made it to the trace
+  uint64_t records; //!< Allocations and frees recorded
+  uint64_t last_time; //!< steady_clock nanoseconds of the previous record
+
+  std::unordered_map<const void *, unsigned> live_objects; //!< Slot number of every live object
+  std::vector<unsigned> free_slots; //!< Slot numbers of freed objects, reused first
+  unsigned slot_count; //!< Slot numbers handed out so far
+
+  std::unordered_map<std::string, unsigned> label_ids; //!< Id of every label defined so far
+  const char *last_label; //!< The label of the previous lookup, most callers pass the same literal over and over
+  const char *last_label_text; //!< The defined copy of last_label, map keys never move
+  unsigned last_label_id; //!< The id of last_label
+
+  std::thread writer; //!< The background thread, started last
+};
+
+/*!
+  Reads a trace written by TraceWriter, one allocation or free at a time
+*/
+class TraceReader {
+public:
+  /*!
+   * \brief Loads a trace. Check Good for the outcome.
+   *
+   * \param path The trace file
+   */
+  explicit TraceReader(const char *path);
+
+  /*!
+   * \brief Reads the next allocation or free
+   *
+   * \param record Receives the record
+   * \return False at the end of the trace or if the rest of it is malformed (then Good turns false)
+   */
+  bool Next(AllocationTrace::Record &record);
+
+  /*!
+   * \brief Returns a label defined by the records read so far
+   *
+   * \param id The label id of a record
+   * \return The label, nullptr for id 0 or an unknown id
+   */
+  const char *GetLabel(unsigned id) const;
+
+  /*!
+   * \brief Returns the object size recorded in the trace
+   *
+   * \return The object size
+   */
+  size_t GetObjectSize() const;
+
+  /*!
+   * \brief Returns whether the trace was loaded and is well formed so far
+   *
+   * \return False if the file couldn't be read or is malformed
+   */
+  bool Good() const;
+
+private:
+  /*!
+   * \brief Reads a varint
+   *
+   * \param value Receives the value
+   * \return False if the trace ended in the middle of it or it doesn't fit in 64 bits
+   */
+  bool decode(uint64_t &value);
+
+  std::vector<unsigned char> data; //!< The whole trace
+  size_t position; //!< The next byte to decode
+  size_t object_size; //!< From the start of the trace
+  bool good; //!< Whether the trace is well formed so far
+  std::vector<std::string> labels; //!< Indexed by label id, entry 0 unused
+};
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * \file FlightRecorder.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the allocator flight recorder
+ */
+
+#include "FlightRecorder.h"
+#include <new>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <x86intrin.h>
+  #define OA_FLIGHT_TSC 1
+#else
+  #include <chrono>
+  #define OA_FLIGHT_TSC 0
+#endif
+
+namespace {
+  /*!
+   * \brief Reads the clock the events are stamped with
+   *
+   * \return The time stamp counter on x86, steady_clock ticks elsewhere
+   */
+  uint64_t flight_clock() {
+#if OA_FLIGHT_TSC
+    // Unlike steady_clock this never leaves user mode, and it's only used for the order and spacing of events
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+  }
+
+  /*!
+   * \brief Returns the number of the calling thread, numbered from 1 in the order threads first ask for one
+   *
+   * \return The thread number
+   */
+  unsigned thread_number() {
+    static std::atomic<unsigned> next_number(1);
+    static thread_local unsigned number = next_number.fetch_add(1, std::memory_order_relaxed);
+
+    return number;
+  }
+} // namespace
+
+/*!
+ * \brief Creates a ring with every slot empty. Throws an exception if there is no memory. (Memory allocation
+ * problem)
+ *
+ * \param capacity How many events to keep, rounded up to a power of two
+ * \param shared Whether several threads record at once
+ */
+FlightRecorder::FlightRecorder(unsigned capacity, bool shared) : mask(0), shared(shared), slots(), next(0) {
+  while (mask + 1 < capacity) {
+    mask = (mask << 1) | 1;
+  }
+
+  try {
+    // Value-initialized, so every sequence starts at 0 (empty)
+    slots.reset(new Slot[mask + 1]());
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the flight recorder.");
+  }
+}
+
+/*!
+ * \brief Records an event, overwriting the oldest one once the ring is full
+ *
+ * \param type What happened
+ * \param address The object or the page
+ * \param alloc_num The allocation number, 0 if there is none
+ */
+void FlightRecorder::Record(FlightEvent::EVENT_TYPE type, const void *address, unsigned alloc_num) {
+  uint64_t position;
+
+  if (shared) {
+    position = next.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    position = next.load(std::memory_order_relaxed);
+    next.store(position + 1, std::memory_order_relaxed);
+  }
+
+  Slot &slot = slots[position & mask];
+
+  // Readers see the slot as empty until the sequence is published again
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.timestamp.store(flight_clock(), std::memory_order_relaxed);
+  slot.address.store(address, std::memory_order_relaxed);
+  slot.alloc_num.store(alloc_num, std::memory_order_relaxed);
+  slot.thread.store(thread_number(), std::memory_order_relaxed);
+  slot.type.store(static_cast<unsigned>(type), std::memory_order_relaxed);
+
+  slot.sequence.store(position + 1, std::memory_order_release);
+}
+
+/*!
+ * \brief Copies the events still in the ring. Throws an exception if there is no memory for the result. (Memory
+ * allocation problem)
+ *
+ * \return The events, oldest first
+ */
+std::vector<FlightEvent> FlightRecorder::GetEvents() const {
+  uint64_t end = next.load(std::memory_order_acquire);
+  uint64_t begin = end > mask + 1 ? end - (mask + 1) : 0;
+
+  std::vector<FlightEvent> output;
+
+  try {
+    output.reserve(static_cast<size_t>(end - begin));
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while copying the flight recorder.");
+  }
+
+  for (uint64_t position = begin; position < end; position++) {
+    const Slot &slot = slots[position & mask];
+
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+    FlightEvent event;
+    event.Type_ = static_cast<FlightEvent::EVENT_TYPE>(slot.type.load(std::memory_order_relaxed));
+    event.Address_ = slot.address.load(std::memory_order_relaxed);
+    event.AllocNum_ = slot.alloc_num.load(std::memory_order_relaxed);
+    event.Thread_ = slot.thread.load(std::memory_order_relaxed);
+    event.Timestamp_ = slot.timestamp.load(std::memory_order_relaxed);
+
+    // A writer that got to the slot meanwhile changed the sequence, and the copy may be torn
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence != position + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+
+    output.push_back(event);
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Returns how many events the ring keeps
+ *
+ * \return The capacity, a power of two
+ */
+unsigned FlightRecorder::GetCapacity() const { return static_cast<unsigned>(mask + 1); }
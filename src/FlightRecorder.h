@@ -0,0 +1,86 @@
+/**
+ * @file FlightRecorder.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Fixed-size ring of the most recent allocator events
+ */
+
+//---------------------------------------------------------------------------
+#ifndef FLIGHTRECORDERH
+#define FLIGHTRECORDERH
+//---------------------------------------------------------------------------
+
+#include "ObjectAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*!
+  Keeps the last few events of an allocator, overwriting the oldest one. Recording an event is a handful of stores
+  into the next slot, nothing is allocated after construction. Each slot carries the sequence number of its event,
+  written last, so a reader skips the slots being overwritten while it copies them instead of returning torn events.
+  With a single writer the ring position is a plain counter, shared rings take it with an atomic increment.
+*/
+class FlightRecorder {
+public:
+  /*!
+   * \brief Creates a ring with every slot empty. Throws an exception if there is no memory. (Memory allocation
+   * problem)
+   *
+   * \param capacity How many events to keep, rounded up to a power of two
+   * \param shared Whether several threads record at once
+   */
+  FlightRecorder(unsigned capacity, bool shared);
+
+  /*!
+   * \brief Records an event, overwriting the oldest one once the ring is full
+   *
+   * \param type What happened
+   * \param address The object or the page
+   * \param alloc_num The allocation number, 0 if there is none
+   */
+  void Record(FlightEvent::EVENT_TYPE type, const void *address, unsigned alloc_num);
+
+  /*!
+   * \brief Copies the events still in the ring. Throws an exception if there is no memory for the result. (Memory
+   * allocation problem)
+   *
+   * \return The events, oldest first
+   */
+  std::vector<FlightEvent> GetEvents() const;
+
+  /*!
+   * \brief Returns how many events the ring keeps
+   *
+   * \return The capacity, a power of two
+   */
+  unsigned GetCapacity() const;
+
+  // Prevent copy construction and assignment
+  FlightRecorder(const FlightRecorder &recorder) = delete; //!< Do not implement!
+  FlightRecorder &operator=(const FlightRecorder &recorder) = delete; //!< Do not implement!
+
+private:
+  /*!
+    One event. The fields are relaxed atomics so a reader racing a writer is well defined, they compile to plain
+    loads and stores.
+  */
+  struct Slot {
+    std::atomic<uint64_t> sequence; //!< Position of the event in the ring plus 1, 0 while empty or being written
+    std::atomic<uint64_t> timestamp; //!< FlightEvent::Timestamp_
+    std::atomic<const void *> address; //!< FlightEvent::Address_
+    std::atomic<unsigned> alloc_num; //!< FlightEvent::AllocNum_
+    std::atomic<unsigned> thread; //!< FlightEvent::Thread_
+    std::atomic<unsigned> type; //!< FlightEvent::Type_
+  };
+
+  uint64_t mask; //!< Capacity minus 1, maps a position to its slot
+  bool shared; //!< Whether positions are taken with an atomic increment
+  std::unique_ptr<Slot[]> slots; //!< The ring
+  std::atomic<uint64_t> next; //!< Position of the next event
+};
+
+#endif
@@ -0,0 +1,210 @@
+/**
+ * \file HeaderPool.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the external header pool and label interning
+ */
+
+#include "HeaderPool.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+/*!
+ * \brief Creates an empty pool, no record is allocated until the first header
+ *
+ * \param records_per_chunk How many records the pool grows by, at least 1
+ */
+HeaderPool::HeaderPool(unsigned records_per_chunk) :
+    records_per_chunk(records_per_chunk > 0 ? records_per_chunk : 1), free_records(nullptr), record_chunks(),
+    arena_position(nullptr), arena_end(nullptr), arena_chunks(), label_entries(1, LabelEntry{nullptr, 0, 0}),
+    label_ids(), last_label(nullptr), last_label_id(NO_LABEL) {}
+
+/*!
+ * \brief Creates a header. Throws an exception if the pool can't grow. (Memory allocation problem)
+ *
+ * \param label The label, interned on first use, may be nullptr
+ * \param alloc_num The allocation number to record
+ * \return The header, marked as in use
+ */
+MemBlockInfo *HeaderPool::Allocate(const char *label, unsigned alloc_num) {
+  if (free_records == nullptr) {
+    record_grow();
+  }
+
+  unsigned label_id = label_intern(label);
+  LabelEntry &entry = label_entries[label_id];
+  entry.live++;
+  entry.allocations++;
+
+  Record *record = free_records;
+  free_records = record->next;
+
+  record->info.in_use = true;
+  record->info.label = entry.text;
+  record->info.alloc_num = alloc_num;
+  record->info.label_id = label_id;
+
+  return &record->info;
+}
+
+/*!
+ * \brief Returns a header and its label to the pool
+ *
+ * \param header A header created by Allocate
+ */
+void HeaderPool::Free(MemBlockInfo *header) {
+  label_entries[header->label_id].live--;
+
+  // The header is the only member of its record
+  Record *record = reinterpret_cast<Record *>(header);
+  record->next = free_records;
+  free_records = record;
+}
+
+/*!
+ * \brief Returns how many records the pool holds, free or not
+ *
+ * \return The capacity of the record chunks
+ */
+size_t HeaderPool::GetCapacity() const { return record_chunks.size() * records_per_chunk; }
+
+/*!
+ * \brief Returns the live header count of every label seen so far, in the order they were first seen. Throws an
+ * exception if there is no memory for the result. (Memory allocation problem)
+ *
+ * \param object_size The size of the objects the headers belong to, for LiveBytes_
+ * \return The statistics, the first entry is NO_LABEL (nullptr label)
+ */
+std::vector<LabelStats> HeaderPool::GetLabelStats(size_t object_size) const {
+  std::vector<LabelStats> output;
+
+  try {
+    output.reserve(label_entries.size());
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while collecting the label statistics.");
+  }
+
+  for (const LabelEntry &entry : label_entries) {
+    output.push_back(LabelStats(entry.text, entry.live, entry.live * object_size, entry.allocations));
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Hashes a label
+ *
+ * \param label The label, NUL-terminated
+ * \return The FNV-1a hash of the label
+ */
+size_t HeaderPool::LabelHash::operator()(const char *label) const {
+  uint64_t hash = UINT64_C(14695981039346656037);
+
+  for (; *label != '\0'; label++) {
+    hash = (hash ^ static_cast<unsigned char>(*label)) * UINT64_C(1099511628211);
+  }
+
+  return static_cast<size_t>(hash);
+}
+
+/*!
+ * \brief Compares two labels
+ *
+ * \param left A label
+ * \param right Another label
+ * \return Whether both labels hold the same string
+ */
+bool HeaderPool::LabelEqual::operator()(const char *left, const char *right) const { return strcmp(left, right) == 0; }
+
+/*!
+ * \brief Adds a chunk of records to the free records. Throws an exception if there is no memory.
+ */
+void HeaderPool::record_grow() {
+  try {
+    std::unique_ptr<Record[]> chunk(new Record[records_per_chunk]);
+    record_chunks.push_back(std::move(chunk));
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while growing the header pool.");
+  }
+
+  Record *chunk = record_chunks.back().get();
+
+  // Linked back to front so the records are handed out in address order
+  for (unsigned i = records_per_chunk; i > 0; i--) {
+    chunk[i - 1].next = free_records;
+    free_records = &chunk[i - 1];
+  }
+}
+
+/*!
+ * \brief Returns the id of a label, interning it the first time. Throws an exception if there is no memory.
+ *
+ * \param label The label, may be nullptr
+ * \return The id of the label
+ */
+unsigned HeaderPool::label_intern(const char *label) {
+  try {
+    if (label == nullptr) {
+      return NO_LABEL;
+    }
+
+    // The same pointer may hold a different string by now, so the contents are still compared
+    if (label == last_label && strcmp(label, label_entries[last_label_id].text) == 0) {
+      return last_label_id;
+    }
+
+    auto position = label_ids.find(label);
+    if (position == label_ids.end()) {
+      size_t size = strlen(label) + 1;
+      char *text = label_allocate(size);
+      memcpy(text, label, size);
+
+      label_entries.push_back(LabelEntry{text, 0, 0});
+      try {
+        position = label_ids.emplace(text, static_cast<unsigned>(label_entries.size() - 1)).first;
+
+      } catch (const std::bad_alloc &) {
+        label_entries.pop_back();
+        throw;
+      }
+    }
+
+    last_label = label;
+    last_label_id = position->second;
+    return last_label_id;
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while interning a label.");
+  }
+}
+
+/*!
+ * \brief Gets arena storage for an interned label. Throws std::bad_alloc if there is no memory.
+ *
+ * \param size The size of the label, terminator included
+ * \return The storage
+ */
+char *HeaderPool::label_allocate(size_t size) {
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    std::unique_ptr<char[]> chunk(new char[size]);
+    arena_chunks.push_back(std::move(chunk));
+    return arena_chunks.back().get();
+  }
+
+  // The tail of a full chunk is dropped, it is smaller than a quarter of a chunk
+  if (static_cast<size_t>(arena_end - arena_position) < size) {
+    std::unique_ptr<char[]> chunk(new char[ARENA_CHUNK_SIZE]);
+    arena_chunks.push_back(std::move(chunk));
+    arena_position = arena_chunks.back().get();
+    arena_end = arena_position + ARENA_CHUNK_SIZE;
+  }
+
+  char *output = arena_position;
+  arena_position += size;
+  return output;
+}
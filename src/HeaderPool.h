@@ -0,0 +1,156 @@
+/**
+ * @file HeaderPool.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Pooled storage for external headers (MemBlockInfo records and interned labels)
+ */
+
+//---------------------------------------------------------------------------
+#ifndef HEADERPOOLH
+#define HEADERPOOLH
+//---------------------------------------------------------------------------
+
+#include "ObjectAllocator.h"
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*!
+  Hands out the MemBlockInfo records of hbExternal headers, so an allocation with external headers costs a free list
+  pop instead of trips to the global heap. Records come in chunks of a fixed count. Labels are interned: each distinct
+  label is copied once into an arena and gets a small id, every header with that label points at the same copy, and
+  the pool keeps live counts per id. Interned labels live as long as the pool, so labels should come from a bounded
+  set (subsystem names, call sites) rather than be built per allocation. Not thread safe.
+*/
+class HeaderPool {
+public:
+  static const size_t ARENA_CHUNK_SIZE = 4096; //!< Bytes the label arena grows by, longer labels get their own chunk
+  static const unsigned NO_LABEL = 0; //!< The id of the headers created without a label
+
+  /*!
+   * \brief Creates an empty pool, no record is allocated until the first header
+   *
+   * \param records_per_chunk How many records the pool grows by, at least 1
+   */
+  explicit HeaderPool(unsigned records_per_chunk);
+
+  /*!
+   * \brief Creates a header. Throws an exception if the pool can't grow. (Memory allocation problem)
+   *
+   * \param label The label, interned on first use, may be nullptr
+   * \param alloc_num The allocation number to record
+   * \return The header, marked as in use
+   */
+  MemBlockInfo *Allocate(const char *label, unsigned alloc_num);
+
+  /*!
+   * \brief Returns a header and its label to the pool
+   *
+   * \param header A header created by Allocate
+   */
+  void Free(MemBlockInfo *header);
+
+  /*!
+   * \brief Returns how many records the pool holds, free or not
+   *
+   * \return The capacity of the record chunks
+   */
+  size_t GetCapacity() const;
+
+  /*!
+   * \brief Returns the live header count of every label seen so far, in the order they were first seen. Throws an
+   * exception if there is no memory for the result. (Memory allocation problem)
+   *
+   * \param object_size The size of the objects the headers belong to, for LiveBytes_
+   * \return The statistics, the first entry is NO_LABEL (nullptr label)
+   */
+  std::vector<LabelStats> GetLabelStats(size_t object_size) const;
+
+  // Prevent copy construction and assignment
+  HeaderPool(const HeaderPool &pool) = delete; //!< Do not implement!
+  HeaderPool &operator=(const HeaderPool &pool) = delete; //!< Do not implement!
+
+private:
+  /*!
+    A record, linked through the same storage while it is free
+  */
+  union Record {
+    MemBlockInfo info; //!< The header, while in use
+    Record *next; //!< The next free record, while free
+  };
+
+  /*!
+   * \brief Adds a chunk of records to the free records. Throws an exception if there is no memory.
+   */
+  void record_grow();
+
+  /*!
+    What the pool knows about an interned label
+  */
+  struct LabelEntry {
+    char *text; //!< The interned copy, nullptr for NO_LABEL
+    unsigned live; //!< Headers with this label still in use
+    uint64_t allocations; //!< Headers ever created with this label
+  };
+
+  /*!
+    Hashes label contents, so a lookup works with any copy of the label
+  */
+  struct LabelHash {
+    /*!
+     * \brief Hashes a label
+     *
+     * \param label The label, NUL-terminated
+     * \return The FNV-1a hash of the label
+     */
+    size_t operator()(const char *label) const;
+  };
+
+  /*!
+    Compares label contents
+  */
+  struct LabelEqual {
+    /*!
+     * \brief Compares two labels
+     *
+     * \param left A label
+     * \param right Another label
+     * \return Whether both labels hold the same string
+     */
+    bool operator()(const char *left, const char *right) const;
+  };
+
+  /*!
+   * \brief Returns the id of a label, interning it the first time. Throws an exception if there is no memory.
+   *
+   * \param label The label, may be nullptr
+   * \return The id of the label
+   */
+  unsigned label_intern(const char *label);
+
+  /*!
+   * \brief Gets arena storage for an interned label. Throws std::bad_alloc if there is no memory.
+   *
+   * \param size The size of the label, terminator included
+   * \return The storage
+   */
+  char *label_allocate(size_t size);
+
+  unsigned records_per_chunk; //!< How many records each chunk holds
+  Record *free_records; //!< Head of the free records
+  std::vector<std::unique_ptr<Record[]>> record_chunks; //!< Every chunk of records
+
+  char *arena_position; //!< Next free byte of the current arena chunk
+  char *arena_end; //!< One past the last byte of the current arena chunk
+  std::vector<std::unique_ptr<char[]>> arena_chunks; //!< Every chunk of the label arena
+
+  std::vector<LabelEntry> label_entries; //!< Indexed by label id
+  std::unordered_map<const char *, unsigned, LabelHash, LabelEqual> label_ids; //!< Interned copy to id
+  const char *last_label; //!< The label of the previous lookup, most callers pass the same literal over and over
+  unsigned last_label_id; //!< The id of last_label
+};
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * @file OALayout.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Page layout math and block lookups shared by the runtime and the compile-time allocators
+ */
+
+//---------------------------------------------------------------------------
+#ifndef OALAYOUTH
+#define OALAYOUTH
+//---------------------------------------------------------------------------
+
+#include "OAPattern.h"
+#include "ObjectAllocator.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// If the client of a pool or size class front end doesn't specify it:
+static const unsigned POOL_OBJECTS_PER_PAGE = 64;
+
+/*!
+  Every size and offset of a page, as a function of the configuration. The functions are constexpr so ObjectAllocatorT
+  can fix its layout at compile time, while ObjectAllocator calls the same functions with its runtime configuration.
+
+  A page is laid out as: next page pointer, left alignment, then ObjectsPerPage blocks of header, left pad, object,
+  right pad, with inter alignment bytes between consecutive blocks.
+
+  The rest are the lookups and updates both allocators run on such pages: which page holds an address, which block
+  of the page it is, whether the block is free or has its pads intact, signing a block and updating its header. Each
+  allocator keeps its own bookkeeping and passes in what the lookups read.
+*/
+namespace OALayout {
+  /*!
+   * \brief Returns the size of a header block
+   *
+   * \param type The kind of header
+   * \param additional The user-defined bytes of an extended header
+   * \return The size of the header
+   */
+  constexpr size_t header_size(OAConfig::HBLOCK_TYPE type, size_t additional) {
+    return type == OAConfig::hbBasic      ? OAConfig::BASIC_HEADER_SIZE
+           : type == OAConfig::hbExtended ? sizeof(unsigned int) + sizeof(unsigned short) + sizeof(char) + additional
+           : type == OAConfig::hbExternal ? OAConfig::EXTERNAL_HEADER_SIZE
+                                          : 0;
+  }
+
+  /*!
+   * \brief Returns the amount of bytes needed so the first object lands on the alignment
+   *
+   * \param pad_bytes The size of each pad
+   * \param header The size of each header
+   * \param alignment The alignment of the objects (0 for none)
+   * \return The size of the left alignment bytes
+   */
+  constexpr size_t left_alignment(size_t pad_bytes, size_t header, size_t alignment) {
+    return alignment == 0 || (sizeof(void *) + pad_bytes + header) % alignment == 0
+               ? 0
+               : alignment - (sizeof(void *) + pad_bytes + header) % alignment;
+  }
+
+  /*!
+   * \brief Returns the amount of bytes needed between blocks so every object lands on the alignment
+   *
+   * \param object_size The size of each object
+   * \param pad_bytes The size of each pad
+   * \param header The size of each header
+   * \param alignment The alignment of the objects (0 for none)
+   * \return The size of the inter alignment bytes
+   */
+  constexpr size_t inter_alignment(size_t object_size, size_t pad_bytes, size_t header, size_t alignment) {
+    return alignment == 0 || (header + 2 * pad_bytes + object_size) % alignment == 0
+               ? 0
+               : alignment - (header + 2 * pad_bytes + object_size) % alignment;
+  }
+
+  /*!
+   * \brief Returns the distance between two consecutive objects
+   *
+   * \param object_size The size of each object
+   * \param pad_bytes The size of each pad
+   * \param header The size of each header
+   * \param inter_align The size of the inter alignment bytes
+   * \return The size of a block
+   */
+  constexpr size_t block_size(size_t object_size, size_t pad_bytes, size_t header, size_t inter_align) {
+    return header + 2 * pad_bytes + object_size + inter_align;
+  }
+
+  /*!
+   * \brief Returns the offset of the first object from the start of its page
+   *
+   * \param pad_bytes The size of each pad
+   * \param header The size of each header
+   * \param left_align The size of the left alignment bytes
+   * \return The offset of the first object
+   */
+  constexpr size_t first_object_offset(size_t pad_bytes, size_t header, size_t left_align) {
+    return sizeof(void *) + left_align + header + pad_bytes;
+  }
+
+  /*!
+   * \brief Returns the configuration with Alignment_ raised so every block is suitably aligned, for the front ends
+   * that create allocators for objects of a given alignment
+   *
+   * \param config The requested configuration
+   * \param alignment The alignment of the objects
+   * \return The configuration to create the ObjectAllocator with
+   */
+  inline OAConfig aligned_config(const OAConfig &config, size_t alignment) {
+    OAConfig output = config;
+
+    // Blocks are aligned relative to the page, which new[] aligns to std::max_align_t
+    if (alignment > 1 && (output.Alignment_ == 0 || output.Alignment_ % alignment != 0)) {
+      size_t requested = std::max<size_t>(output.Alignment_, alignment);
+      output.Alignment_ = static_cast<unsigned>((requested + alignment - 1) / alignment * alignment);
+    }
+
+    return output;
+  }
+
+  /*!
+   * \brief Returns the size of a page. The last block has no inter alignment bytes after it.
+   *
+   * \param object_size The size of each object
+   * \param objects_per_page The amount of blocks in a page
+   * \param pad_bytes The size of each pad
+   * \param header The size of each header
+   * \param left_align The size of the left alignment bytes
+   * \param inter_align The size of the inter alignment bytes
+   * \return The size of the page
+   */
+  constexpr size_t page_size(
+      size_t object_size, size_t objects_per_page, size_t pad_bytes, size_t header, size_t left_align,
+      size_t inter_align) {
+    return sizeof(void *) + left_align + objects_per_page * (header + 2 * pad_bytes + object_size) +
+           (objects_per_page - 1) * inter_align;
+  }
+
+  /*!
+   * \brief Checks if an address lies in a page, past the page's first byte (the next page pointer is never a block)
+   *
+   * \param page The first byte of the page
+   * \param page_size The size of the page
+   * \param address The location to check
+   * \return Whether the address is inside the page
+   */
+  inline bool page_contains(const void *page, size_t page_size, const void *address) {
+    ptrdiff_t offset = static_cast<const uint8_t *>(address) - static_cast<const uint8_t *>(page);
+    return 0 < offset && offset < static_cast<ptrdiff_t>(page_size);
+  }
+
+  /*!
+   * \brief Binary searches pages sorted by address for the one that contains an address
+   *
+   * \param first The first entry of the pages
+   * \param last Past the last entry of the pages
+   * \param address The address to look for
+   * \param page_size The size of every page
+   * \param page_of Returns the first byte of the page of an entry
+   * \return The entry of the page containing the address, last if there is none
+   */
+  template <typename Iterator, typename PageOf>
+  Iterator page_find(Iterator first, Iterator last, const void *address, size_t page_size, PageOf page_of) {
+    const uint8_t *value = static_cast<const uint8_t *>(address);
+
+    // First page that starts after the address, the owner (if any) is the one right before it
+    Iterator position = std::upper_bound(first, last, value, [&page_of](const uint8_t *key, const auto &entry) {
+      return std::less<const uint8_t *>()(key, reinterpret_cast<const uint8_t *>(page_of(entry)));
+    });
+
+    if (position == first || !page_contains(page_of(*(position - 1)), page_size, address)) {
+      return last;
+    }
+
+    return position - 1;
+  }
+
+  /*!
+   * \brief Checks if an address of a page is on a block boundary
+   *
+   * \param page The first byte of the page containing the address
+   * \param first_object The offset of the first object, see first_object_offset
+   * \param block_size The distance between two consecutive objects
+   * \param address The location to check
+   * \return Whether the address is one of the page's objects
+   */
+  inline bool is_block(const void *page, size_t first_object, size_t block_size, const void *address) {
+    ptrdiff_t distance = static_cast<const uint8_t *>(address) - (static_cast<const uint8_t *>(page) + first_object);
+    return distance >= 0 && static_cast<size_t>(distance) % block_size == 0;
+  }
+
+  /*!
+   * \brief Returns the position of an object within its page
+   *
+   * \param page The first byte of the page containing the object
+   * \param first_object The offset of the first object, see first_object_offset
+   * \param block_size The distance between two consecutive objects
+   * \param object The object to locate
+   * \return The index of the block in the page
+   */
+  inline size_t block_index(const void *page, size_t first_object, size_t block_size, const void *object) {
+    const uint8_t *blocks_start = static_cast<const uint8_t *>(page) + first_object;
+    return static_cast<size_t>(static_cast<const uint8_t *>(object) - blocks_start) / block_size;
+  }
+
+  /*!
+   * \brief Reads the bit of a block in an occupancy bitmap
+   *
+   * \param bits One bit per block of a page, set while the client owns the block
+   * \param index The index of the block in the page
+   * \return Whether the client owns the block
+   */
+  inline bool bit_test(const std::vector<uint64_t> &bits, size_t index) {
+    return (bits[index / 64] & (uint64_t(1) << (index % 64))) != 0;
+  }
+
+  /*!
+   * \brief Writes the bit of a block in an occupancy bitmap
+   *
+   * \param bits One bit per block of a page
+   * \param index The index of the block in the page
+   * \param in_use Whether the client now owns the block
+   */
+  inline void bit_assign(std::vector<uint64_t> &bits, size_t index, bool in_use) {
+    uint64_t bit = uint64_t(1) << (index % 64);
+
+    if (in_use) {
+      bits[index / 64] |= bit;
+    } else {
+      bits[index / 64] &= ~bit;
+    }
+  }
+
+  /*!
+   * \brief Reads the in use flag of a basic or extended header, both end with it
+   *
+   * \param header The first byte of the header
+   * \param header_size The size of the header
+   * \return Whether the header marks the object as free
+   */
+  inline bool header_is_free(const void *header, size_t header_size) {
+    return (static_cast<const uint8_t *>(header)[header_size - 1] & 1) == 0;
+  }
+
+  /*!
+   * \brief Clears a basic or extended header, the state of a block that was never allocated
+   *
+   * \param header The first byte of the header
+   * \param header_size The size of the header
+   */
+  inline void header_clear(void *header, size_t header_size) { memset(header, 0, header_size); }
+
+  /*!
+   * \brief Marks a basic or extended header as in use. Both end with the allocation number and the flags, the use
+   * counter of an extended header comes right before them.
+   *
+   * \param header The first byte of the header
+   * \param header_size The size of the header
+   * \param extended Whether the header is an extended one
+   * \param alloc_num The allocation number to record
+   */
+  inline void header_mark_allocated(void *header, size_t header_size, bool extended, unsigned alloc_num) {
+    uint8_t *raw_header = static_cast<uint8_t *>(header);
+    uint8_t *number = raw_header + header_size - 1 - sizeof(uint32_t);
+
+    // Headers sit at any byte offset, so the fields are copied instead of cast to
+    if (extended) {
+      uint16_t use_counter = 0;
+      memcpy(&use_counter, number - sizeof(use_counter), sizeof(use_counter));
+      use_counter++;
+      memcpy(number - sizeof(use_counter), &use_counter, sizeof(use_counter));
+    }
+
+    uint32_t allocation_number = static_cast<uint32_t>(alloc_num);
+    memcpy(number, &allocation_number, sizeof(allocation_number));
+    raw_header[header_size - 1] |= 1;
+  }
+
+  /*!
+   * \brief Marks a basic or extended header as free, an extended header keeps its use counter
+   *
+   * \param header The first byte of the header
+   * \param header_size The size of the header
+   */
+  inline void header_mark_free(void *header, size_t header_size) {
+    uint8_t *raw_header = static_cast<uint8_t *>(header);
+
+    uint32_t allocation_number = 0;
+    memcpy(raw_header + header_size - 1 - sizeof(allocation_number), &allocation_number, sizeof(allocation_number));
+    raw_header[header_size - 1] = static_cast<uint8_t>(raw_header[header_size - 1] & ~1);
+  }
+
+  /*!
+   * \brief Signs an object and sets both of its pads to PAD_PATTERN
+   *
+   * \param object The object to sign
+   * \param object_size The size of the object
+   * \param pad_bytes The size of each pad
+   * \param signature Pattern to sign the object with
+   */
+  inline void block_sign(void *object, size_t object_size, size_t pad_bytes, unsigned char signature) {
+    uint8_t *raw_object = static_cast<uint8_t *>(object);
+
+    memset(raw_object, signature, object_size);
+
+    if (pad_bytes > 0) {
+      memset(raw_object - pad_bytes, ObjectAllocator::PAD_PATTERN, pad_bytes);
+      memset(raw_object + object_size, ObjectAllocator::PAD_PATTERN, pad_bytes);
+    }
+  }
+
+  /*!
+   * \brief Checks that both pads of an object still hold PAD_PATTERN
+   *
+   * \param object The object the pads surround
+   * \param object_size The size of the object
+   * \param pad_bytes The size of each pad
+   * \return Whether the padding is intact
+   */
+  inline bool pads_intact(const void *object, size_t object_size, size_t pad_bytes) {
+    const uint8_t *raw_object = static_cast<const uint8_t *>(object);
+
+    return OAPattern::matches(raw_object - pad_bytes, ObjectAllocator::PAD_PATTERN, pad_bytes) &&
+           OAPattern::matches(raw_object + object_size, ObjectAllocator::PAD_PATTERN, pad_bytes);
+  }
+} // namespace OALayout
+
+#endif
@@ -0,0 +1,192 @@
+/**
+ * \file OAPattern.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the vectorized signature checks
+ */
+
+#include "OAPattern.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <immintrin.h>
+  #define OA_PATTERN_X86 1
+#else
+  #define OA_PATTERN_X86 0
+#endif
+
+namespace {
+  using u8 = uint8_t;
+
+  /*!
+   * \brief Checks a run 8 bytes at a time
+   *
+   * \param location The start of the run
+   * \param pattern The expected byte
+   * \param size The length of the run
+   * \return Whether the run is intact
+   */
+  bool matches_scalar(const u8 *location, unsigned char pattern, size_t size) {
+    const uint64_t expected = UINT64_C(0x0101010101010101) * pattern;
+
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), location += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, location, sizeof(word));
+
+      if (word != expected) {
+        return false;
+      }
+    }
+
+    for (; size > 0; size--, location++) {
+      if (*location != pattern) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+#if OA_PATTERN_X86
+  /*!
+   * \brief Checks a run 16 bytes at a time
+   *
+   * \param location The start of the run
+   * \param pattern The expected byte
+   * \param size The length of the run
+   * \return Whether the run is intact
+   */
+  __attribute__((target("sse2"))) bool matches_sse2(const u8 *location, unsigned char pattern, size_t size) {
+    const __m128i expected = _mm_set1_epi8(static_cast<char>(pattern));
+
+    for (; size >= sizeof(__m128i); size -= sizeof(__m128i), location += sizeof(__m128i)) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(location));
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, expected)) != 0xFFFF) {
+        return false;
+      }
+    }
+
+    return matches_scalar(location, pattern, size);
+  }
+
+  /*!
+   * \brief Checks a run 32 bytes at a time
+   *
+   * \param location The start of the run
+   * \param pattern The expected byte
+   * \param size The length of the run
+   * \return Whether the run is intact
+   */
+  __attribute__((target("avx2"))) bool matches_avx2(const u8 *location, unsigned char pattern, size_t size) {
+    const __m256i expected = _mm256_set1_epi8(static_cast<char>(pattern));
+    bool intact = true;
+
+    for (; size >= sizeof(__m256i); size -= sizeof(__m256i), location += sizeof(__m256i)) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(location));
+
+      if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, expected)) != -1) {
+        intact = false;
+        break;
+      }
+    }
+
+    // Legacy SSE code running with dirty upper halves is heavily penalized, and GCC doesn't always clear them here
+    _mm256_zeroupper();
+
+    return intact && matches_scalar(location, pattern, size);
+  }
+#endif
+
+  typedef bool (*MATCHER)(const u8 *, unsigned char, size_t);
+
+  /*!
+   * \brief Returns the function implementing a kernel
+   *
+   * \param kernel The kernel, it has to be supported
+   * \return The implementation
+   */
+  MATCHER kernel_function(OAPattern::KERNEL kernel) {
+    switch (kernel) {
+#if OA_PATTERN_X86
+      case OAPattern::pkAVX2: return matches_avx2;
+      case OAPattern::pkSSE2: return matches_sse2;
+#endif
+      default: return matches_scalar;
+    }
+  }
+} // namespace
+
+/*!
+ * \brief Checks that every byte of a run equals the pattern, with the best kernel
+ *
+ * \param location The start of the run
+ * \param pattern The expected byte
+ * \param size The length of the run
+ * \return Whether the run is intact
+ */
+bool OAPattern::matches(const void *location, unsigned char pattern, size_t size) {
+  static const MATCHER best = kernel_function(best_kernel());
+  return best(static_cast<const u8 *>(location), pattern, size);
+}
+
+/*!
+ * \brief Checks that every byte of a run equals the pattern, with a given kernel
+ *
+ * \param kernel The kernel to use, an unsupported one falls back to the scalar loop
+ * \param location The start of the run
+ * \param pattern The expected byte
+ * \param size The length of the run
+ * \return Whether the run is intact
+ */
+bool OAPattern::matches(KERNEL kernel, const void *location, unsigned char pattern, size_t size) {
+  MATCHER matcher = kernel_function(is_supported(kernel) ? kernel : pkScalar);
+  return matcher(static_cast<const u8 *>(location), pattern, size);
+}
+
+/*!
+ * \brief Returns whether the CPU can run a kernel
+ *
+ * \param kernel The kernel to check
+ * \return Whether the kernel is supported
+ */
+bool OAPattern::is_supported(KERNEL kernel) {
+  switch (kernel) {
+#if OA_PATTERN_X86
+    case pkAVX2: return __builtin_cpu_supports("avx2");
+    case pkSSE2: return __builtin_cpu_supports("sse2");
+#endif
+    case pkScalar: return true;
+    default: return false;
+  }
+}
+
+/*!
+ * \brief Returns the kernel matches uses
+ *
+ * \return The fastest supported kernel
+ */
+OAPattern::KERNEL OAPattern::best_kernel() {
+  if (is_supported(pkAVX2)) {
+    return pkAVX2;
+  }
+
+  return is_supported(pkSSE2) ? pkSSE2 : pkScalar;
+}
+
+/*!
+ * \brief Returns a printable name for a kernel
+ *
+ * \param kernel The kernel
+ * \return The name of the kernel
+ */
+const char *OAPattern::kernel_name(KERNEL kernel) {
+  switch (kernel) {
+    case pkAVX2: return "AVX2";
+    case pkSSE2: return "SSE2";
+    default: return "scalar";
+  }
+}
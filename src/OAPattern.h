@@ -0,0 +1,76 @@
+/**
+ * @file OAPattern.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Vectorized checks of the debug signatures (pad, freed and alignment patterns)
+ */
+
+//---------------------------------------------------------------------------
+#ifndef OAPATTERNH
+#define OAPATTERNH
+//---------------------------------------------------------------------------
+
+#include <cstddef>
+
+/*!
+  Checks that a run of bytes holds a single repeated pattern byte. The best kernel the CPU supports is picked the first
+  time matches is called: AVX2, then SSE2 on x86, and a word at a time scalar loop everywhere else.
+*/
+namespace OAPattern {
+  /*!
+    The available implementations
+  */
+  enum KERNEL {
+    pkScalar, //!< 8 bytes per step, any CPU
+    pkSSE2, //!< 16 bytes per step, every x86-64 CPU
+    pkAVX2 //!< 32 bytes per step
+  };
+
+  /*!
+   * \brief Checks that every byte of a run equals the pattern, with the best kernel
+   *
+   * \param location The start of the run
+   * \param pattern The expected byte
+   * \param size The length of the run
+   * \return Whether the run is intact
+   */
+  bool matches(const void *location, unsigned char pattern, size_t size);
+
+  /*!
+   * \brief Checks that every byte of a run equals the pattern, with a given kernel
+   *
+   * \param kernel The kernel to use, an unsupported one falls back to the scalar loop
+   * \param location The start of the run
+   * \param pattern The expected byte
+   * \param size The length of the run
+   * \return Whether the run is intact
+   */
+  bool matches(KERNEL kernel, const void *location, unsigned char pattern, size_t size);
+
+  /*!
+   * \brief Returns whether the CPU can run a kernel
+   *
+   * \param kernel The kernel to check
+   * \return Whether the kernel is supported
+   */
+  bool is_supported(KERNEL kernel);
+
+  /*!
+   * \brief Returns the kernel matches uses
+   *
+   * \return The fastest supported kernel
+   */
+  KERNEL best_kernel();
+
+  /*!
+   * \brief Returns a printable name for a kernel
+   *
+   * \param kernel The kernel
+   * \return The name of the kernel
+   */
+  const char *kernel_name(KERNEL kernel);
+} // namespace OAPattern
+
+#endif
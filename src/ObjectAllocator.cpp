@@ -8,8 +8,19 @@
  */
 
 #include "ObjectAllocator.h"
+#include "AllocationTrace.h"
+#include "FlightRecorder.h"
+#include "HeaderPool.h"
+#include "OALayout.h"
+#include "OAPattern.h"
+#include "PageProvider.h"
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstring>
+#include <exception>
+#include <functional>
+#include <system_error>
 
 // Alias declaration just for internal use
 using u8 = uint8_t;
@@ -19,6 +30,203 @@ using u32 = uint32_t;
 static_assert(sizeof(u16) == 2, "uint16_t is not of size 2 bytes");
 static_assert(sizeof(u32) == 4, "uint32_t is not of size 4 bytes");
 
+namespace {
+  // The lock-free free list packs a version tag above the bits a user space pointer can use
+  const unsigned TAG_SHIFT = sizeof(void *) == 8 ? 48 : 32;
+  const uint64_t TAGGED_POINTER_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+  // Any nonzero seed works, a fixed one makes the sampled pages the same from run to run
+  const uint32_t SAMPLE_SEED = 2463534242u;
+
+  /*!
+   * \brief Returns the counter stripe of the calling thread, threads are spread round robin the first time they ask
+   *
+   * \param stripes The amount of stripes
+   * \return The index of the stripe
+   */
+  unsigned thread_stripe(unsigned stripes) {
+    static std::atomic<unsigned> next_stripe(0);
+    static thread_local unsigned stripe = next_stripe.fetch_add(1, std::memory_order_relaxed);
+
+    return stripe % stripes;
+  }
+
+  // Reading the clock costs about as much as scrubbing a block, so the time budget is checked every few blocks
+  const unsigned SCRUB_CLOCK_STRIDE = 16;
+
+  /*!
+   * \brief Packs a pointer and a version tag into a single word
+   *
+   * \param pointer The pointer to pack
+   * \param tag The version tag, only the bits above TAG_SHIFT are kept
+   * \return The packed word
+   */
+  template <typename T>
+  uint64_t tagged_pack(T *pointer, uint64_t tag) {
+    return (tag << TAG_SHIFT) | (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)) & TAGGED_POINTER_MASK);
+  }
+
+  /*!
+   * \brief Extracts the pointer of a packed word
+   *
+   * \param word The packed word
+   * \return The pointer in the word
+   */
+  template <typename T = GenericObject>
+  T *tagged_pointer(uint64_t word) {
+    return reinterpret_cast<T *>(static_cast<uintptr_t>(word & TAGGED_POINTER_MASK));
+  }
+
+  /*!
+   * \brief Returns the version tag that follows the one in the packed word
+   *
+   * \param word The packed word
+   * \return The next version tag
+   */
+  uint64_t tagged_next(uint64_t word) { return (word >> TAG_SHIFT) + 1; }
+
+  /*!
+   * \brief Reads the link of the first object of the lock-free free list. Another thread may have popped the object
+   * since the head was loaded and be writing to it (its signatures or the client's data), so the link may be stale.
+   * A stale link is harmless: the head's version tag changed with that pop, so the exchange it goes into fails and
+   * the link is thrown away. The load is atomic so it can't tear, and ThreadSanitizer is told to skip it since the
+   * writes it races with are plain ones to memory the allocator no longer owns.
+   *
+   * \param object The object at the head of the list when it was loaded
+   * \return The object's link, possibly stale
+   */
+#if defined(__GNUC__)
+  __attribute__((no_sanitize("thread")))
+#endif
+  GenericObject *concurrent_next(const GenericObject *object) {
+#if defined(__GNUC__)
+    return __atomic_load_n(&object->Next, __ATOMIC_RELAXED);
+#else
+    return object->Next;
+#endif
+  }
+
+  /*!
+   * \brief Returns how many partitions a parallel sweep uses
+   *
+   * \param threads The requested amount of threads, 0 for one per hardware thread
+   * \param count The amount of pages to sweep
+   * \return At least 1 and at most count partitions
+   */
+  unsigned partition_count(unsigned threads, size_t count) {
+    if (threads == 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+
+    return static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, count)));
+  }
+
+  /*!
+   * \brief Splits [0, count) into contiguous partitions and runs a job on each, one thread per partition with the
+   * calling thread taking the first one. Partitions that can't get a thread run on the calling thread. Rethrows the
+   * first exception a partition threw once every thread is done.
+   *
+   * \param count The amount of items
+   * \param partitions How many partitions, at least 1
+   * \param job Called as job(begin, end, partition)
+   */
+  template <typename JOB>
+  void run_partitioned(size_t count, unsigned partitions, const JOB &job) {
+    std::vector<std::exception_ptr> errors(partitions);
+    std::vector<std::thread> workers;
+    workers.reserve(partitions);
+
+    auto run = [&](unsigned partition) {
+      try {
+        job(count * partition / partitions, count * (partition + 1) / partitions, partition);
+      } catch (...) {
+        errors[partition] = std::current_exception();
+      }
+    };
+
+    unsigned started = 1;
+    try {
+      for (; started < partitions; started++) {
+        workers.emplace_back(run, started);
+      }
+    } catch (const std::system_error &) {
+    }
+
+    for (unsigned partition = 0; partition < partitions; partition++) {
+      if (partition == 0 || partition >= started) {
+        run(partition);
+      }
+    }
+
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+
+    for (const std::exception_ptr &error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+  }
+
+  /*!
+   * \brief Calls a callback for the blocks found by each partition, in partition order
+   *
+   * \param found The blocks found by each partition
+   * \param fn Callback to call for each block
+   * \param size The size passed to the callback
+   * \return Amount of blocks
+   */
+  unsigned report_blocks(const std::vector<std::vector<const void *>> &found, void (*fn)(const void *, size_t),
+                         size_t size) {
+    unsigned count = 0;
+
+    for (const std::vector<const void *> &blocks : found) {
+      for (const void *block : blocks) {
+        fn(block, size);
+        count++;
+      }
+    }
+
+    return count;
+  }
+} // namespace
+
+/*!
+  Bookkeeping for a single page. It lives outside of the page so the page layout stays exactly as specified.
+*/
+struct ObjectAllocator::PageInfo {
+  GenericObject *page; //!< The page being described
+  unsigned live_objects; //!< How many of the page's blocks are owned by the client
+  std::vector<uint64_t> occupancy; //!< One bit per block, set while the client owns the block (empty when disabled)
+  GenericObject *free_list; //!< ppFullestPageFirst only, the free blocks of this page
+  PageInfo *slab_prev; //!< ppFullestPageFirst only, previous page with the same live object count
+  PageInfo *slab_next; //!< ppFullestPageFirst only, next page with the same live object count
+  bool sampled; //!< Whether the page gets the debug checks, see DebugSampleRate_
+};
+
+/*!
+ * \brief Returns the totals accumulated between an earlier snapshot of the same allocator and this one, for rates.
+ * Sizes, object and page counts, MostObjects_ and SampledPages_ keep this snapshot's values.
+ *
+ * \param earlier A snapshot taken before this one
+ * \return The statistics of the interval
+ */
+OAStats OAStats::Since(const OAStats &earlier) const {
+  OAStats output = *this;
+
+  output.Allocations_ -= earlier.Allocations_;
+  output.Deallocations_ -= earlier.Deallocations_;
+  output.CacheHits_ -= earlier.CacheHits_;
+  output.CacheRefills_ -= earlier.CacheRefills_;
+  output.CacheFlushes_ -= earlier.CacheFlushes_;
+  output.DebugChecks_ -= earlier.DebugChecks_;
+  output.DebugHits_ -= earlier.DebugHits_;
+  output.ScrubPasses_ -= earlier.ScrubPasses_;
+
+  return output;
+}
+
 /*!
  * \brief Creates the ObjectManager per the specified values. Throws an exception if the construction fails.
  * (Memory allocation problem)
@@ -27,8 +235,14 @@ static_assert(sizeof(u32) == 4, "uint32_t is not of size 4 bytes");
  * \param config The configuration which the allocator will use
  */
 ObjectAllocator::ObjectAllocator(size_t ObjectSize, const OAConfig &config) :
-    page_list(nullptr), free_objects_list(nullptr), object_size(ObjectSize), config(config), block_size(0),
-    page_size(0), stats() {
+    page_list(nullptr), free_objects_list(nullptr), page_index(), last_found_page(nullptr), page_table(), slab_lists(),
+    slab_fullest_hint(0), object_size(ObjectSize), config(config), block_size(0), page_size(0),
+    page_alignment(alignof(std::max_align_t)), stats(), lazy_page(nullptr), lazy_blocks(0),
+    signing(config.DebugOn_), sample_state(SAMPLE_SEED), scrub_page(nullptr), scrub_block(0),
+    header_pool(), flight_recorder(),
+    concurrent_free_list(0), stat_stripes(), concurrent_most_objects(0),
+    page_mutex(), owner_thread(std::this_thread::get_id()), remote_free_list(nullptr), remote_pending(nullptr),
+    remote_spare_list(0) {
   this->config.LeftAlignSize_ = static_cast<unsigned>(calculate_left_alignment_size());
   this->config.InterAlignSize_ = static_cast<unsigned>(calculate_inter_alignment_size());
 
@@ -39,6 +253,61 @@ ObjectAllocator::ObjectAllocator(size_t ObjectSize, const OAConfig &config) :
   stats.ObjectSize_ = ObjectSize;
   stats.PageSize_ = page_size;
 
+  while (this->config.AlignedPages_ && page_alignment < page_size) {
+    page_alignment <<= 1;
+  }
+
+  // Once the page is found by masking, the bitmap makes the double free check a single bit test
+  if (this->config.AlignedPages_) {
+    this->config.OccupancyBitmap_ = true;
+  }
+
+  // Carving relies on a single free list that only this allocator pops
+  if (this->config.ConcurrentFreeList_ || this->config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    this->config.LazyPageFormat_ = false;
+  }
+
+  // Per-page bookkeeping is kept off the lock-free hot path
+  if (this->config.ConcurrentFreeList_) {
+    this->config.DebugSampleRate_ = 1;
+    this->config.OccupancyBitmap_ = false;
+    this->config.PagePolicy_ = OAConfig::ppGlobalFreeList;
+  }
+
+  // Both of these already take frees from any thread
+  if (this->config.ConcurrentFreeList_ || this->config.UseCPPMemManager_) {
+    this->config.RemoteFreeQueue_ = false;
+  }
+
+  if (this->config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    try {
+      slab_lists.assign(config.ObjectsPerPage_ + 1, nullptr);
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the slab lists.");
+    }
+  }
+
+  // Other threads create headers outside of any lock, so the concurrent list keeps using new
+  if (this->config.HBlockInfo_.type_ == OAConfig::hbExternal && !this->config.ConcurrentFreeList_) {
+    try {
+      header_pool.reset(new HeaderPool(this->config.ObjectsPerPage_));
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the header pool.");
+    }
+  }
+
+  // Created before the first page, so that page is recorded too
+  if (this->config.FlightRecorder_ != 0) {
+    try {
+      flight_recorder.reset(new FlightRecorder(this->config.FlightRecorder_, this->config.ConcurrentFreeList_));
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the flight recorder.");
+    }
+  }
+
   page_push_front(allocate_page());
 }
 
@@ -49,9 +318,21 @@ ObjectAllocator::~ObjectAllocator() {
   GenericObject *current_page = page_pop_front();
 
   while (current_page != nullptr) {
-    delete[] reinterpret_cast<u8 *>(current_page);
+    free_page(current_page);
     current_page = page_pop_front();
   }
+
+  // Frees still queued are dropped with their pages
+  RemoteFree *lists[] = {remote_free_list.load(std::memory_order_acquire), remote_pending,
+                         tagged_pointer<RemoteFree>(remote_spare_list.load(std::memory_order_acquire))};
+
+  for (RemoteFree *entry : lists) {
+    while (entry != nullptr) {
+      RemoteFree *next = entry->next.load(std::memory_order_relaxed);
+      delete entry;
+      entry = next;
+    }
+  }
 }
 
 /*!
@@ -65,14 +346,59 @@ ObjectAllocator::~ObjectAllocator() {
 void *ObjectAllocator::Allocate(const char *label) {
   GenericObject *output = nullptr;
 
-  if (config.UseCPPMemManager_) {
-    output = cpp_mem_manager_allocate();
+  if (config.ConcurrentFreeList_) {
+    unsigned stripe_index = thread_stripe(STAT_STRIPES);
+    StatStripe &stripe = stat_stripes[stripe_index];
 
-  } else {
-    output = custom_mem_manager_allocate(label);
+    // Interleaving the stripes keeps the numbers unique without a shared counter. A failed allocation burns its
+    // number, handing it back could give it to a block another thread of the stripe still holds.
+    uint64_t stripe_number = stripe.numbers.fetch_add(1, std::memory_order_relaxed);
+    unsigned alloc_num = static_cast<unsigned>(stripe_number * STAT_STRIPES + stripe_index + 1);
+
+    try {
+      output = config.UseCPPMemManager_ ? cpp_mem_manager_allocate() : concurrent_allocate(label, alloc_num);
+
+    } catch (const OAException &) {
+      flight_dump();
+      throw;
+    }
+
+    // Only allocations that succeeded are counted
+    uint64_t stripe_allocations = stripe.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    flight_record(FlightEvent::feAllocate, output, alloc_num);
+
+    if (config.TraceWriter_ != nullptr) {
+      config.TraceWriter_->RecordAllocate(output, label);
+    }
+
+    // Adding up the stripes reads every other thread's cache lines, so the peak is only sampled
+    if (stripe_allocations % PEAK_SAMPLE_INTERVAL == 0) {
+      concurrent_peak_update();
+    }
+
+    return output;
+  }
+
+  try {
+    if (config.UseCPPMemManager_) {
+      output = cpp_mem_manager_allocate();
+
+    } else {
+      output = custom_mem_manager_allocate(label, static_cast<unsigned>(stats.Allocations_ + 1));
+    }
+
+  } catch (const OAException &) {
+    flight_dump();
+    throw;
   }
 
   stats.Allocations_++;
+  flight_record(FlightEvent::feAllocate, output, static_cast<unsigned>(stats.Allocations_));
+
+  if (config.TraceWriter_ != nullptr) {
+    config.TraceWriter_->RecordAllocate(output, label);
+  }
   stats.ObjectsInUse_++;
 
   if (stats.ObjectsInUse_ > stats.MostObjects_) {
@@ -89,16 +415,278 @@ void *ObjectAllocator::Allocate(const char *label) {
  * \param Object Pointer to the block to deallocate
  */
 void ObjectAllocator::Free(void *Object) {
-  if (config.UseCPPMemManager_) {
-    cpp_mem_manager_free(Object);
-  } else {
-    custom_mem_manager_free(Object);
+  if (config.ConcurrentFreeList_) {
+    // Recorded before another thread can take the object again, so the trace never sees an address allocated twice
+    if (config.TraceWriter_ != nullptr) {
+      config.TraceWriter_->RecordFree(Object);
+    }
+
+    flight_record(FlightEvent::feFree, Object, 0);
+
+    try {
+      if (config.UseCPPMemManager_) {
+        cpp_mem_manager_free(Object);
+      } else {
+        concurrent_free(static_cast<GenericObject *>(Object));
+      }
+
+    } catch (const OAException &) {
+      flight_dump();
+      throw;
+    }
+
+    // Released, so whoever reads this free also sees the allocation that came before it
+    stat_stripes[thread_stripe(STAT_STRIPES)].deallocations.fetch_add(1, std::memory_order_release);
+    return;
+  }
+
+  if (config.RemoteFreeQueue_ && std::this_thread::get_id() != owner_thread) {
+    RemoteFree *entry = remote_entry(Object);
+
+    // Same for the owner, once the object is queued
+    if (config.TraceWriter_ != nullptr) {
+      config.TraceWriter_->RecordFree(Object);
+    }
+
+    remote_push(entry, entry);
+    return;
+  }
+
+  flight_record(FlightEvent::feFree, Object, 0);
+
+  try {
+    if (config.UseCPPMemManager_) {
+      cpp_mem_manager_free(Object);
+    } else {
+      custom_mem_manager_free(Object);
+    }
+
+  } catch (const OAException &) {
+    flight_dump();
+    throw;
+  }
+
+  // Only this thread hands objects out, so a free that was rejected is never recorded
+  if (config.TraceWriter_ != nullptr) {
+    config.TraceWriter_->RecordFree(Object);
   }
 
   stats.Deallocations_++;
   stats.ObjectsInUse_--;
 }
 
+/*!
+ * \brief Takes count objects at once, handing them out in the same order count calls to Allocate would. Either every
+ * object is allocated or an exception is thrown and none are. (Memory allocation problem)
+ *
+ * \param count How many objects to allocate
+ * \param Objects Receives the pointers to the allocated blocks, must hold count pointers
+ * \param label The label to put in the external headers
+ */
+void ObjectAllocator::AllocateBatch(unsigned count, void *Objects[], const char *label) {
+  if (count == 0) {
+    return;
+  }
+
+  if (!batch_fast_path()) {
+    for (unsigned i = 0; i < count; i++) {
+      try {
+        Objects[i] = Allocate(label);
+
+      } catch (const OAException &) {
+        while (i > 0) {
+          Free(Objects[--i]);
+        }
+        throw;
+      }
+    }
+
+    return;
+  }
+
+  GenericObject *current = nullptr;
+
+  try {
+    // Queued frees go in first, they land at the front of the list the batch takes its blocks from
+    if (stats.FreeObjects_ < count) {
+      remote_drain();
+    }
+
+    // The walk that takes the listed blocks ends at the tail any new pages are linked to
+    current = free_objects_list;
+    GenericObject *tail = nullptr;
+    unsigned taken = 0;
+
+    for (; taken < count && current != nullptr; taken++) {
+      Objects[taken] = current;
+      tail = current;
+      current = current->Next;
+    }
+
+    if (taken < count) {
+      current = batch_reserve(count - taken, tail);
+    }
+
+    for (; taken < count; taken++) {
+      Objects[taken] = current;
+      current = current->Next;
+    }
+
+  } catch (const OAException &) {
+    flight_dump();
+    throw;
+  }
+
+  try {
+    batch_update_alloc(Objects, count, label);
+
+  } catch (const OAException &) {
+    flight_dump();
+    throw;
+  }
+
+  // Only detached once nothing can fail, so a failed batch leaves the free list as it was
+  free_objects_list = current;
+
+  for (unsigned i = 0; flight_recorder != nullptr && i < count; i++) {
+    flight_record(FlightEvent::feAllocate, Objects[i], static_cast<unsigned>(stats.Allocations_ + i + 1));
+  }
+
+  for (unsigned i = 0; config.TraceWriter_ != nullptr && i < count; i++) {
+    config.TraceWriter_->RecordAllocate(Objects[i], label);
+  }
+
+  stats.FreeObjects_ -= count;
+  stats.Allocations_ += count;
+  stats.ObjectsInUse_ += count;
+
+  if (stats.ObjectsInUse_ > stats.MostObjects_) {
+    stats.MostObjects_ = stats.ObjectsInUse_;
+  }
+}
+
+/*!
+ * \brief Returns count objects at once, same as count calls to Free in order. Throws an exception if an object can't
+ * be freed, the objects before it stay freed. (Invalid object)
+ *
+ * \param Objects Pointers to the blocks to deallocate
+ * \param count How many objects to free
+ */
+void ObjectAllocator::FreeBatch(void *Objects[], unsigned count) {
+  if (count == 0) {
+    return;
+  }
+
+  if (config.RemoteFreeQueue_ && std::this_thread::get_id() != owner_thread) {
+    // The batch is linked up front, newest first, so it reaches the owner's queue in a single exchange
+    RemoteFree *first = nullptr;
+    RemoteFree *last = nullptr;
+
+    try {
+      for (unsigned i = 0; i < count; i++) {
+        RemoteFree *entry = remote_entry(Objects[i]);
+        entry->next.store(first, std::memory_order_relaxed);
+        last = last != nullptr ? last : entry;
+        first = entry;
+      }
+
+    } catch (const OAException &) {
+      // Nothing is queued unless the whole batch is
+      while (first != nullptr) {
+        RemoteFree *next = first->next.load(std::memory_order_relaxed);
+        remote_recycle(first);
+        first = next;
+      }
+
+      throw;
+    }
+
+    for (unsigned i = 0; config.TraceWriter_ != nullptr && i < count; i++) {
+      config.TraceWriter_->RecordFree(Objects[i]);
+    }
+
+    remote_push(first, last);
+    return;
+  }
+
+  if (!batch_fast_path()) {
+    for (unsigned i = 0; i < count; i++) {
+      Free(Objects[i]);
+    }
+
+    return;
+  }
+
+  for (unsigned i = 0; flight_recorder != nullptr && i < count; i++) {
+    flight_record(FlightEvent::feFree, Objects[i], 0);
+  }
+
+  if (config.DebugOn_) {
+    // Each object is checked against the ones freed before it, so the checks can't be hoisted
+    unsigned freed = 0;
+
+    try {
+      for (; freed < count; freed++) {
+        custom_mem_manager_free(Objects[freed]);
+      }
+
+    } catch (const OAException &) {
+      for (unsigned i = 0; config.TraceWriter_ != nullptr && i < freed; i++) {
+        config.TraceWriter_->RecordFree(Objects[i]);
+      }
+
+      stats.Deallocations_ += freed;
+      stats.ObjectsInUse_ -= freed;
+      flight_dump();
+      throw;
+    }
+
+  } else {
+    batch_update_dealloc(Objects, count);
+
+    // Link the batch in one pass and splice it onto the free list once
+    GenericObject *head = free_objects_list;
+    for (unsigned i = 0; i < count; i++) {
+      GenericObject *object = static_cast<GenericObject *>(Objects[i]);
+
+      object_mark(page_index_find(reinterpret_cast<u8 *>(object)), object, false);
+      object->Next = head;
+      head = object;
+    }
+    free_objects_list = head;
+
+    stats.FreeObjects_ += count;
+  }
+
+  for (unsigned i = 0; config.TraceWriter_ != nullptr && i < count; i++) {
+    config.TraceWriter_->RecordFree(Objects[i]);
+  }
+
+  stats.Deallocations_ += count;
+  stats.ObjectsInUse_ -= count;
+}
+
+/*!
+ * \brief Applies the frees other threads queued with RemoteFreeQueue_ (owner thread only). Throws an exception if a
+ * queued object can't be freed, that object is dropped and the rest stay queued. (Invalid object)
+ *
+ * \return Amount of objects freed
+ */
+unsigned ObjectAllocator::DrainRemoteFrees() {
+  try {
+    return remote_drain();
+
+  } catch (const OAException &) {
+    flight_dump();
+    throw;
+  }
+}
+
+/*!
+ * \brief Makes the calling thread the owner for RemoteFreeQueue_. The previous owner must be done allocating.
+ */
+void ObjectAllocator::SetOwnerThread() { owner_thread = std::this_thread::get_id(); }
+
 /*!
  * \brief Calls the callback fn for each block still in use
  *
@@ -111,10 +699,11 @@ unsigned ObjectAllocator::DumpMemoryInUse(DUMPCALLBACK fn) const {
   unsigned in_use_count = 0;
 
   while (current_page != nullptr) {
+    size_t first = lazy_unformatted(current_page);
     u8 *object = reinterpret_cast<u8 *>(current_page) + sizeof(void *) + config.LeftAlignSize_ +
-                 config.HBlockInfo_.size_ + config.PadBytes_;
+                 config.HBlockInfo_.size_ + config.PadBytes_ + first * block_size;
 
-    for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
+    for (size_t i = first; i < config.ObjectsPerPage_; i++) {
       if (!object_check_is_free(reinterpret_cast<GenericObject *>(object))) {
         fn(object, object_size);
         in_use_count++;
@@ -145,16 +734,9 @@ unsigned ObjectAllocator::ValidatePages(VALIDATECALLBACK fn) const {
   unsigned in_use_count = 0;
 
   while (current_page != nullptr) {
-    u8 *object = reinterpret_cast<u8 *>(current_page) + sizeof(void *) + config.LeftAlignSize_ +
-                 config.HBlockInfo_.size_ + config.PadBytes_;
-
-    for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
-      if (!object_validate_padding(reinterpret_cast<GenericObject *>(object))) {
-        fn(object, object_size);
-        in_use_count++;
-      }
-
-      object += block_size;
+    // Pages left out of the sample were never signed
+    if (page_index_get(current_page)->sampled) {
+      in_use_count += page_validate(current_page, fn, nullptr);
     }
 
     current_page = current_page->Next;
@@ -164,75 +746,319 @@ unsigned ObjectAllocator::ValidatePages(VALIDATECALLBACK fn) const {
 }
 
 /*!
- * \brief Frees all empty pages
+ * \brief Same as DumpMemoryInUse, with the pages split across worker threads. The callback is still called from the
+ * calling thread, in the same order. Throws an exception if the sweep can't be set up. (Memory allocation problem)
+ *
+ * \param fn Callback to call for each block
+ * \param threads How many threads to use, 0 for one per hardware thread
+ *
+ * \return Amount of blocks still in use
  */
-unsigned ObjectAllocator::FreeEmptyPages() {
-  GenericObject *current_page = page_list;
-  unsigned deleted = 0;
+unsigned ObjectAllocator::DumpMemoryInUseParallel(DUMPCALLBACK fn, unsigned threads) const {
+  std::vector<std::vector<const void *>> found;
 
-  while (current_page != nullptr) {
-    GenericObject *next_page = current_page->Next;
+  try {
+    std::vector<const PageInfo *> pages;
+    for (GenericObject *current_page = page_list; current_page != nullptr; current_page = current_page->Next) {
+      pages.push_back(page_index_get(current_page));
+    }
+
+    // Without the bitmap or headers a block is only known to be free by being in a free list, which is hashed once
+    // instead of walked for every block
+    std::unordered_set<const GenericObject *> free_blocks;
+    if (!config.OccupancyBitmap_ && config.HBlockInfo_.type_ == OAConfig::hbNone) {
+      for (const GenericObject *object = free_list_head(); object != nullptr; object = object->Next) {
+        free_blocks.insert(object);
+      }
 
-    u8 *objects_start = reinterpret_cast<u8 *>(current_page) + sizeof(void *) + config.LeftAlignSize_ +
-                        config.HBlockInfo_.size_ + config.PadBytes_;
+      for (const PageInfo *info : pages) {
+        for (const GenericObject *object = info->free_list; object != nullptr; object = object->Next) {
+          free_blocks.insert(object);
+        }
+      }
+    }
 
-    bool empty_page = true;
-    u8 *current_object = objects_start;
+    unsigned partitions = partition_count(threads, pages.size());
+    found.resize(partitions);
 
-    for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
-      if (!object_check_is_free(reinterpret_cast<GenericObject *>(current_object))) {
-        empty_page = false;
-        break;
+    run_partitioned(pages.size(), partitions, [&](size_t begin, size_t end, unsigned partition) {
+      for (size_t i = begin; i < end; i++) {
+        page_dump(pages[i], free_blocks, found[partition]);
       }
+    });
 
-      current_object += block_size;
-    }
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while sweeping the pages.");
+  }
 
-    if (empty_page) {
-      current_object = objects_start;
+  return report_blocks(found, fn, object_size);
+}
 
-      for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
-        generic_object_remove(free_objects_list, reinterpret_cast<GenericObject *>(current_object));
+/*!
+ * \brief Same as ValidatePages, with the pages split across worker threads. The callback is still called from the
+ * calling thread, in the same order. Throws an exception if the sweep can't be set up. (Memory allocation problem)
+ *
+ * \param fn Callback to call for each block
+ * \param threads How many threads to use, 0 for one per hardware thread
+ *
+ * \return Amount of blocks corrupted
+ */
+unsigned ObjectAllocator::ValidatePagesParallel(VALIDATECALLBACK fn, unsigned threads) const {
+  if (!config.DebugOn_ || config.PadBytes_ == 0) {
+    return 0;
+  }
 
-        current_object += block_size;
-        if (stats.FreeObjects_ > 0) {
-          stats.FreeObjects_--;
-        }
+  std::vector<std::vector<const void *>> found;
+
+  try {
+    std::vector<const GenericObject *> pages;
+    for (GenericObject *current_page = page_list; current_page != nullptr; current_page = current_page->Next) {
+      if (page_index_get(current_page)->sampled) {
+        pages.push_back(current_page);
       }
+    }
 
-      generic_object_remove(page_list, current_page);
-      delete[] reinterpret_cast<u8 *>(current_page);
+    unsigned partitions = partition_count(threads, pages.size());
+    found.resize(partitions);
 
-      stats.PagesInUse_--;
-      deleted++;
-    }
+    run_partitioned(pages.size(), partitions, [&](size_t begin, size_t end, unsigned partition) {
+      for (size_t i = begin; i < end; i++) {
+        page_validate(pages[i], fn, &found[partition]);
+      }
+    });
 
-    current_page = next_page;
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while sweeping the pages.");
   }
 
-  return deleted;
+  return report_blocks(found, fn, object_size);
 }
 
 /*!
- * \brief Returns true if FreeEmptyPages and alignments are implemented
+ * \brief Validates the next few blocks, continuing where the previous call stopped and starting over once every
+ * page was scrubbed. Checks the pads, and when the bitmap or the headers tell which blocks are free, that free blocks
+ * still hold the freed signature and that the headers agree with the bitmap. Only works with DebugOn_.
  *
- * \return Whether extra credit was implemented
- */
-bool ObjectAllocator::ImplementedExtraCredit() { return true; }
-
-/*!
- * \brief Modifies the debug state
+ * \param fn Callback to call for each corrupted block
+ * \param max_blocks Stop after this many blocks, 0 for no limit
+ * \param max_microseconds Stop after about this long, 0 for no limit
  *
- * \param State Whether to enable or disable debug features
+ * \return Amount of blocks corrupted among the ones scrubbed, a call never goes past the end of a pass
  */
-void ObjectAllocator::SetDebugState(bool State) { config.DebugOn_ = State; }
+unsigned ObjectAllocator::ScrubPages(VALIDATECALLBACK fn, unsigned max_blocks, unsigned max_microseconds) {
+  if (!config.DebugOn_ || page_list == nullptr) {
+    return 0;
+  }
+
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(max_microseconds);
+  unsigned scrubbed = 0;
+  unsigned corrupted = 0;
+
+  auto in_budget = [&]() {
+    if (max_blocks != 0 && scrubbed >= max_blocks) {
+      return false;
+    }
+
+    return max_microseconds == 0 || scrubbed % SCRUB_CLOCK_STRIDE != 0 || scrubbed == 0 ||
+           std::chrono::steady_clock::now() < deadline;
+  };
+
+  while (in_budget()) {
+    if (scrub_page == nullptr) {
+      scrub_page = page_list;
+      scrub_block = 0;
+    }
+
+    // Unsampled pages were never signed, and unformatted blocks hold garbage
+    const PageInfo *info = page_index_get(scrub_page);
+    if (!info->sampled) {
+      scrub_block = config.ObjectsPerPage_;
+    }
+    scrub_block = std::max(scrub_block, lazy_unformatted(scrub_page));
+
+    for (; scrub_block < config.ObjectsPerPage_ && in_budget(); scrub_block++, scrubbed++) {
+      if (!block_scrub(info, scrub_block)) {
+        fn(reinterpret_cast<u8 *>(scrub_page) + sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ +
+               config.PadBytes_ + scrub_block * block_size,
+           object_size);
+        corrupted++;
+      }
+    }
+
+    if (scrub_block < config.ObjectsPerPage_) {
+      break;
+    }
+
+    scrub_page = scrub_page->Next;
+    scrub_block = 0;
+
+    if (scrub_page == nullptr) {
+      stats.ScrubPasses_++;
+      break;
+    }
+  }
+
+  return corrupted;
+}
+
+/*!
+ * \brief Frees all empty pages without allocating. Throws an exception if a queued remote free can't be applied, no
+ * page is freed then. (Invalid object)
+ *
+ * \return Amount of pages freed
+ */
+unsigned ObjectAllocator::FreeEmptyPages() {
+  uint64_t concurrent_head = 0;
+
+  // The lock-free list is only stable while no other thread uses the allocator, which this requires anyway
+  if (config.ConcurrentFreeList_) {
+    concurrent_head = concurrent_free_list.load(std::memory_order_acquire);
+    free_objects_list = tagged_pointer(concurrent_head);
+    page_recount_live();
+  }
+
+  // Queued frees may be all that keeps a page from being empty
+  DrainRemoteFrees();
+
+  unsigned empty_pages = 0;
+
+  for (const PageInfo *info : page_index) {
+    if (info->live_objects == 0) {
+      empty_pages++;
+    }
+  }
+
+  if (empty_pages == 0) {
+    return 0;
+  }
+
+  bool slab_policy = config.PagePolicy_ == OAConfig::ppFullestPageFirst;
+
+  // The unformatted blocks of the lazy page are counted as free but never listed
+  size_t listed_empty_blocks = empty_pages * config.ObjectsPerPage_;
+  if (lazy_page != nullptr && page_index_get(lazy_page)->live_objects == 0) {
+    listed_empty_blocks -= lazy_blocks;
+  }
+
+  // Trimming once everything is freed: every listed block is on an empty page, so the list goes as a whole
+  bool drop_list = !slab_policy && !config.ConcurrentFreeList_ &&
+                   stats.FreeObjects_ - lazy_blocks == listed_empty_blocks;
+
+  if (slab_policy) {
+    // Empty pages keep their blocks to themselves, dropping the pages drops the blocks
+    slab_lists[0] = nullptr;
+    stats.FreeObjects_ -= empty_pages * config.ObjectsPerPage_;
+  }
+
+  if (drop_list) {
+    free_objects_list = nullptr;
+    stats.FreeObjects_ -= static_cast<unsigned>(listed_empty_blocks);
+  }
+
+  // One pass over the free list unlinks every block that lives on an empty page. Blocks freed one after the other
+  // usually share a page, which the lookup remembers, and AlignedPages_ finds the page by masking.
+  GenericObject **link = &free_objects_list;
+  while (*link != nullptr) {
+    const PageInfo *info = page_index_find(reinterpret_cast<u8 *>(*link));
+
+    if (info != nullptr && info->live_objects == 0) {
+      *link = (*link)->Next;
+      stats.FreeObjects_--;
+    } else {
+      link = &(*link)->Next;
+    }
+  }
+
+  link = &page_list;
+  while (*link != nullptr) {
+    GenericObject *current_page = *link;
+
+    if (page_index_get(current_page)->live_objects == 0) {
+      // The scrubber moves on to the page that was after this one
+      if (current_page == scrub_page) {
+        scrub_page = current_page->Next;
+        scrub_block = 0;
+      }
+
+      if (current_page == lazy_page) {
+        stats.FreeObjects_ -= lazy_blocks;
+        lazy_page = nullptr;
+        lazy_blocks = 0;
+      }
+
+      *link = current_page->Next;
+      free_page(current_page);
+      stats.PagesInUse_--;
+    } else {
+      link = &current_page->Next;
+    }
+  }
+
+  // The index is compacted in place, the bookkeeping of the pages freed above goes with it
+  size_t kept = 0;
+
+  for (PageInfo *info : page_index) {
+    if (info->live_objects != 0) {
+      page_index[kept++] = info;
+      continue;
+    }
+
+    if (page_debug(info)) {
+      stats.SampledPages_--;
+    }
+
+    page_table.erase(info->page);
+    delete info;
+  }
+
+  page_index.resize(kept);
+  last_found_page = nullptr;
+
+  if (config.ConcurrentFreeList_) {
+    concurrent_free_list.store(tagged_pack(free_objects_list, tagged_next(concurrent_head)), std::memory_order_release);
+  }
+
+  return empty_pages;
+}
+
+/*!
+ * \brief Returns true if FreeEmptyPages and alignments are implemented
+ *
+ * \return Whether extra credit was implemented
+ */
+bool ObjectAllocator::ImplementedExtraCredit() { return true; }
+
+/*!
+ * \brief Modifies the debug state. SampledPages_ follows it, the pages picked by DebugSampleRate_ stay the same.
+ *
+ * \param State Whether to enable or disable debug features
+ */
+void ObjectAllocator::SetDebugState(bool State) {
+  config.DebugOn_ = State;
+  signing = State;
+
+  stats.SampledPages_ = 0;
+  for (const PageInfo *info : page_index) {
+    if (page_debug(info)) {
+      stats.SampledPages_++;
+    }
+  }
+}
 
 /*!
  * \brief Getter for the list of free objects in the allocator
  *
  * \return Pointer to the head of the list
  */
-const void *ObjectAllocator::GetFreeList() const { return free_objects_list; }
+const void *ObjectAllocator::GetFreeList() const {
+  if (config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    const PageInfo *info = slab_select_page();
+    return info != nullptr ? info->free_list : nullptr;
+  }
+
+  return free_list_head();
+}
 
 /*!
  * \brief Getter for the list of pages being used by the allocator
@@ -249,11 +1075,56 @@ const void *ObjectAllocator::GetPageList() const { return page_list; }
 OAConfig ObjectAllocator::GetConfig() const { return config; }
 
 /*!
- * \brief Getter for the statistics of the allocator
+ * \brief Getter for the statistics of the allocator. With ConcurrentFreeList_ the snapshot is approximate: the
+ * counter stripes are added up while other threads keep updating them. A free is never counted without its
+ * allocation, but a block freed and taken again before its free is counted shows up twice, so ObjectsInUse_ is
+ * clamped to what the pages hold and FreeObjects_ is derived from it.
  *
  * \return The statistics of the allocator
  */
-OAStats ObjectAllocator::GetStats() const { return stats; }
+OAStats ObjectAllocator::GetStats() const {
+  if (!config.ConcurrentFreeList_) {
+    return stats;
+  }
+
+  std::lock_guard<std::mutex> lock(page_mutex);
+  OAStats output = stats;
+
+  concurrent_totals(output.Allocations_, output.Deallocations_);
+  output.ObjectsInUse_ = concurrent_peak_update();
+  output.MostObjects_ = concurrent_most_objects.load(std::memory_order_relaxed);
+
+  if (!config.UseCPPMemManager_) {
+    // A block freed and taken again before its free is counted shows up twice, never more than the pages hold
+    unsigned capacity = output.PagesInUse_ * config.ObjectsPerPage_;
+    output.ObjectsInUse_ = std::min(output.ObjectsInUse_, capacity);
+    output.FreeObjects_ = capacity - output.ObjectsInUse_;
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Getter for the objects in use per label, kept as they are allocated and freed so no page is walked. Only
+ * tracked with hbExternal headers (and not with ConcurrentFreeList_). Throws an exception if there is no memory for
+ * the result. (Memory allocation problem)
+ *
+ * \return One entry per distinct label in the order they were first seen, the first one for no label. Empty when
+ * labels aren't tracked.
+ */
+std::vector<LabelStats> ObjectAllocator::GetLabelStats() const {
+  return header_pool != nullptr ? header_pool->GetLabelStats(object_size) : std::vector<LabelStats>();
+}
+
+/*!
+ * \brief Getter for the events kept by the flight recorder (see FlightRecorder_). Throws an exception if there is no
+ * memory for the result. (Memory allocation problem)
+ *
+ * \return The events, oldest first. Empty when the recorder is off.
+ */
+std::vector<FlightEvent> ObjectAllocator::GetRecentEvents() const {
+  return flight_recorder != nullptr ? flight_recorder->GetEvents() : std::vector<FlightEvent>();
+}
 
 /*!
  * \brief Use the C++ native memory allocator to allocate an object
@@ -265,194 +1136,1221 @@ GenericObject *ObjectAllocator::cpp_mem_manager_allocate() {
   try {
     new_object = new u8[page_size];
 
-  } catch (const std::bad_alloc &) {
-    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
+  }
+
+  return reinterpret_cast<GenericObject *>(new_object);
+}
+
+/*!
+ * \brief Use the C++ native memory allocator to free an object from memory
+ *
+ * \param object Pointer to the object to free
+ */
+void ObjectAllocator::cpp_mem_manager_free(void *object) { delete[] static_cast<u8 *>(object); }
+
+/*!
+ * \brief Use the custom object allocator to allocate an object in memory
+ *
+ * \param label The label to put in the external header
+ * \param alloc_num The allocation number of this request
+ * \return Pointer to the object's location in memory
+ */
+GenericObject *ObjectAllocator::custom_mem_manager_allocate(const char *label, unsigned alloc_num) {
+  PageInfo *info = nullptr;
+
+  if (config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    info = slab_select_page();
+
+    if (info == nullptr && remote_drain() > 0) {
+      info = slab_select_page();
+    }
+
+    if (info == nullptr) {
+      page_push_front(allocate_page());
+      info = slab_select_page();
+    }
+
+  } else if (free_objects_list == nullptr && lazy_blocks == 0) {
+    // Frees queued by other threads are reused before growing
+    remote_drain();
+
+    if (free_objects_list == nullptr) {
+      page_push_front(allocate_page());
+    }
+  }
+
+  bool carve = free_objects_list == nullptr && lazy_blocks > 0;
+
+  // The page decides whether the block gets signed, so it is looked up before the block is taken
+  if (info == nullptr) {
+    info = carve ? page_index_get(lazy_page) : page_index_find(reinterpret_cast<u8 *>(free_objects_list));
+  }
+  signing = page_debug(info);
+
+  // With eager formatting the unformatted blocks would be at the end of the free list
+  GenericObject *output = carve ? lazy_carve() : object_pop_front(object_free_list(info));
+  header_update_alloc(output, label, alloc_num);
+  object_mark(info, output, true);
+
+  return output;
+}
+
+/*!
+ * \brief Use the custom memory allocator to free an object from memory
+ *
+ * \param object Pointer to the object to free
+ */
+void ObjectAllocator::custom_mem_manager_free(void *object) {
+
+  GenericObject *cast_object = static_cast<GenericObject *>(object);
+  PageInfo *info = page_index_find(reinterpret_cast<u8 *>(cast_object));
+
+  if (page_debug(info)) {
+    stats.DebugChecks_++;
+
+    try {
+      object_validate_free(cast_object, true);
+
+    } catch (const OAException &) {
+      stats.DebugHits_++;
+      throw;
+    }
+  }
+
+  signing = page_debug(info);
+  header_update_dealloc(cast_object);
+  object_mark(info, cast_object, false);
+  object_push_front(object_free_list(info), cast_object, FREED_PATTERN);
+}
+
+/*!
+ * \brief Signs the object and its padding with the given pattern (debug only)
+ *
+ * \param object The object to sign
+ * \param signature Pattern to sign the space with
+ */
+void ObjectAllocator::object_sign(GenericObject *object, const unsigned char signature) {
+  if (signing) {
+    OALayout::block_sign(object, object_size, config.PadBytes_, signature);
+  }
+}
+
+/*!
+ * \brief Runs the debug checks on an object the client wants to free. Throws an exception if the object can't be
+ * freed. (Invalid object)
+ *
+ * \param object The object to check
+ * \param check_multiple_free Whether to look for the object being freed already
+ */
+void ObjectAllocator::object_validate_free(GenericObject *object, bool check_multiple_free) const {
+  if (!object_validate_location(object)) {
+    throw OAException(
+        OAException::E_BAD_BOUNDARY, "The memory address lies outside of the allocated blocks' boundaries");
+  }
+
+  if (check_multiple_free && object_check_is_free(object)) {
+    throw OAException(OAException::E_MULTIPLE_FREE, "The object is being deallocated multiple times");
+  }
+
+  if (!object_validate_padding(object)) {
+    throw OAException(
+        OAException::E_CORRUPTED_BLOCK,
+        "The object's padding bytes have been corrupted, check pointer math in your code");
+  }
+}
+
+/*!
+ * \brief Links object in such a way that it is the front of the free object list
+ *
+ * \param head The head of the free list to insert into
+ * \param object The object that will be inserted into the linked list
+ * \param signature Pattern to sign the space with
+ */
+void ObjectAllocator::object_push_front(GenericObject *&head, GenericObject *object, const unsigned char signature) {
+  if (object == nullptr) {
+    return;
+  }
+
+  object_sign(object, signature);
+
+  object->Next = head;
+  head = object;
+
+  stats.FreeObjects_++;
+}
+
+/*!
+ * \brief Returns the first object in a free list
+ *
+ * \param head The head of the free list to take from
+ * \return The pointer to the object's location
+ */
+GenericObject *ObjectAllocator::object_pop_front(GenericObject *&head) {
+  if (head == nullptr) {
+    return nullptr;
+  }
+
+  GenericObject *output = head;
+  head = head->Next;
+
+  write_signature(output, ALLOCATED_PATTERN, object_size);
+
+  stats.FreeObjects_--;
+  return output;
+}
+
+/*!
+ * \brief Factory method for a page in memory.
+ *
+ * \return Pointer to allocated page
+ */
+GenericObject *ObjectAllocator::allocate_page() {
+  if (config.MaxPages_ != 0 && stats.PagesInUse_ + 1 > config.MaxPages_) {
+    throw OAException(OAException::E_NO_PAGES, "The maximum amount of pages has been allocated");
+  }
+
+  PageProvider *provider = page_provider();
+
+  u8 *new_page = nullptr;
+  if (provider != nullptr) {
+    new_page = static_cast<u8 *>(provider->AllocatePage(page_size, page_alignment));
+
+    if (new_page == nullptr) {
+      throw OAException(OAException::E_NO_MEMORY, "The page provider is out of memory.");
+    }
+
+  } else {
+    try {
+      new_page = new u8[page_size];
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
+    }
+  }
+
+  GenericObject *new_obj = reinterpret_cast<GenericObject *>(new_page);
+  new_obj->Next = nullptr;
+
+  flight_record(FlightEvent::fePageAllocate, new_obj, 0);
+
+  return new_obj;
+}
+
+/*!
+ * \brief Updates `free_object_list` to include the pointers to the next available blocks. It also adds the page to
+ * the `page_list`.
+ *
+ * \param page The page to add
+ */
+void ObjectAllocator::page_push_front(GenericObject *page) {
+  if (page == nullptr) {
+    return;
+  }
+
+  // Every byte of the page has to be addressable by a tagged pointer
+  uint64_t page_end = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(page) + page_size);
+  if (config.ConcurrentFreeList_ && (page_end & ~TAGGED_POINTER_MASK) != 0) {
+    free_page(page);
+    throw OAException(OAException::E_NO_MEMORY, "The page lies outside of the range a tagged pointer can hold.");
+  }
+
+  PageInfo *info = nullptr;
+  try {
+    info = page_index_insert(page);
+
+  } catch (const OAException &) {
+    free_page(page);
+    throw;
+  }
+
+  if (!config.ConcurrentFreeList_) {
+    signing = page_debug(info);
+  }
+
+  // The lock-free list gets the whole page at once, once it has been formatted
+  GenericObject *page_chain = nullptr;
+  GenericObject *&free_list = config.ConcurrentFreeList_ ? page_chain : object_free_list(info);
+
+  u8 *raw_page = reinterpret_cast<u8 *>(page);
+  write_signature(raw_page + sizeof(void *), ALIGN_PATTERN, config.LeftAlignSize_);
+
+  u8 *current_data = raw_page + sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+
+  // The blocks are formatted by lazy_carve as they are needed
+  size_t formatted_blocks = config.ObjectsPerPage_;
+  if (config.LazyPageFormat_) {
+    lazy_page = page;
+    lazy_blocks = config.ObjectsPerPage_;
+    stats.FreeObjects_ += config.ObjectsPerPage_;
+    formatted_blocks = 0;
+  }
+
+  for (size_t i = 0; i < formatted_blocks; i++) {
+    GenericObject *current_object = reinterpret_cast<GenericObject *>(current_data);
+
+    header_initialize(current_object);
+    object_push_front(free_list, current_object, UNALLOCATED_PATTERN);
+
+    if (i + 1 < config.ObjectsPerPage_) {
+      write_signature(current_data + object_size + config.PadBytes_, ALIGN_PATTERN, config.InterAlignSize_);
+    }
+
+    current_data += block_size;
+  }
+
+  page->Next = page_list;
+  page_list = page;
+
+  if (config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    slab_link(info);
+  }
+
+  if (config.ConcurrentFreeList_ && page_chain != nullptr) {
+    GenericObject *first_block = reinterpret_cast<GenericObject *>(
+        raw_page + sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_);
+    concurrent_push(page_chain, first_block);
+  }
+
+  stats.PagesInUse_++;
+}
+
+/*!
+ * \brief Formats the last unformatted block of the lazy page and hands it out, as if it was popped off the free list
+ *
+ * \return The block
+ */
+GenericObject *ObjectAllocator::lazy_carve() {
+  lazy_blocks--;
+
+  u8 *raw_page = reinterpret_cast<u8 *>(lazy_page);
+  u8 *block = raw_page + sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_ +
+              lazy_blocks * block_size;
+
+  GenericObject *output = reinterpret_cast<GenericObject *>(block);
+
+  header_initialize(output);
+  object_sign(output, ALLOCATED_PATTERN);
+
+  if (lazy_blocks + 1 < config.ObjectsPerPage_) {
+    write_signature(block + object_size + config.PadBytes_, ALIGN_PATTERN, config.InterAlignSize_);
+  }
+
+  if (lazy_blocks == 0) {
+    lazy_page = nullptr;
+  }
+
+  stats.FreeObjects_--;
+  return output;
+}
+
+/*!
+ * \brief Returns how many blocks at the start of a page are unformatted
+ *
+ * \param page The page to check
+ * \return The amount of blocks, 0 for every page but the lazy one
+ */
+size_t ObjectAllocator::lazy_unformatted(const GenericObject *page) const {
+  return page == lazy_page ? lazy_blocks : 0;
+}
+
+/*!
+ * \brief Checks if an object lies in the unformatted part of the lazy page
+ *
+ * \param object The object to check
+ * \return Whether the object was never handed out
+ */
+bool ObjectAllocator::lazy_contains(const GenericObject *object) const {
+  if (lazy_blocks == 0) {
+    return false;
+  }
+
+  const u8 *blocks_start = reinterpret_cast<const u8 *>(lazy_page) + sizeof(void *) + config.LeftAlignSize_ +
+                           config.HBlockInfo_.size_ + config.PadBytes_;
+  const u8 *address = reinterpret_cast<const u8 *>(object);
+
+  return blocks_start <= address && address < blocks_start + lazy_blocks * block_size;
+}
+
+/*!
+ * \brief Decides whether a new page gets the debug checks
+ *
+ * \return True for about one page in DebugSampleRate_, always true when sampling is off
+ */
+bool ObjectAllocator::page_sample() {
+  if (config.DebugSampleRate_ <= 1) {
+    return true;
+  }
+
+  // Xorshift keeps the choice from lining up with a periodic allocation pattern the way a counter would
+  sample_state ^= sample_state << 13;
+  sample_state ^= sample_state >> 17;
+  sample_state ^= sample_state << 5;
+
+  return sample_state % config.DebugSampleRate_ == 0;
+}
+
+/*!
+ * \brief Returns whether the debug checks and signatures apply to a page
+ *
+ * \param info The bookkeeping of the page, nullptr for an address outside every page
+ * \return Whether debugging is on for the page
+ */
+bool ObjectAllocator::page_debug(const PageInfo *info) const {
+  return config.DebugOn_ && (info == nullptr || info->sampled);
+}
+
+/*!
+ * \brief Returns the memory of a page to where it came from (never throws)
+ *
+ * \param page The page to free
+ */
+void ObjectAllocator::free_page(GenericObject *page) {
+  flight_record(FlightEvent::fePageFree, page, 0);
+
+  PageProvider *provider = page_provider();
+
+  if (provider != nullptr) {
+    provider->FreePage(page, page_size, page_alignment);
+  } else {
+    delete[] reinterpret_cast<u8 *>(page);
+  }
+}
+
+/*!
+ * \brief Returns where the pages come from
+ *
+ * \return The provider, nullptr for plain new[]
+ */
+PageProvider *ObjectAllocator::page_provider() const {
+  // new[] can't align beyond std::max_align_t, so aligned pages always go through a provider
+  static HeapPageProvider aligned_heap;
+
+  return config.AlignedPages_ && config.PageProvider_ == nullptr ? &aligned_heap : config.PageProvider_;
+}
+
+/*!
+ * \brief Calls the callback fn for each block of a page whose padding is corrupted
+ *
+ * \param page The page to check
+ * \param fn Callback to call for each block
+ * \param found When given, the blocks are added to it instead of being passed to fn
+ * \return Amount of blocks corrupted
+ */
+unsigned ObjectAllocator::page_validate(
+    const GenericObject *page, VALIDATECALLBACK fn, std::vector<const void *> *found) const {
+  size_t first = lazy_unformatted(page);
+  u8 *object = reinterpret_cast<u8 *>(const_cast<GenericObject *>(page)) + sizeof(void *) + config.LeftAlignSize_ +
+               config.HBlockInfo_.size_ + config.PadBytes_ + first * block_size;
+
+  // Without headers or alignment bytes a right pad runs straight into the next left pad, both are checked at once
+  bool merged_pads = config.HBlockInfo_.size_ == 0 && config.InterAlignSize_ == 0;
+  bool left_intact = OAPattern::matches(object - config.PadBytes_, PAD_PATTERN, config.PadBytes_);
+  unsigned corrupted = 0;
+
+  for (size_t i = first; i < config.ObjectsPerPage_; i++) {
+    u8 *right_pad = object + object_size;
+    bool has_next = i + 1 < config.ObjectsPerPage_;
+    bool right_intact = false;
+    bool next_left_intact = false;
+
+    if (merged_pads && has_next && OAPattern::matches(right_pad, PAD_PATTERN, 2 * config.PadBytes_)) {
+      right_intact = true;
+      next_left_intact = true;
+
+    } else {
+      right_intact = OAPattern::matches(right_pad, PAD_PATTERN, config.PadBytes_);
+
+      if (has_next) {
+        u8 *next_object = object + block_size;
+        next_left_intact = OAPattern::matches(next_object - config.PadBytes_, PAD_PATTERN, config.PadBytes_);
+      }
+    }
+
+    if (!left_intact || !right_intact) {
+      if (found != nullptr) {
+        found->push_back(object);
+      } else {
+        fn(object, object_size);
+      }
+
+      corrupted++;
+    }
+
+    left_intact = next_left_intact;
+    object += block_size;
+  }
+
+  return corrupted;
+}
+
+/*!
+ * \brief Checks one block the way ScrubPages does
+ *
+ * \param info The bookkeeping of the block's page
+ * \param index The index of the block in the page
+ * \return Whether the block is intact
+ */
+bool ObjectAllocator::block_scrub(const PageInfo *info, size_t index) const {
+  u8 *object = reinterpret_cast<u8 *>(info->page) + sizeof(void *) + config.LeftAlignSize_ +
+               config.HBlockInfo_.size_ + config.PadBytes_ + index * block_size;
+  GenericObject *block = reinterpret_cast<GenericObject *>(object);
+
+  if (!OALayout::pads_intact(object, object_size, config.PadBytes_)) {
+    return false;
+  }
+
+  // Without either, telling a free block apart means walking the free list
+  bool has_headers = config.HBlockInfo_.type_ != OAConfig::hbNone;
+  if (!config.OccupancyBitmap_ && !has_headers) {
+    return true;
+  }
+
+  bool is_free = has_headers ? object_header_is_free(block) : false;
+  if (config.OccupancyBitmap_) {
+    bool bitmap_free = !OALayout::bit_test(info->occupancy, index);
+
+    if (has_headers && bitmap_free != is_free) {
+      return false;
+    }
+
+    is_free = bitmap_free;
+  }
+
+  if (!is_free || object_size <= sizeof(GenericObject)) {
+    return true;
+  }
+
+  // A free block is all signature past its link, anything else was written after the free
+  u8 *body = object + sizeof(GenericObject);
+  size_t body_size = object_size - sizeof(GenericObject);
+
+  return OAPattern::matches(body, FREED_PATTERN, body_size) || OAPattern::matches(body, UNALLOCATED_PATTERN, body_size);
+}
+
+/*!
+ * \brief Collects the blocks of a page still in use. Only reads the allocator, so pages can be dumped in parallel.
+ *
+ * \param info The bookkeeping of the page
+ * \param free_blocks Every free block, only used without the occupancy bitmap or headers
+ * \param found Receives the blocks in use
+ */
+void ObjectAllocator::page_dump(
+    const PageInfo *info, const std::unordered_set<const GenericObject *> &free_blocks,
+    std::vector<const void *> &found) const {
+  size_t first = lazy_unformatted(info->page);
+  u8 *object = reinterpret_cast<u8 *>(info->page) + sizeof(void *) + config.LeftAlignSize_ +
+               config.HBlockInfo_.size_ + config.PadBytes_ + first * block_size;
+
+  for (size_t i = first; i < config.ObjectsPerPage_; i++) {
+    GenericObject *block = reinterpret_cast<GenericObject *>(object);
+    bool is_free = false;
+
+    if (config.OccupancyBitmap_) {
+      is_free = !OALayout::bit_test(info->occupancy, i);
+    } else if (config.HBlockInfo_.type_ == OAConfig::hbNone) {
+      is_free = free_blocks.count(block) != 0;
+    } else {
+      is_free = object_header_is_free(block);
+    }
+
+    if (!is_free) {
+      found.push_back(object);
+    }
+
+    object += block_size;
+  }
+}
+
+/*!
+ * \brief Returns the first page in the list. It will not check if a page has objects in use or not.
+ *
+ * \return The page at the front of the list
+ */
+GenericObject *ObjectAllocator::page_pop_front() {
+  if (page_list == nullptr) {
+    return nullptr;
+  }
+
+  GenericObject *output = page_list;
+  page_list = page_list->Next;
+  page_index_erase(output);
+
+  if (output == scrub_page) {
+    scrub_page = page_list;
+    scrub_block = 0;
+  }
+
+  // Unformatted blocks hold garbage instead of header pointers
+  size_t first = lazy_unformatted(output);
+  if (output == lazy_page) {
+    lazy_page = nullptr;
+    lazy_blocks = 0;
+  }
+
+  if (config.HBlockInfo_.type_ == OAConfig::hbExternal) {
+    u8 *header_location =
+        reinterpret_cast<u8 *>(output) + sizeof(void *) + config.LeftAlignSize_ + first * block_size;
+    for (size_t i = first; i < config.ObjectsPerPage_; i++) {
+      MemBlockInfo **header_ptr_ptr = reinterpret_cast<MemBlockInfo **>(header_location);
+      header_external_delete(header_ptr_ptr);
+      header_location += block_size;
+    }
+  }
+
+  stats.PagesInUse_--;
+  return output;
+}
+
+/*!
+ * \brief Adds a page to the address sorted page index. Throws an exception if the index can't grow.
+ *
+ * \param page The page to add
+ * \return The bookkeeping created for the page
+ */
+ObjectAllocator::PageInfo *ObjectAllocator::page_index_insert(GenericObject *page) {
+  auto position = std::upper_bound(
+      page_index.begin(), page_index.end(), page, [](GenericObject *value, PageInfo *info) {
+        return std::less<GenericObject *>()(value, info->page);
+      });
+
+  PageInfo *info = nullptr;
+  try {
+    info = new PageInfo{page, 0, std::vector<uint64_t>(), nullptr, nullptr, nullptr, page_sample()};
+
+    if (config.OccupancyBitmap_) {
+      info->occupancy.assign((config.ObjectsPerPage_ + 63) / 64, 0);
+    }
+
+    if (config.AlignedPages_) {
+      page_table.emplace(page, info);
+    }
+
+    page_index.insert(position, info);
+
+  } catch (const std::bad_alloc &) {
+    page_table.erase(page);
+    delete info;
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while growing the page index.");
+  }
+
+  if (page_debug(info)) {
+    stats.SampledPages_++;
+  }
+
+  return info;
+}
+
+/*!
+ * \brief Removes a page from the address sorted page index
+ *
+ * \param page The page to remove
+ */
+void ObjectAllocator::page_index_erase(GenericObject *page) {
+  auto position = std::lower_bound(
+      page_index.begin(), page_index.end(), page, [](PageInfo *info, GenericObject *value) {
+        return std::less<GenericObject *>()(info->page, value);
+      });
+
+  if (position != page_index.end() && (*position)->page == page) {
+    if (last_found_page == *position) {
+      last_found_page = nullptr;
+    }
+
+    if (config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+      slab_unlink(*position);
+    }
+
+    if (page_debug(*position)) {
+      stats.SampledPages_--;
+    }
+
+    page_table.erase(page);
+    delete *position;
+    page_index.erase(position);
+  }
+}
+
+/*!
+ * \brief Binary searches the page index for the bookkeeping of a page
+ *
+ * \param page The page to look for
+ * \return The bookkeeping of the page, nullptr if the page is not in the index
+ */
+ObjectAllocator::PageInfo *ObjectAllocator::page_index_get(GenericObject *page) const {
+  if (config.AlignedPages_) {
+    auto position = page_table.find(page);
+    return position != page_table.end() ? position->second : nullptr;
+  }
+
+  auto position = std::lower_bound(
+      page_index.begin(), page_index.end(), page, [](PageInfo *info, GenericObject *value) {
+        return std::less<GenericObject *>()(info->page, value);
+      });
+
+  return (position != page_index.end() && (*position)->page == page) ? *position : nullptr;
+}
+
+/*!
+ * \brief Finds the page that contains the address, by masking with AlignedPages_ and with a binary search otherwise
+ *
+ * \param address The address to look for
+ * \return The bookkeeping of the page containing the address, nullptr if there is none
+ */
+ObjectAllocator::PageInfo *ObjectAllocator::page_index_find(u8 *address) const {
+  if (config.AlignedPages_) {
+    uintptr_t page_address = reinterpret_cast<uintptr_t>(address) & ~(page_alignment - 1);
+    GenericObject *page = reinterpret_cast<GenericObject *>(page_address);
+    auto position = page_table.find(page);
+
+    // The rounding past page_size belongs to no page
+    if (position == page_table.end() || !OALayout::page_contains(page, page_size, address)) {
+      return nullptr;
+    }
+
+    return position->second;
+  }
+
+  if (last_found_page != nullptr && OALayout::page_contains(last_found_page->page, page_size, address)) {
+    return last_found_page;
+  }
+
+  auto position = OALayout::page_find(
+      page_index.begin(), page_index.end(), address, page_size, [](const PageInfo *info) { return info->page; });
+
+  if (position == page_index.end()) {
+    return nullptr;
+  }
+
+  last_found_page = *position;
+  return *position;
+}
+
+/*!
+ * \brief Adds the page to the slab list matching its live object count
+ *
+ * \param info The page to link
+ */
+void ObjectAllocator::slab_link(PageInfo *info) {
+  PageInfo *&head = slab_lists[info->live_objects];
+
+  info->slab_prev = nullptr;
+  info->slab_next = head;
+  if (head != nullptr) {
+    head->slab_prev = info;
+  }
+  head = info;
+
+  // Only partial pages are candidates for the fullest page search
+  if (info->live_objects < config.ObjectsPerPage_ && info->live_objects > slab_fullest_hint) {
+    slab_fullest_hint = info->live_objects;
+  }
+}
+
+/*!
+ * \brief Removes the page from the slab list matching its live object count
+ *
+ * \param info The page to unlink
+ */
+void ObjectAllocator::slab_unlink(PageInfo *info) {
+  if (info->slab_prev != nullptr) {
+    info->slab_prev->slab_next = info->slab_next;
+  } else if (slab_lists[info->live_objects] == info) {
+    slab_lists[info->live_objects] = info->slab_next;
+  }
+
+  if (info->slab_next != nullptr) {
+    info->slab_next->slab_prev = info->slab_prev;
+  }
+
+  info->slab_prev = nullptr;
+  info->slab_next = nullptr;
+}
+
+/*!
+ * \brief Picks the page the next allocation is served from: the fullest partial page, or else an empty one
+ *
+ * \return The chosen page, nullptr when every page is full
+ */
+ObjectAllocator::PageInfo *ObjectAllocator::slab_select_page() const {
+  // The hint only ever overestimates, so walking down from it finds the fullest partial page
+  while (slab_fullest_hint > 0) {
+    if (slab_lists[slab_fullest_hint] != nullptr) {
+      return slab_lists[slab_fullest_hint];
+    }
+
+    slab_fullest_hint--;
+  }
+
+  return slab_lists[0];
+}
+
+/*!
+ * \brief Returns the head of the global free list, reading the lock-free stack with ConcurrentFreeList_
+ *
+ * \return The first free object
+ */
+GenericObject *ObjectAllocator::free_list_head() const {
+  if (config.ConcurrentFreeList_) {
+    return tagged_pointer(concurrent_free_list.load(std::memory_order_acquire));
+  }
+
+  return free_objects_list;
+}
+
+/*!
+ * \brief Pushes a chain of linked objects onto the lock-free free list in one step
+ *
+ * \param first The first object of the chain
+ * \param last The last object of the chain, its Next gets overwritten
+ */
+void ObjectAllocator::concurrent_push(GenericObject *first, GenericObject *last) {
+  uint64_t head = concurrent_free_list.load(std::memory_order_relaxed);
+  uint64_t new_head = 0;
+
+  do {
+    last->Next = tagged_pointer(head);
+    new_head = tagged_pack(first, tagged_next(head));
+  } while (!concurrent_free_list.compare_exchange_weak(
+      head, new_head, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/*!
+ * \brief Pops the first object of the lock-free free list
+ *
+ * \return The object, nullptr if the list is empty
+ */
+GenericObject *ObjectAllocator::concurrent_pop() {
+  uint64_t head = concurrent_free_list.load(std::memory_order_acquire);
+
+  while (tagged_pointer(head) != nullptr) {
+    // Next may be stale if another thread popped the object first, the tag makes the exchange fail in that case
+    uint64_t new_head = tagged_pack(concurrent_next(tagged_pointer(head)), tagged_next(head));
+
+    if (concurrent_free_list.compare_exchange_weak(
+            head, new_head, std::memory_order_acquire, std::memory_order_acquire)) {
+      return tagged_pointer(head);
+    }
+  }
+
+  return nullptr;
+}
+
+/*!
+ * \brief Allocates with ConcurrentFreeList_, growing a page under page_mutex when the free list runs dry
+ *
+ * \param label The label to put in the external header
+ * \param alloc_num The allocation number of this request
+ * \return Pointer to the object's location in memory
+ */
+GenericObject *ObjectAllocator::concurrent_allocate(const char *label, unsigned alloc_num) {
+  GenericObject *output = concurrent_pop();
+
+  while (output == nullptr) {
+    {
+      std::lock_guard<std::mutex> lock(page_mutex);
+
+      // Another thread may have grown the list while this one was waiting
+      if (free_list_head() == nullptr) {
+        page_push_front(allocate_page());
+      }
+    }
+
+    output = concurrent_pop();
+  }
+
+  write_signature(output, ALLOCATED_PATTERN, object_size);
+  header_update_alloc(output, label, alloc_num);
+
+  return output;
+}
+
+/*!
+ * \brief Frees with ConcurrentFreeList_, debug frees are serialized on page_mutex
+ *
+ * \param object Pointer to the object to free
+ */
+void ObjectAllocator::concurrent_free(GenericObject *object) {
+  std::unique_lock<std::mutex> lock(page_mutex, std::defer_lock);
+
+  if (config.DebugOn_) {
+    lock.lock();
+
+    // Without headers the only record of a free block is the free list, which other threads are changing
+    object_validate_free(object, config.HBlockInfo_.type_ != OAConfig::hbNone);
+  }
+
+  // In debug mode the block is marked free and pushed before the lock is released, so a second free of it always
+  // fails the check
+  header_update_dealloc(object);
+  object_sign(object, FREED_PATTERN);
+  concurrent_push(object, object);
+}
+
+/*!
+ * \brief Adds up the counter stripes of ConcurrentFreeList_
+ *
+ * \param allocations Receives the total allocations
+ * \param deallocations Receives the total frees
+ */
+void ObjectAllocator::concurrent_totals(uint64_t &allocations, uint64_t &deallocations) const {
+  allocations = 0;
+  deallocations = 0;
+
+  // Frees are read first, every free counted was preceded by an allocation the second pass will see. Each stripe is
+  // read at a different moment, so the totals are not a snapshot of a single instant.
+  for (const StatStripe &stripe : stat_stripes) {
+    deallocations += stripe.deallocations.load(std::memory_order_acquire);
+  }
+
+  for (const StatStripe &stripe : stat_stripes) {
+    allocations += stripe.allocations.load(std::memory_order_acquire);
+  }
+}
+
+/*!
+ * \brief Raises the sampled MostObjects_ of ConcurrentFreeList_ to the objects in use right now
+ *
+ * \return The objects in use
+ */
+unsigned ObjectAllocator::concurrent_peak_update() const {
+  uint64_t allocations = 0;
+  uint64_t deallocations = 0;
+  concurrent_totals(allocations, deallocations);
+
+  unsigned in_use = allocations > deallocations ? static_cast<unsigned>(allocations - deallocations) : 0;
+  unsigned most_objects = concurrent_most_objects.load(std::memory_order_relaxed);
+
+  while (in_use > most_objects &&
+         !concurrent_most_objects.compare_exchange_weak(most_objects, in_use, std::memory_order_relaxed)) {
+  }
+
+  return in_use;
+}
+
+/*!
+ * \brief Gets a queue entry for an object freed by a thread other than the owner, a spare one if there is any.
+ * Throws an exception if the object is nullptr or there is no memory for the entry. (Invalid object or memory
+ * allocation problem)
+ *
+ * \param object The object to free
+ * \return The entry, not linked to any other
+ */
+ObjectAllocator::RemoteFree *ObjectAllocator::remote_entry(void *object) {
+  if (object == nullptr) {
+    throw OAException(
+        OAException::E_BAD_BOUNDARY, "The memory address lies outside of the allocated blocks' boundaries");
+  }
+
+  uint64_t head = remote_spare_list.load(std::memory_order_acquire);
+  RemoteFree *entry = tagged_pointer<RemoteFree>(head);
+
+  while (entry != nullptr) {
+    // next may be stale if another thread took the entry first, the tag makes the exchange fail in that case
+    uint64_t new_head = tagged_pack(entry->next.load(std::memory_order_relaxed), tagged_next(head));
+
+    if (remote_spare_list.compare_exchange_weak(
+            head, new_head, std::memory_order_acquire, std::memory_order_acquire)) {
+      break;
+    }
+
+    entry = tagged_pointer<RemoteFree>(head);
   }
 
-  return reinterpret_cast<GenericObject *>(new_object);
+  if (entry == nullptr) {
+    try {
+      entry = new RemoteFree();
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while queuing a remote free.");
+    }
+  }
+
+  entry->next.store(nullptr, std::memory_order_relaxed);
+  entry->object = object;
+
+  return entry;
 }
 
 /*!
- * \brief Use the C++ native memory allocator to free an object from memory
+ * \brief Keeps a queue entry that is no longer needed for reuse (never throws)
  *
- * \param object Pointer to the object to free
+ * \param entry The entry, on no list
  */
-void ObjectAllocator::cpp_mem_manager_free(void *object) { delete[] static_cast<u8 *>(object); }
+void ObjectAllocator::remote_recycle(RemoteFree *entry) {
+  uint64_t head = remote_spare_list.load(std::memory_order_relaxed);
+  uint64_t new_head = 0;
+
+  do {
+    entry->next.store(tagged_pointer<RemoteFree>(head), std::memory_order_relaxed);
+    new_head = tagged_pack(entry, tagged_next(head));
+  } while (!remote_spare_list.compare_exchange_weak(
+      head, new_head, std::memory_order_release, std::memory_order_relaxed));
+}
 
 /*!
- * \brief Use the custom object allocator to allocate an object in memory
+ * \brief Queues a chain of linked entries in one step
  *
- * \return Pointer to the object's location in memory
+ * \param first The first entry of the chain
+ * \param last The last entry of the chain, its next gets overwritten
  */
-GenericObject *ObjectAllocator::custom_mem_manager_allocate(const char *label) {
-  if (free_objects_list == nullptr) {
-    page_push_front(allocate_page());
-  }
-
-  GenericObject *output = object_pop_front();
-  header_update_alloc(output, label);
+void ObjectAllocator::remote_push(RemoteFree *first, RemoteFree *last) {
+  // Push only, the owner takes the whole queue at once, so there is no ABA to guard against
+  RemoteFree *head = remote_free_list.load(std::memory_order_relaxed);
 
-  return output;
+  do {
+    last->next.store(head, std::memory_order_relaxed);
+  } while (!remote_free_list.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
 }
 
 /*!
- * \brief Use the custom memory allocator to free an object from memory
+ * \brief Applies the queued remote frees, DrainRemoteFrees without the flight recorder dump. Throws an exception if
+ * a queued object can't be freed, that object is dropped and the rest stay queued. (Invalid object)
  *
- * \param object Pointer to the object to free
+ * \return Amount of objects freed
  */
-void ObjectAllocator::custom_mem_manager_free(void *object) {
+unsigned ObjectAllocator::remote_drain() {
+  if (!config.RemoteFreeQueue_) {
+    return 0;
+  }
 
-  GenericObject *cast_object = static_cast<GenericObject *>(object);
+  // Leftovers of a drain that threw go first, the queue is picked up on the next call
+  if (remote_pending == nullptr) {
+    RemoteFree *queued = remote_free_list.exchange(nullptr, std::memory_order_acquire);
 
-  if (config.DebugOn_) {
-    if (!object_validate_location(cast_object)) {
-      throw OAException(
-          OAException::E_BAD_BOUNDARY, "The memory address lies outside of the allocated blocks' boundaries");
+    // The queue is newest first, reversing it applies the frees in the order they happened
+    while (queued != nullptr) {
+      RemoteFree *next = queued->next.load(std::memory_order_relaxed);
+      queued->next.store(remote_pending, std::memory_order_relaxed);
+      remote_pending = queued;
+      queued = next;
     }
+  }
 
-    if (object_check_is_free(cast_object)) {
-      throw OAException(OAException::E_MULTIPLE_FREE, "The object is being deallocated multiple times");
-    }
+  unsigned drained = 0;
 
-    if (!object_validate_padding(cast_object)) {
-      throw OAException(
-          OAException::E_CORRUPTED_BLOCK,
-          "The object's padding bytes have been corrupted, check pointer math in your code");
-    }
+  while (remote_pending != nullptr) {
+    RemoteFree *entry = remote_pending;
+    remote_pending = entry->next.load(std::memory_order_relaxed);
+
+    // The entry is spent before the free is checked, so an object that can't be freed is dropped
+    GenericObject *object = static_cast<GenericObject *>(entry->object);
+    remote_recycle(entry);
+
+    flight_record(FlightEvent::feFree, object, 0);
+    custom_mem_manager_free(object);
+
+    stats.Deallocations_++;
+    stats.ObjectsInUse_--;
+    drained++;
   }
 
-  header_update_dealloc(cast_object);
-  object_push_front(cast_object, FREED_PATTERN);
+  return drained;
 }
 
 /*!
- * \brief Links object in such a way that it is the front of the free object list
+ * \brief Records an event with the flight recorder, if there is one
  *
- * \param object The object that will be inserted into the linked list
- * \param signature Pattern to sign the space with
+ * \param type What happened
+ * \param address The object or the page
+ * \param alloc_num The allocation number, 0 if there is none
  */
-void ObjectAllocator::object_push_front(GenericObject *object, const unsigned char signature) {
-  if (object == nullptr) {
+void ObjectAllocator::flight_record(FlightEvent::EVENT_TYPE type, const void *address, unsigned alloc_num) {
+  if (flight_recorder != nullptr) {
+    flight_recorder->Record(type, address, alloc_num);
+  }
+}
+
+/*!
+ * \brief Hands the recorded events to FlightRecorderDump_, called while an OAException is on its way to the client
+ * (never throws by itself)
+ */
+void ObjectAllocator::flight_dump() const {
+  if (flight_recorder == nullptr || config.FlightRecorderDump_ == nullptr) {
     return;
   }
 
-  write_signature(object, signature, object_size);
+  std::vector<FlightEvent> events;
 
-  // Writing padding
-  u8 *raw_object = reinterpret_cast<u8 *>(object);
-  if (config.PadBytes_ > 0) {
-    write_signature(raw_object - config.PadBytes_, PAD_PATTERN, config.PadBytes_);
-    write_signature(raw_object + object_size, PAD_PATTERN, config.PadBytes_);
-  }
+  // Failing to copy the events must not hide the exception that is being reported
+  try {
+    events = flight_recorder->GetEvents();
 
-  object->Next = free_objects_list;
-  free_objects_list = object;
+  } catch (const OAException &) {
+    return;
+  }
 
-  stats.FreeObjects_++;
+  config.FlightRecorderDump_(events.data(), static_cast<unsigned>(events.size()));
 }
 
 /*!
- * \brief Returns the first object in the free_objects_list
+ * \brief Whether the batch calls can work on the free list directly instead of calling Allocate/Free per object
  *
- * \return The pointer to the object's location
+ * \return True for a single threaded global free list of eagerly formatted pages
  */
-GenericObject *ObjectAllocator::object_pop_front() {
-  if (free_objects_list == nullptr) {
-    return nullptr;
-  }
-
-  GenericObject *output = free_objects_list;
-  free_objects_list = free_objects_list->Next;
-
-  write_signature(output, ALLOCATED_PATTERN, object_size);
-
-  stats.FreeObjects_--;
-  return output;
+bool ObjectAllocator::batch_fast_path() const {
+  return !config.UseCPPMemManager_ && !config.ConcurrentFreeList_ && !config.LazyPageFormat_ &&
+         config.DebugSampleRate_ <= 1 &&
+         config.PagePolicy_ == OAConfig::ppGlobalFreeList;
 }
 
 /*!
- * \brief Factory method for a page in memory.
+ * \brief Grows the pages a batch needs behind the free blocks already listed, so blocks come out as if Allocate had
+ * grown them. Throws an exception before growing if the pages would go past MaxPages_. (Memory allocation problem)
  *
- * \return Pointer to allocated page
+ * \param count How many more free objects are needed
+ * \param tail The last block of the free list, nullptr if the list is empty
+ * \return The first new block
  */
-GenericObject *ObjectAllocator::allocate_page() {
-  if (config.MaxPages_ != 0 && stats.PagesInUse_ + 1 > config.MaxPages_) {
+GenericObject *ObjectAllocator::batch_reserve(unsigned count, GenericObject *tail) {
+  unsigned objects_per_page = std::max(config.ObjectsPerPage_, 1u);
+  unsigned missing_pages = (count + objects_per_page - 1) / objects_per_page;
+
+  if (config.MaxPages_ != 0 && stats.PagesInUse_ + missing_pages > config.MaxPages_) {
     throw OAException(OAException::E_NO_PAGES, "The maximum amount of pages has been allocated");
   }
 
-  u8 *new_page = nullptr;
+  size_t first_object =
+      OALayout::first_object_offset(config.PadBytes_, config.HBlockInfo_.size_, config.LeftAlignSize_);
+
+  GenericObject *head = free_objects_list;
+  GenericObject *first_new = nullptr;
+
   try {
-    new_page = new u8[page_size];
+    // Each page is formatted on an empty list and appended. Formatting pushes the blocks in address order, so the
+    // page's first block ends its chain and no list is walked for the tail.
+    for (unsigned i = 0; i < missing_pages; i++) {
+      free_objects_list = nullptr;
 
-  } catch (const std::bad_alloc &) {
-    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
-  }
+      GenericObject *page = allocate_page();
+      page_push_front(page);
 
-  GenericObject *new_obj = reinterpret_cast<GenericObject *>(new_page);
-  new_obj->Next = nullptr;
+      if (tail == nullptr) {
+        head = free_objects_list;
+      } else {
+        tail->Next = free_objects_list;
+      }
 
-  return new_obj;
+      first_new = first_new != nullptr ? first_new : free_objects_list;
+      tail = reinterpret_cast<GenericObject *>(reinterpret_cast<u8 *>(page) + first_object);
+    }
+
+  } catch (const OAException &) {
+    free_objects_list = head;
+    throw;
+  }
+
+  free_objects_list = head;
+  return first_new;
 }
 
 /*!
- * \brief Updates `free_object_list` to include the pointers to the next available blocks. It also adds the page to
- * the `page_list`.
+ * \brief Updates the headers of, signs and marks as in use a batch of objects at the front of the free list. Throws
+ * an exception if an external header can't be created, the objects are left untouched then. (Memory allocation
+ * problem)
  *
- * \param page The page to add
+ * \param objects The objects handed to the client
+ * \param count How many objects there are
+ * \param label The label to put in the external headers
  */
-void ObjectAllocator::page_push_front(GenericObject *page) {
-  if (page == nullptr) {
-    return;
-  }
+void ObjectAllocator::batch_update_alloc(void *objects[], unsigned count, const char *label) {
+  unsigned alloc_num = static_cast<unsigned>(stats.Allocations_ + 1);
 
-  u8 *raw_page = reinterpret_cast<u8 *>(page);
-  write_signature(page + config.LeftAlignSize_, ALIGN_PATTERN, config.LeftAlignSize_);
+  switch (config.HBlockInfo_.type_) {
+    case OAConfig::hbNone: break;
 
-  u8 *current_data = raw_page + sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+    case OAConfig::hbBasic:
+      for (unsigned i = 0; i < count; i++) {
+        header_basic_update_alloc(static_cast<GenericObject *>(objects[i]), alloc_num + i);
+      }
+      break;
 
-  for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
-    GenericObject *current_object = reinterpret_cast<GenericObject *>(current_data);
+    case OAConfig::hbExtended:
+      for (unsigned i = 0; i < count; i++) {
+        header_extended_update_alloc(static_cast<GenericObject *>(objects[i]), alloc_num + i);
+      }
+      break;
+
+    case OAConfig::hbExternal:
+      // The only step that can fail, it runs first and is undone so the batch is all or nothing
+      for (unsigned i = 0; i < count; i++) {
+        try {
+          header_external_update_alloc(static_cast<GenericObject *>(objects[i]), label, alloc_num + i);
+
+        } catch (const OAException &) {
+          while (i > 0) {
+            header_external_update_dealloc(static_cast<GenericObject *>(objects[--i]));
+          }
+          throw;
+        }
+      }
+      break;
 
-    header_initialize(current_object);
-    object_push_front(current_object, UNALLOCATED_PATTERN);
+    default: break;
+  }
 
-    if (i + 1 < config.ObjectsPerPage_) {
-      write_signature(current_data + object_size + config.PadBytes_, ALIGN_PATTERN, config.InterAlignSize_);
+  // Signing overwrites the links, the caller walked the run already
+  if (config.DebugOn_) {
+    for (unsigned i = 0; i < count; i++) {
+      write_signature(static_cast<GenericObject *>(objects[i]), ALLOCATED_PATTERN, object_size);
     }
+  }
 
-    current_data += block_size;
+  for (unsigned i = 0; i < count; i++) {
+    GenericObject *object = static_cast<GenericObject *>(objects[i]);
+    object_mark(page_index_find(reinterpret_cast<u8 *>(object)), object, true);
   }
+}
 
-  page->Next = page_list;
-  page_list = page;
+/*!
+ * \brief Updates the headers of a batch of objects being freed
+ *
+ * \param objects The objects returned by the client
+ * \param count How many objects there are
+ */
+void ObjectAllocator::batch_update_dealloc(void *objects[], unsigned count) {
+  switch (config.HBlockInfo_.type_) {
+    case OAConfig::hbNone: break;
 
-  stats.PagesInUse_++;
+    case OAConfig::hbBasic:
+      for (unsigned i = 0; i < count; i++) {
+        header_basic_update_dealloc(static_cast<GenericObject *>(objects[i]));
+      }
+      break;
+
+    case OAConfig::hbExtended:
+      for (unsigned i = 0; i < count; i++) {
+        header_extended_update_dealloc(static_cast<GenericObject *>(objects[i]));
+      }
+      break;
+
+    case OAConfig::hbExternal:
+      for (unsigned i = 0; i < count; i++) {
+        header_external_update_dealloc(static_cast<GenericObject *>(objects[i]));
+      }
+      break;
+
+    default: break;
+  }
 }
 
 /*!
- * \brief Returns the first page in the list. It will not check if a page has objects in use or not.
- *
- * \return The page at the front of the list
+ * \brief Recomputes every page's live object count from the free list. ConcurrentFreeList_ skips that bookkeeping
+ * on the hot path, so it is rebuilt before it is needed.
  */
-GenericObject *ObjectAllocator::page_pop_front() {
-  if (page_list == nullptr) {
-    return nullptr;
+void ObjectAllocator::page_recount_live() {
+  for (PageInfo *info : page_index) {
+    info->live_objects = config.ObjectsPerPage_;
   }
 
-  GenericObject *output = page_list;
-  page_list = page_list->Next;
+  for (GenericObject *current = free_list_head(); current != nullptr; current = current->Next) {
+    PageInfo *info = page_index_find(reinterpret_cast<u8 *>(current));
 
-  if (config.HBlockInfo_.type_ == OAConfig::hbExternal) {
-    u8 *header_location = reinterpret_cast<u8 *>(output) + sizeof(void *) + config.LeftAlignSize_;
-    for (size_t i = 0; i < config.ObjectsPerPage_; i++) {
-      MemBlockInfo **header_ptr_ptr = reinterpret_cast<MemBlockInfo **>(header_location);
-      header_external_delete(header_ptr_ptr);
-      header_location += block_size;
+    if (info != nullptr) {
+      info->live_objects--;
     }
   }
-
-  stats.PagesInUse_--;
-  return output;
 }
 
 /*!
@@ -462,23 +2360,42 @@ GenericObject *ObjectAllocator::page_pop_front() {
  * \return Whether the object has already been freed
  */
 bool ObjectAllocator::object_check_is_free(GenericObject *object) const {
+  if (lazy_contains(object)) {
+    return true;
+  }
+
+  if (config.OccupancyBitmap_) {
+    const PageInfo *info = page_index_find(reinterpret_cast<u8 *>(object));
+    if (info == nullptr) {
+      return false;
+    }
+
+    return !OALayout::bit_test(info->occupancy, object_block_index(info, object));
+  }
+
+  if (config.HBlockInfo_.type_ == OAConfig::hbNone) {
+    return object_is_in_free_list(object);
+  }
+
+  return object_header_is_free(object);
+}
+
+/*!
+ * \brief Reads the in use flag of an object's header block
+ *
+ * \param object The object to check
+ * \return Whether the header marks the object as free, false without headers
+ */
+bool ObjectAllocator::object_header_is_free(GenericObject *object) const {
   bool is_free = false;
 
   switch (config.HBlockInfo_.type_) {
-    case OAConfig::hbNone: is_free = object_is_in_free_list(object); break;
-
-    case OAConfig::hbBasic: {
-      u8 *reading_location = reinterpret_cast<u8 *>(object) - config.PadBytes_ - config.HBlockInfo_.size_;
-      u8 *flag = reading_location + sizeof(u32);
-      is_free = (*flag) == 0;
-    } break;
+    case OAConfig::hbNone: break;
 
+    case OAConfig::hbBasic:
     case OAConfig::hbExtended: {
       u8 *reading_location = reinterpret_cast<u8 *>(object) - config.PadBytes_ - config.HBlockInfo_.size_;
-      reading_location += config.HBlockInfo_.additional_;
-      reading_location += sizeof(u16);
-      u8 *flag = reading_location + sizeof(u32);
-      is_free = (*flag) == 0;
+      is_free = OALayout::header_is_free(reading_location, config.HBlockInfo_.size_);
     } break;
 
     case OAConfig::hbExternal: {
@@ -493,13 +2410,18 @@ bool ObjectAllocator::object_check_is_free(GenericObject *object) const {
 }
 
 /*!
- * \brief Checks if the object is in the free_objects_list
+ * \brief Checks if the object is in the free list that holds its page's free blocks
  *
  * \param object The object to look for in the list
  * \return Whether the object is in the list
  */
 bool ObjectAllocator::object_is_in_free_list(GenericObject *object) const {
-  GenericObject *current_object = free_objects_list;
+  GenericObject *current_object = free_list_head();
+
+  if (config.PagePolicy_ == OAConfig::ppFullestPageFirst) {
+    const PageInfo *info = page_index_find(reinterpret_cast<u8 *>(object));
+    current_object = info != nullptr ? info->free_list : nullptr;
+  }
 
   while (current_object != nullptr) {
     if (object == current_object) {
@@ -528,16 +2450,10 @@ bool ObjectAllocator::object_validate_location(GenericObject *location) const {
     return false;
   }
 
-  u8 *raw_location = reinterpret_cast<u8 *>(location);
-  u8 *blocks_start = reinterpret_cast<u8 *>(page) +
-                     (sizeof(void *) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_);
-
-  ptrdiff_t distance = raw_location - blocks_start;
-  if (distance < 0) {
-    return false;
-  }
+  size_t first_object =
+      OALayout::first_object_offset(config.PadBytes_, config.HBlockInfo_.size_, config.LeftAlignSize_);
 
-  return static_cast<size_t>(distance) % block_size == 0;
+  return OALayout::is_block(page, first_object, block_size, location);
 }
 
 /*!
@@ -547,17 +2463,8 @@ bool ObjectAllocator::object_validate_location(GenericObject *location) const {
  * \return The page in which the object is located
  */
 GenericObject *ObjectAllocator::object_is_inside_page(GenericObject *object) const {
-  GenericObject *current_page = page_list;
-
-  while (current_page != nullptr) {
-    if (is_in_range(reinterpret_cast<u8 *>(current_page), page_size, reinterpret_cast<u8 *>(object))) {
-      return current_page;
-    }
-
-    current_page = current_page->Next;
-  }
-
-  return nullptr;
+  PageInfo *info = page_index_find(reinterpret_cast<u8 *>(object));
+  return info != nullptr ? info->page : nullptr;
 }
 
 /*!
@@ -571,19 +2478,70 @@ bool ObjectAllocator::object_validate_padding(GenericObject *object) const {
     return true;
   }
 
-  u8 *left_pad_start = reinterpret_cast<u8 *>(object) - config.PadBytes_;
-  u8 *right_pad_start = reinterpret_cast<u8 *>(object) + object_size;
+  return OALayout::pads_intact(object, object_size, config.PadBytes_);
+}
+
+/*!
+ * \brief Returns the position of the object within its page
+ *
+ * \param info The page the object belongs to
+ * \param object The object to locate
+ * \return The index of the block in the page
+ */
+size_t ObjectAllocator::object_block_index(const PageInfo *info, GenericObject *object) const {
+  size_t first_object =
+      OALayout::first_object_offset(config.PadBytes_, config.HBlockInfo_.size_, config.LeftAlignSize_);
 
-  for (size_t i = 0; i < config.PadBytes_; i++) {
-    u8 left_pad = *(left_pad_start + i);
-    u8 right_pad = *(right_pad_start + i);
+  return OALayout::block_index(info->page, first_object, block_size, object);
+}
 
-    if (left_pad != PAD_PATTERN || right_pad != PAD_PATTERN) {
-      return false;
-    }
+/*!
+ * \brief Updates the bookkeeping of the object's page: its live object count, its slab list and, if enabled, the
+ * occupancy bit
+ *
+ * \param info The page the object belongs to
+ * \param object The object that changed state
+ * \param in_use Whether the object is now owned by the client
+ */
+void ObjectAllocator::object_mark(PageInfo *info, GenericObject *object, bool in_use) {
+  if (info == nullptr) {
+    return;
+  }
+
+  bool slab_policy = config.PagePolicy_ == OAConfig::ppFullestPageFirst;
+  if (slab_policy) {
+    slab_unlink(info);
+  }
+
+  if (in_use) {
+    info->live_objects++;
+  } else {
+    info->live_objects--;
+  }
+
+  if (slab_policy) {
+    slab_link(info);
+  }
+
+  if (!config.OccupancyBitmap_) {
+    return;
+  }
+
+  OALayout::bit_assign(info->occupancy, object_block_index(info, object), in_use);
+}
+
+/*!
+ * \brief Returns the free list the object's page keeps its free blocks in
+ *
+ * \param info The page the free list is needed for (may be nullptr)
+ * \return The per-page free list with ppFullestPageFirst, the global free list otherwise
+ */
+GenericObject *&ObjectAllocator::object_free_list(PageInfo *info) {
+  if (config.PagePolicy_ == OAConfig::ppFullestPageFirst && info != nullptr) {
+    return info->free_list;
   }
 
-  return true;
+  return free_objects_list;
 }
 
 /*!
@@ -608,12 +2566,7 @@ void ObjectAllocator::header_initialize(GenericObject *block_location) {
  */
 void ObjectAllocator::header_basic_initialize(GenericObject *block_location) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  *allocation_number = 0;
-
-  u8 *flag = writing_location + sizeof(u32);
-  (*flag) = 0;
+  OALayout::header_clear(writing_location, config.HBlockInfo_.size_);
 }
 
 /*!
@@ -623,20 +2576,7 @@ void ObjectAllocator::header_basic_initialize(GenericObject *block_location) {
  */
 void ObjectAllocator::header_extended_initialize(GenericObject *block_location) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  memset(writing_location, 0, config.HBlockInfo_.additional_);
-
-  writing_location += config.HBlockInfo_.additional_;
-  u16 *use_counter = reinterpret_cast<u16 *>(writing_location);
-  (*use_counter) = 0;
-
-  writing_location += sizeof(u16);
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  (*allocation_number) = 0;
-
-  writing_location += sizeof(u32);
-  u8 *flag = writing_location;
-  (*flag) = 0;
+  OALayout::header_clear(writing_location, config.HBlockInfo_.size_);
 }
 
 /*!
@@ -655,13 +2595,15 @@ void ObjectAllocator::header_external_initialize(GenericObject *block_location)
  * \brief This function will update the allocation data of the corresponding header
  *
  * \param block_location Where the block is located (pointer to start of data)
+ * \param label The label to put in the external header
+ * \param alloc_num The allocation number to record
  */
-void ObjectAllocator::header_update_alloc(GenericObject *block_location, const char *label) {
+void ObjectAllocator::header_update_alloc(GenericObject *block_location, const char *label, unsigned alloc_num) {
   switch (config.HBlockInfo_.type_) {
     case OAConfig::hbNone: break;
-    case OAConfig::hbBasic: header_basic_update_alloc(block_location); break;
-    case OAConfig::hbExtended: header_extended_update_alloc(block_location); break;
-    case OAConfig::hbExternal: header_external_update_alloc(block_location, label); break;
+    case OAConfig::hbBasic: header_basic_update_alloc(block_location, alloc_num); break;
+    case OAConfig::hbExtended: header_extended_update_alloc(block_location, alloc_num); break;
+    case OAConfig::hbExternal: header_external_update_alloc(block_location, label, alloc_num); break;
     default: break;
   }
 }
@@ -670,60 +2612,67 @@ void ObjectAllocator::header_update_alloc(GenericObject *block_location, const c
  * \brief This function will update a basic header's data
  *
  * \param block_location Where the block is located (pointer to start of data)
+ * \param alloc_num The allocation number to record
  */
-void ObjectAllocator::header_basic_update_alloc(GenericObject *block_location) {
+void ObjectAllocator::header_basic_update_alloc(GenericObject *block_location, unsigned alloc_num) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  (*allocation_number) = static_cast<u32>(stats.Allocations_ + 1);
-
-  u8 *flag = writing_location + sizeof(u32);
-  (*flag) |= 1;
+  OALayout::header_mark_allocated(writing_location, config.HBlockInfo_.size_, false, alloc_num);
 }
 
 /*!
  * \brief This function will update the extended header due to an allocation
  *
  * \param block_location Where the block is located (pointer to start of data)
+ * \param alloc_num The allocation number to record
  */
-void ObjectAllocator::header_extended_update_alloc(GenericObject *block_location) {
+void ObjectAllocator::header_extended_update_alloc(GenericObject *block_location, unsigned alloc_num) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  writing_location += config.HBlockInfo_.additional_;
-  u16 *use_counter = reinterpret_cast<u16 *>(writing_location);
-  (*use_counter)++;
-
-  writing_location += sizeof(u16);
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  (*allocation_number) = static_cast<u32>(stats.Allocations_ + 1);
-
-  writing_location += sizeof(u32);
-  u8 *flag = writing_location;
-  (*flag) |= 1;
+  OALayout::header_mark_allocated(writing_location, config.HBlockInfo_.size_, true, alloc_num);
 }
 
 /*!
  * \brief This function will update the external header due to an allocation. This means it will allocate the header
- * with the corresponding data.
+ * with the corresponding data. Throws an exception if there is no memory, the header is left as it was then.
+ * (Memory allocation problem)
  *
  * \param block_location Where the block is located (pointer to start of data)
+ * \param label The label to put in the external header
+ * \param alloc_num The allocation number to record
  */
-void ObjectAllocator::header_external_update_alloc(GenericObject *block_location, const char *label) {
+void ObjectAllocator::header_external_update_alloc(
+    GenericObject *block_location, const char *label, unsigned alloc_num) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
 
   MemBlockInfo **header_ptr_ptr = reinterpret_cast<MemBlockInfo **>(writing_location);
-  *header_ptr_ptr = new MemBlockInfo;
 
-  (*header_ptr_ptr)->in_use = true;
-  (*header_ptr_ptr)->alloc_num = stats.Allocations_ + 1;
+  if (header_pool != nullptr) {
+    *header_ptr_ptr = header_pool->Allocate(label, alloc_num);
+    return;
+  }
+
+  // Both parts are made before the header is stored, so a failure leaves no half made header behind
+  char *label_copy = nullptr;
+  MemBlockInfo *header = nullptr;
 
-  if (label != nullptr) {
-    char *label_copy = new char[strlen(label) + 1];
-    strcpy(label_copy, label);
-    (*header_ptr_ptr)->label = label_copy;
-  } else {
-    (*header_ptr_ptr)->label = nullptr;
+  try {
+    if (label != nullptr) {
+      label_copy = new char[strlen(label) + 1];
+      strcpy(label_copy, label);
+    }
+
+    header = new MemBlockInfo;
+
+  } catch (const std::bad_alloc &) {
+    delete[] label_copy;
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating an external header.");
   }
+
+  header->in_use = true;
+  header->alloc_num = alloc_num;
+  header->label_id = 0;
+  header->label = label_copy;
+
+  *header_ptr_ptr = header;
 }
 
 /*!
@@ -748,13 +2697,7 @@ void ObjectAllocator::header_update_dealloc(GenericObject *block_location) {
  */
 void ObjectAllocator::header_basic_update_dealloc(GenericObject *block_location) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  (*allocation_number) = 0;
-
-  u8 *flag = writing_location + sizeof(u32);
-  int cast_flag = static_cast<int>(*flag);
-  (*flag) = static_cast<u8>(cast_flag & ~1);
+  OALayout::header_mark_free(writing_location, config.HBlockInfo_.size_);
 }
 
 /*!
@@ -764,15 +2707,7 @@ void ObjectAllocator::header_basic_update_dealloc(GenericObject *block_location)
  */
 void ObjectAllocator::header_extended_update_dealloc(GenericObject *block_location) {
   u8 *writing_location = reinterpret_cast<u8 *>(block_location) - config.PadBytes_ - config.HBlockInfo_.size_;
-
-  writing_location += config.HBlockInfo_.additional_ + sizeof(u16);
-  u32 *allocation_number = reinterpret_cast<u32 *>(writing_location);
-  (*allocation_number) = 0;
-
-  writing_location += sizeof(u32);
-  u8 *flag = writing_location;
-  int cast_flag = static_cast<int>(*flag);
-  (*flag) = static_cast<u8>(cast_flag & ~1);
+  OALayout::header_mark_free(writing_location, config.HBlockInfo_.size_);
 }
 
 /*!
@@ -799,12 +2734,17 @@ void ObjectAllocator::header_external_delete(MemBlockInfo **header_ptr_ptr) {
   }
 
   MemBlockInfo *header_ptr = *header_ptr_ptr;
+  *header_ptr_ptr = nullptr;
+
+  if (header_pool != nullptr) {
+    header_pool->Free(header_ptr);
+    return;
+  }
+
   if (header_ptr->label != nullptr) {
     delete[] header_ptr->label;
   }
   delete header_ptr;
-
-  *header_ptr_ptr = nullptr;
 }
 
 /*!
@@ -814,13 +2754,7 @@ void ObjectAllocator::header_external_delete(MemBlockInfo **header_ptr_ptr) {
  * \return The size of the header
  */
 size_t ObjectAllocator::get_header_size(OAConfig::HeaderBlockInfo info) const {
-  switch (info.type_) {
-    case OAConfig::hbNone: return 0;
-    case OAConfig::hbBasic: return OAConfig::BASIC_HEADER_SIZE;
-    case OAConfig::hbExtended: return info.size_;
-    case OAConfig::hbExternal: return sizeof(void *);
-    default: return 0;
-  }
+  return OALayout::header_size(info.type_, info.additional_);
 }
 
 /*!
@@ -829,9 +2763,8 @@ size_t ObjectAllocator::get_header_size(OAConfig::HeaderBlockInfo info) const {
  * \return The size of the left alignment bytes
  */
 size_t ObjectAllocator::calculate_left_alignment_size() const {
-  if (config.Alignment_ <= 0) return 0;
-  size_t remainder = (sizeof(void *) + config.PadBytes_ + get_header_size(config.HBlockInfo_)) % config.Alignment_;
-  return (remainder > 0) ? config.Alignment_ - remainder : 0;
+  size_t header = get_header_size(config.HBlockInfo_);
+  return OALayout::left_alignment(config.PadBytes_, header, config.Alignment_);
 }
 
 /*!
@@ -840,11 +2773,8 @@ size_t ObjectAllocator::calculate_left_alignment_size() const {
  * \return The size of the inter alignment bytes
  */
 size_t ObjectAllocator::calculate_inter_alignment_size() const {
-  if (config.Alignment_ <= 0) return 0;
-  size_t chunk_size = get_header_size(config.HBlockInfo_) + (2 * config.PadBytes_) + object_size;
-
-  size_t remainder = chunk_size % config.Alignment_;
-  return (remainder > 0) ? config.Alignment_ - remainder : 0;
+  size_t header = get_header_size(config.HBlockInfo_);
+  return OALayout::inter_alignment(object_size, config.PadBytes_, header, config.Alignment_);
 }
 
 /*!
@@ -853,7 +2783,8 @@ size_t ObjectAllocator::calculate_inter_alignment_size() const {
  * \return The size of a block in a page
  */
 size_t ObjectAllocator::calculate_block_size() const {
-  return get_header_size(config.HBlockInfo_) + (2 * config.PadBytes_) + object_size + config.InterAlignSize_;
+  size_t header = get_header_size(config.HBlockInfo_);
+  return OALayout::block_size(object_size, config.PadBytes_, header, config.InterAlignSize_);
 }
 
 /*!
@@ -862,13 +2793,9 @@ size_t ObjectAllocator::calculate_block_size() const {
  * \return The size of the page
  */
 size_t ObjectAllocator::calculate_page_size() const {
-  size_t chunk_size = get_header_size(config.HBlockInfo_) + (2 * config.PadBytes_) + object_size;
-
-  size_t total = sizeof(void *) + config.LeftAlignSize_;
-  total += config.ObjectsPerPage_ * chunk_size;
-  total += (config.ObjectsPerPage_ - 1) * config.InterAlignSize_;
-
-  return total;
+  return OALayout::page_size(
+      object_size, config.ObjectsPerPage_, config.PadBytes_, get_header_size(config.HBlockInfo_), config.LeftAlignSize_,
+      config.InterAlignSize_);
 }
 
 /*!
@@ -879,7 +2806,7 @@ size_t ObjectAllocator::calculate_page_size() const {
  * \param size The length of the signature
  */
 void ObjectAllocator::write_signature(GenericObject *object, const unsigned char pattern, size_t size) {
-  if (object == nullptr || !config.DebugOn_) {
+  if (object == nullptr || !signing) {
     return;
   }
 
@@ -894,51 +2821,11 @@ void ObjectAllocator::write_signature(GenericObject *object, const unsigned char
  * \param size The length of the signature
  */
 void ObjectAllocator::write_signature(u8 *location, const unsigned char pattern, size_t size) {
-  if (location == nullptr || !config.DebugOn_) {
+  if (location == nullptr || !signing) {
     return;
   }
 
   memset(location, pattern, size);
 }
 
-/*!
- * \brief This will check whether the address is within the range of start and start + length
- *
- * \param start The start of the range
- * \param length The length of the range
- * \param address The location to check bounds
- *
- * \return Whether the address is inside of the provided range
- */
-bool ObjectAllocator::is_in_range(u8 *start, size_t length, u8 *address) const {
-  ptrdiff_t offset = address - start;
-  return 0 < offset && offset < static_cast<intptr_t>(length);
-}
-
-/*!
- * \brief This function will remove a node from the given linked list
- *
- * \param head The head of the list in which the node is in.
- * \param to_remove The node in the list to remove
- */
-void ObjectAllocator::generic_object_remove(GenericObject *&head, GenericObject *to_remove) {
-  GenericObject *current_object = head;
-  GenericObject *previous_object = nullptr;
-
-  while (current_object != nullptr) {
-    if (current_object == to_remove) {
-
-      if (previous_object == nullptr) {
-        head = current_object->Next;
 
-      } else {
-        previous_object->Next = current_object->Next;
-      }
-
-      return;
-    }
-
-    previous_object = current_object;
-    current_object = current_object->Next;
-  }
-}
@@ -12,13 +12,25 @@
 #define OBJECTALLOCATORH
 //---------------------------------------------------------------------------
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 // If the client doesn't specify these:
 static const int DEFAULT_OBJECTS_PER_PAGE = 4;
 static const int DEFAULT_MAX_PAGES = 3;
 
+class FlightRecorder;
+class HeaderPool;
+class PageProvider;
+class TraceWriter;
+
 /*!
   Exception class
 */
@@ -72,6 +84,27 @@ private:
   std::string message_; //!< The formatted string for the user.
 };
 
+/*!
+  One allocator event kept by the flight recorder, see OAConfig::FlightRecorder_
+*/
+struct FlightEvent {
+  /*!
+    What happened
+  */
+  enum EVENT_TYPE {
+    feAllocate, //!< an object was given to the client
+    feFree, //!< the client returned an object, recorded before the object is checked
+    fePageAllocate, //!< a page was added
+    fePageFree //!< a page was released
+  };
+
+  EVENT_TYPE Type_; //!< what happened
+  const void *Address_; //!< the object or the page
+  unsigned AllocNum_; //!< allocation number of an feAllocate, 0 for the rest
+  unsigned Thread_; //!< the thread, numbered from 1 in the order threads first record an event
+  uint64_t Timestamp_; //!< time stamp counter ticks on x86, steady_clock ticks elsewhere (for order and spacing)
+};
+
 /*!
   ObjectAllocator configuration parameters
 */
@@ -84,6 +117,19 @@ struct OAConfig {
   */
   enum HBLOCK_TYPE { hbNone, hbBasic, hbExtended, hbExternal };
 
+  /*!
+    How free blocks are kept and which one is handed out next
+  */
+  enum PAGE_POLICY {
+    ppGlobalFreeList, //!< one LIFO free list shared by every page
+    ppFullestPageFirst //!< per-page free lists, allocate from the most occupied page that still has room
+  };
+
+  /*!
+    Callback that gets the flight recorder events (events, count), oldest first
+  */
+  typedef void (*FLIGHTCALLBACK)(const FlightEvent *, unsigned);
+
   /*!
     POD that stores the information related to the header blocks.
   */
@@ -151,6 +197,17 @@ struct OAConfig {
     HBlockInfo_ = HBInfo;
     LeftAlignSize_ = 0;
     InterAlignSize_ = 0;
+    OccupancyBitmap_ = false;
+    PagePolicy_ = ppGlobalFreeList;
+    ConcurrentFreeList_ = false;
+    RemoteFreeQueue_ = false;
+    PageProvider_ = nullptr;
+    AlignedPages_ = false;
+    LazyPageFormat_ = false;
+    DebugSampleRate_ = 1;
+    FlightRecorder_ = 0;
+    FlightRecorderDump_ = nullptr;
+    TraceWriter_ = nullptr;
   }
 
   bool UseCPPMemManager_; //!< by-pass the functionality of the OA and use new/delete
@@ -162,10 +219,81 @@ struct OAConfig {
   unsigned Alignment_; //!< address alignment of each block
   unsigned LeftAlignSize_; //!< number of alignment bytes required to align first block
   unsigned InterAlignSize_; //!< number of alignment bytes required between remaining blocks
+  bool OccupancyBitmap_; //!< keep one in-use bit per block so free checks never need headers or list scans
+  PAGE_POLICY PagePolicy_; //!< how free blocks are organized across pages
+
+  /*!
+    Allocate/Free may be called from several threads at once. The free list becomes a lock-free stack and page growth
+    is serialized. Forces ppGlobalFreeList without the occupancy bitmap, double frees are only detected with header
+    blocks, and FreeEmptyPages/DumpMemoryInUse/ValidatePages/the destructor need every other thread to be done.
+    Statistics are counted per thread stripe and added up by GetStats into an approximate snapshot, so header
+    allocation numbers are unique but not consecutive and MostObjects_ is sampled.
+  */
+  bool ConcurrentFreeList_;
+
+  /*!
+    Only the owner thread (the constructing thread, see SetOwnerThread) allocates. Frees from other threads go onto a
+    lock-free queue and are applied in bulk by the owner when its free list runs dry, in DrainRemoteFrees or in
+    FreeEmptyPages. The queue keeps the pointers apart from the blocks, so queuing writes nothing to a block: a bad or
+    double free from another thread is only found when the owner applies it (its Allocate may throw it) and leaves the
+    free list intact. Queuing reuses a spent queue entry or allocates one, so a remote free may throw E_NO_MEMORY.
+    Queued frees are not counted in the stats until applied. Ignored with UseCPPMemManager_ or ConcurrentFreeList_.
+  */
+  bool RemoteFreeQueue_;
+
+  /*!
+    Where the pages come from (see PageProvider.h), nullptr means the global heap. Not owned, it has to outlive the
+    allocator. With UseCPPMemManager_ the objects still come from new.
+  */
+  PageProvider *PageProvider_;
+
+  /*!
+    Every page starts at an address aligned to its size rounded up to a power of two, so the page owning an address is
+    found by masking it and a hash lookup instead of a search of the page index. Turns on OccupancyBitmap_ (unless
+    ConcurrentFreeList_), so debug Free and FreeEmptyPages are O(1) per object. Costs the rounding in address space,
+    and in memory for heap pages.
+  */
+  bool AlignedPages_;
+
+  /*!
+    A new page is not formatted up front. Its blocks are carved one at a time, last block first, when the free list
+    runs dry, so page growth is O(1) and unused blocks are never touched. Blocks come out in the same order as with
+    eager formatting. Ignored with ConcurrentFreeList_ or ppFullestPageFirst, and the batch calls fall back to one
+    Allocate per object.
+  */
+  bool LazyPageFormat_;
+
+  /*!
+    With DebugOn_, only about one page in DebugSampleRate_ (picked pseudo-randomly when it's created) gets signatures,
+    free checks and ValidatePages, the rest behave as if DebugOn_ were off. A corruption is then caught with about that
+    probability, at about that fraction of the debug cost. 0 and 1 check every page. Ignored with ConcurrentFreeList_,
+    and the batch calls fall back to one call per object.
+  */
+  unsigned DebugSampleRate_;
+
+  /*!
+    Keeps the last FlightRecorder_ events (rounded up to a power of two) in a ring: objects allocated and freed, pages
+    added and released. An event costs a few stores. 0 turns it off. Frees queued with RemoteFreeQueue_ are recorded
+    when the owner applies them.
+  */
+  unsigned FlightRecorder_;
+
+  /*!
+    With FlightRecorder_, called with the recorded events when an OAException leaves Allocate, Free, the batch calls
+    or DrainRemoteFrees, before the exception reaches the client. nullptr only keeps them for GetRecentEvents.
+  */
+  FLIGHTCALLBACK FlightRecorderDump_;
+
+  /*!
+    Where to stream every Allocate and Free (see AllocationTrace.h), for replay_c. nullptr means no trace. Not owned,
+    it has to outlive the allocator. Costs a locked buffer append per call, meant for capturing production workloads.
+  */
+  TraceWriter *TraceWriter_;
 };
 
 /*!
-  POD that holds the ObjectAllocator statistical info
+  POD that holds the ObjectAllocator statistical info. The totals are 64-bit so they don't wrap, the rest describe the
+  allocator at the time of the snapshot.
 */
 struct OAStats {
   /*!
@@ -173,7 +301,20 @@ struct OAStats {
   */
   OAStats() :
       ObjectSize_(0), PageSize_(0), FreeObjects_(0), ObjectsInUse_(0), PagesInUse_(0), MostObjects_(0), Allocations_(0),
-      Deallocations_(0) {};
+      Deallocations_(0), CacheHits_(0), CacheRefills_(0), CacheFlushes_(0), SampledPages_(0), DebugChecks_(0),
+      DebugHits_(0), ScrubPasses_(0) {};
+
+  /*!
+    Returns the totals accumulated between an earlier snapshot of the same allocator and this one, for rates. Sizes,
+    object and page counts, MostObjects_ and SampledPages_ keep this snapshot's values.
+
+    \param earlier
+      A snapshot taken before this one.
+
+    \return
+      The statistics of the interval.
+  */
+  OAStats Since(const OAStats &earlier) const;
 
   size_t ObjectSize_; //!< size of each object
   size_t PageSize_; //!< size of a page including all headers, padding, etc.
@@ -181,8 +322,43 @@ struct OAStats {
   unsigned ObjectsInUse_; //!< number of objects in use by client
   unsigned PagesInUse_; //!< number of pages allocated
   unsigned MostObjects_; //!< most objects in use by client at one time
-  unsigned Allocations_; //!< total requests to allocate memory
-  unsigned Deallocations_; //!< total requests to free memory
+  uint64_t Allocations_; //!< total requests to allocate memory
+  uint64_t Deallocations_; //!< total requests to free memory
+  uint64_t CacheHits_; //!< requests served by a thread cache without touching the shared allocator
+  uint64_t CacheRefills_; //!< batches moved from the shared allocator into a thread cache
+  uint64_t CacheFlushes_; //!< batches moved from a thread cache back to the shared allocator
+  unsigned SampledPages_; //!< pages in use that get the debug checks (see DebugSampleRate_), none without DebugOn_
+  uint64_t DebugChecks_; //!< frees that went through the debug checks
+  uint64_t DebugHits_; //!< debug checks of a free that found an error
+  uint64_t ScrubPasses_; //!< full passes over the pages ScrubPages has finished
+};
+
+/*!
+  POD that holds the objects of one label, see ObjectAllocator::GetLabelStats
+*/
+struct LabelStats {
+  /*!
+    Constructor
+
+    \param Label
+      The interned label, nullptr for objects allocated without one.
+
+    \param LiveObjects
+      Objects with this label in use by client.
+
+    \param LiveBytes
+      Bytes of those objects.
+
+    \param Allocations
+      Total allocations with this label.
+  */
+  LabelStats(const char *Label = nullptr, unsigned LiveObjects = 0, size_t LiveBytes = 0, uint64_t Allocations = 0) :
+      Label_(Label), LiveObjects_(LiveObjects), LiveBytes_(LiveBytes), Allocations_(Allocations) {}
+
+  const char *Label_; //!< the interned label, nullptr for objects allocated without one
+  unsigned LiveObjects_; //!< objects with this label in use by client
+  size_t LiveBytes_; //!< bytes of those objects
+  uint64_t Allocations_; //!< total allocations with this label
 };
 
 /*!
@@ -197,8 +373,9 @@ struct GenericObject {
 */
 struct MemBlockInfo {
   bool in_use; //!< Is the block free or in use?
-  char *label; //!< A dynamically allocated NUL-terminated string
+  char *label; //!< A dynamically allocated NUL-terminated string, shared by every pooled header with the same label
   unsigned alloc_num; //!< The allocation number (count) of this block
+  unsigned label_id; //!< The interned label, see ObjectAllocator::GetLabelStats (0 without a label or header pool)
 };
 
 /*!
@@ -257,6 +434,38 @@ public:
    */
   void Free(void *Object);
 
+  /*!
+   * \brief Takes count objects at once, handing them out in the same order count calls to Allocate would. Either every
+   * object is allocated or an exception is thrown and none are. (Memory allocation problem)
+   *
+   * \param count How many objects to allocate
+   * \param Objects Receives the pointers to the allocated blocks, must hold count pointers
+   * \param label The label to put in the external headers
+   */
+  void AllocateBatch(unsigned count, void *Objects[], const char *label = 0);
+
+  /*!
+   * \brief Returns count objects at once, same as count calls to Free in order. Throws an exception if an object can't
+   * be freed, the objects before it stay freed. (Invalid object)
+   *
+   * \param Objects Pointers to the blocks to deallocate
+   * \param count How many objects to free
+   */
+  void FreeBatch(void *Objects[], unsigned count);
+
+  /*!
+   * \brief Applies the frees other threads queued with RemoteFreeQueue_ (owner thread only). Throws an exception if a
+   * queued object can't be freed, that object is dropped and the rest stay queued. (Invalid object)
+   *
+   * \return Amount of objects freed
+   */
+  unsigned DrainRemoteFrees();
+
+  /*!
+   * \brief Makes the calling thread the owner for RemoteFreeQueue_. The previous owner must be done allocating.
+   */
+  void SetOwnerThread();
+
   /*!
    * \brief Calls the callback fn for each block still in use
    *
@@ -276,7 +485,45 @@ public:
   unsigned ValidatePages(VALIDATECALLBACK fn) const;
 
   /*!
-   * \brief Frees all empty pages
+   * \brief Same as DumpMemoryInUse, with the pages split across worker threads. The callback is still called from the
+   * calling thread, in the same order. Throws an exception if the sweep can't be set up. (Memory allocation problem)
+   *
+   * \param fn Callback to call for each block
+   * \param threads How many threads to use, 0 for one per hardware thread
+   *
+   * \return Amount of blocks still in use
+   */
+  unsigned DumpMemoryInUseParallel(DUMPCALLBACK fn, unsigned threads = 0) const;
+
+  /*!
+   * \brief Same as ValidatePages, with the pages split across worker threads. The callback is still called from the
+   * calling thread, in the same order. Throws an exception if the sweep can't be set up. (Memory allocation problem)
+   *
+   * \param fn Callback to call for each block
+   * \param threads How many threads to use, 0 for one per hardware thread
+   *
+   * \return Amount of blocks corrupted
+   */
+  unsigned ValidatePagesParallel(VALIDATECALLBACK fn, unsigned threads = 0) const;
+
+  /*!
+   * \brief Validates the next few blocks, continuing where the previous call stopped and starting over once every
+   * page was scrubbed. Checks the pads, and when the bitmap or the headers tell which blocks are free, that free blocks
+   * still hold the freed signature and that the headers agree with the bitmap. Only works with DebugOn_.
+   *
+   * \param fn Callback to call for each corrupted block
+   * \param max_blocks Stop after this many blocks, 0 for no limit
+   * \param max_microseconds Stop after about this long, 0 for no limit
+   *
+   * \return Amount of blocks corrupted among the ones scrubbed, a call never goes past the end of a pass
+   */
+  unsigned ScrubPages(VALIDATECALLBACK fn, unsigned max_blocks, unsigned max_microseconds = 0);
+
+  /*!
+   * \brief Frees all empty pages without allocating. Throws an exception if a queued remote free can't be applied, no
+   * page is freed then. (Invalid object)
+   *
+   * \return Amount of pages freed
    */
   unsigned FreeEmptyPages();
 
@@ -290,14 +537,15 @@ public:
   // Testing/Debugging/Statistic methods
 
   /*!
-   * \brief Modifies the debug state
+   * \brief Modifies the debug state. SampledPages_ follows it, the pages picked by DebugSampleRate_ stay the same.
    *
    * \param State Whether to enable or disable debug features
    */
   void SetDebugState(bool State);
 
   /*!
-   * \brief Getter for the list of free objects in the allocator
+   * \brief Getter for the list of free objects in the allocator. With ppFullestPageFirst this is the free list of the
+   * page that serves the next allocation.
    *
    * \return Pointer to the head of the list
    */
@@ -318,27 +566,104 @@ public:
   OAConfig GetConfig() const;
 
   /*!
-   * \brief Getter for the statistics of the allocator
+   * \brief Getter for the statistics of the allocator. With ConcurrentFreeList_ the snapshot is approximate: the
+   * counter stripes are added up while other threads keep updating them. A free is never counted without its
+   * allocation, but a block freed and taken again before its free is counted shows up twice, so ObjectsInUse_ is
+   * clamped to what the pages hold and FreeObjects_ is derived from it.
    *
    * \return The statistics of the allocator
    */
   OAStats GetStats() const;
 
+  /*!
+   * \brief Getter for the objects in use per label, kept as they are allocated and freed so no page is walked. Only
+   * tracked with hbExternal headers (and not with ConcurrentFreeList_). Throws an exception if there is no memory for
+   * the result. (Memory allocation problem)
+   *
+   * \return One entry per distinct label in the order they were first seen, the first one for no label. Empty when
+   * labels aren't tracked.
+   */
+  std::vector<LabelStats> GetLabelStats() const;
+
+  /*!
+   * \brief Getter for the events kept by the flight recorder (see FlightRecorder_). Throws an exception if there is no
+   * memory for the result. (Memory allocation problem)
+   *
+   * \return The events, oldest first. Empty when the recorder is off.
+   */
+  std::vector<FlightEvent> GetRecentEvents() const;
+
   // Prevent copy construction and assignment
   ObjectAllocator(const ObjectAllocator &oa) = delete; //!< Do not implement!
   ObjectAllocator &operator=(const ObjectAllocator &oa) = delete; //!< Do not implement!
 
 private:
+  struct PageInfo;
+
+  static const unsigned STAT_STRIPES = 16; //!< ConcurrentFreeList_ counter stripes, threads are spread over them
+  static const unsigned PEAK_SAMPLE_INTERVAL = 64; //!< Allocations per stripe between two samples of MostObjects_
+
+  /*!
+    ConcurrentFreeList_ counters of the threads mapped to one stripe. Each stripe is padded to two cache lines, so
+    threads on different stripes never share a line (adjacent line prefetch included).
+  */
+  struct StatStripe {
+    std::atomic<uint64_t> allocations; //!< Allocations made by the threads of this stripe
+    std::atomic<uint64_t> deallocations; //!< Frees made by the threads of this stripe
+    std::atomic<uint64_t> numbers; //!< Allocation numbers handed out, failed allocations included, never goes back
+    char padding[128 - 3 * sizeof(std::atomic<uint64_t>)]; //!< Keeps the next stripe off these cache lines
+  };
+
+  /*!
+    RemoteFreeQueue_ entry of a free queued by another thread. Spent entries are kept for reuse until the allocator
+    is destroyed, so an entry is never unmapped while a thread may still be reading it.
+  */
+  struct RemoteFree {
+    std::atomic<RemoteFree *> next; //!< Atomic, a thread taking a spare entry may read it while it is being reused
+    void *object; //!< The object to free
+  };
+
   GenericObject *page_list;
   GenericObject *free_objects_list;
+  std::vector<PageInfo *> page_index; //!< Bookkeeping for every live page, sorted by page address
+  mutable PageInfo *last_found_page; //!< Page of the last lookup, consecutive objects usually share a page
+  std::unordered_map<GenericObject *, PageInfo *> page_table; //!< AlignedPages_ only, bookkeeping by page address
+  std::vector<PageInfo *> slab_lists; //!< ppFullestPageFirst only, pages bucketed by their live object count
+  mutable size_t slab_fullest_hint; //!< No partial page has more live objects than this
 
   size_t object_size;
   OAConfig config;
   size_t block_size;
   size_t page_size;
+  size_t page_alignment; //!< What every page is aligned to, page_size rounded up to a power of two with AlignedPages_
 
   OAStats stats;
 
+  // LazyPageFormat_ only
+  GenericObject *lazy_page; //!< The page that still has unformatted blocks
+  unsigned lazy_blocks; //!< How many blocks at the start of lazy_page are unformatted
+
+  bool signing; //!< Whether the page being worked on gets signatures, see DebugSampleRate_
+  uint32_t sample_state; //!< DebugSampleRate_ only, xorshift state that picks the sampled pages
+
+  GenericObject *scrub_page; //!< Where ScrubPages continues, nullptr to start a new pass
+  size_t scrub_block; //!< The next block of scrub_page to scrub
+
+  std::unique_ptr<HeaderPool> header_pool; //!< hbExternal only, where headers and labels come from (nullptr = new)
+  std::unique_ptr<FlightRecorder> flight_recorder; //!< FlightRecorder_ only, the recent events
+
+  // ConcurrentFreeList_ only
+  std::atomic<uint64_t> concurrent_free_list; //!< Free list head packed with a version tag against ABA
+  StatStripe stat_stripes[STAT_STRIPES]; //!< Replace stats.Allocations_ and stats.Deallocations_
+  mutable std::atomic<unsigned> concurrent_most_objects; //!< Replaces stats.MostObjects_, sampled
+  mutable std::mutex page_mutex; //!< Serializes page growth and everything that reads the page index
+
+  // RemoteFreeQueue_ only
+  std::thread::id owner_thread; //!< The only thread that allocates and frees directly
+  std::atomic<RemoteFree *> remote_free_list; //!< Frees queued by other threads, newest first
+  RemoteFree *remote_pending; //!< Entries taken off the queue but not applied yet, oldest first
+  std::atomic<uint64_t> remote_spare_list; //!< Applied entries for reuse, packed with a version tag against ABA
+
   // Top-level private methods
 
   /*!
@@ -358,9 +683,11 @@ private:
   /*!
    * \brief Use the custom object allocator to allocate an object in memory
    *
+   * \param label The label to put in the external header
+   * \param alloc_num The allocation number of this request
    * \return Pointer to the object's location in memory
    */
-  GenericObject *custom_mem_manager_allocate(const char *label);
+  GenericObject *custom_mem_manager_allocate(const char *label, unsigned alloc_num);
 
   /*!
    * \brief Use the custom memory allocator to free an object from memory
@@ -371,20 +698,182 @@ private:
 
   // Object Management
 
+  /*!
+   * \brief Signs the object and its padding with the given pattern (debug only)
+   *
+   * \param object The object to sign
+   * \param signature Pattern to sign the space with
+   */
+  void object_sign(GenericObject *object, const unsigned char signature);
+
+  /*!
+   * \brief Runs the debug checks on an object the client wants to free. Throws an exception if the object can't be
+   * freed. (Invalid object)
+   *
+   * \param object The object to check
+   * \param check_multiple_free Whether to look for the object being freed already
+   */
+  void object_validate_free(GenericObject *object, bool check_multiple_free) const;
+
   /*!
    * \brief Links object in such a way that it is the front of the free object list
    *
+   * \param head The head of the free list to insert into
    * \param object The object that will be inserted into the linked list
    * \param signature Pattern to sign the space with
    */
-  void object_push_front(GenericObject *object, const unsigned char signature);
+  void object_push_front(GenericObject *&head, GenericObject *object, const unsigned char signature);
 
   /*!
-   * \brief Returns the first object in the free_objects_list
+   * \brief Returns the first object in a free list
    *
+   * \param head The head of the free list to take from
    * \return The pointer to the object's location
    */
-  GenericObject *object_pop_front();
+  GenericObject *object_pop_front(GenericObject *&head);
+
+  /*!
+   * \brief Returns the head of the global free list, reading the lock-free stack with ConcurrentFreeList_
+   *
+   * \return The first free object
+   */
+  GenericObject *free_list_head() const;
+
+  /*!
+   * \brief Pushes a chain of linked objects onto the lock-free free list in one step
+   *
+   * \param first The first object of the chain
+   * \param last The last object of the chain, its Next gets overwritten
+   */
+  void concurrent_push(GenericObject *first, GenericObject *last);
+
+  /*!
+   * \brief Pops the first object of the lock-free free list
+   *
+   * \return The object, nullptr if the list is empty
+   */
+  GenericObject *concurrent_pop();
+
+  /*!
+   * \brief Allocates with ConcurrentFreeList_, growing a page under page_mutex when the free list runs dry
+   *
+   * \param label The label to put in the external header
+   * \param alloc_num The allocation number of this request
+   * \return Pointer to the object's location in memory
+   */
+  GenericObject *concurrent_allocate(const char *label, unsigned alloc_num);
+
+  /*!
+   * \brief Frees with ConcurrentFreeList_, debug frees are serialized on page_mutex
+   *
+   * \param object Pointer to the object to free
+   */
+  void concurrent_free(GenericObject *object);
+
+  /*!
+   * \brief Adds up the counter stripes of ConcurrentFreeList_
+   *
+   * \param allocations Receives the total allocations
+   * \param deallocations Receives the total frees
+   */
+  void concurrent_totals(uint64_t &allocations, uint64_t &deallocations) const;
+
+  /*!
+   * \brief Raises the sampled MostObjects_ of ConcurrentFreeList_ to the objects in use right now
+   *
+   * \return The objects in use
+   */
+  unsigned concurrent_peak_update() const;
+
+  /*!
+   * \brief Gets a queue entry for an object freed by a thread other than the owner, a spare one if there is any.
+   * Throws an exception if the object is nullptr or there is no memory for the entry. (Invalid object or memory
+   * allocation problem)
+   *
+   * \param object The object to free
+   * \return The entry, not linked to any other
+   */
+  RemoteFree *remote_entry(void *object);
+
+  /*!
+   * \brief Keeps a queue entry that is no longer needed for reuse (never throws)
+   *
+   * \param entry The entry, on no list
+   */
+  void remote_recycle(RemoteFree *entry);
+
+  /*!
+   * \brief Queues a chain of linked entries in one step
+   *
+   * \param first The first entry of the chain
+   * \param last The last entry of the chain, its next gets overwritten
+   */
+  void remote_push(RemoteFree *first, RemoteFree *last);
+
+  /*!
+   * \brief Applies the queued remote frees, DrainRemoteFrees without the flight recorder dump. Throws an exception if
+   * a queued object can't be freed, that object is dropped and the rest stay queued. (Invalid object)
+   *
+   * \return Amount of objects freed
+   */
+  unsigned remote_drain();
+
+  /*!
+   * \brief Records an event with the flight recorder, if there is one
+   *
+   * \param type What happened
+   * \param address The object or the page
+   * \param alloc_num The allocation number, 0 if there is none
+   */
+  void flight_record(FlightEvent::EVENT_TYPE type, const void *address, unsigned alloc_num);
+
+  /*!
+   * \brief Hands the recorded events to FlightRecorderDump_, called while an OAException is on its way to the client
+   * (never throws by itself)
+   */
+  void flight_dump() const;
+
+  /*!
+   * \brief Whether the batch calls can work on the free list directly instead of calling Allocate/Free per object
+   *
+   * \return True for a single threaded global free list of eagerly formatted pages
+   */
+  bool batch_fast_path() const;
+
+  /*!
+   * \brief Grows the pages a batch needs behind the free blocks already listed, so blocks come out as if Allocate had
+   * grown them. Throws an exception before growing if the pages would go past MaxPages_. (Memory allocation problem)
+   *
+   * \param count How many more free objects are needed
+   * \param tail The last block of the free list, nullptr if the list is empty
+   * \return The first new block
+   */
+  GenericObject *batch_reserve(unsigned count, GenericObject *tail);
+
+  /*!
+   * \brief Updates the headers of, signs and marks as in use a batch of objects at the front of the free list. Throws
+   * an exception if an external header can't be created, the objects are left untouched then. (Memory allocation
+   * problem)
+   *
+   * \param objects The objects handed to the client
+   * \param count How many objects there are
+   * \param label The label to put in the external headers
+   */
+  void batch_update_alloc(void *objects[], unsigned count, const char *label);
+
+  /*!
+   * \brief Updates the headers of a batch of objects being freed
+   *
+   * \param objects The objects returned by the client
+   * \param count How many objects there are
+   */
+  void batch_update_dealloc(void *objects[], unsigned count);
+
+  /*!
+   * \brief Recomputes every page's live object count from the free list. ConcurrentFreeList_ skips that bookkeeping
+   * on the hot path, so it is rebuilt before it is needed.
+   */
+  void page_recount_live();
 
   /*!
    * \brief Checks if the object is already free
@@ -395,13 +884,21 @@ private:
   bool object_check_is_free(GenericObject *object) const;
 
   /*!
-   * \brief Checks if the object is in the free_objects_list
+   * \brief Checks if the object is in the free list that holds its page's free blocks
    *
    * \param object The object to look for in the list
    * \return Whether the object is in the list
    */
   bool object_is_in_free_list(GenericObject *object) const;
 
+  /*!
+   * \brief Reads the in use flag of an object's header block
+   *
+   * \param object The object to check
+   * \return Whether the header marks the object as free, false without headers
+   */
+  bool object_header_is_free(GenericObject *object) const;
+
   /*!
    * \brief Checks if the pointer is a valid pointer to a block
    *
@@ -426,6 +923,33 @@ private:
    */
   bool object_validate_padding(GenericObject *object) const;
 
+  /*!
+   * \brief Returns the position of the object within its page
+   *
+   * \param info The page the object belongs to
+   * \param object The object to locate
+   * \return The index of the block in the page
+   */
+  size_t object_block_index(const PageInfo *info, GenericObject *object) const;
+
+  /*!
+   * \brief Updates the bookkeeping of the object's page: its live object count, its slab list and, if enabled, the
+   * occupancy bit
+   *
+   * \param info The page the object belongs to
+   * \param object The object that changed state
+   * \param in_use Whether the object is now owned by the client
+   */
+  void object_mark(PageInfo *info, GenericObject *object, bool in_use);
+
+  /*!
+   * \brief Returns the free list the object's page keeps its free blocks in
+   *
+   * \param info The page the free list is needed for (may be nullptr)
+   * \return The per-page free list with ppFullestPageFirst, the global free list otherwise
+   */
+  GenericObject *&object_free_list(PageInfo *info);
+
   // Header Management
 
   /*!
@@ -460,30 +984,37 @@ private:
    * \brief This function will update the allocation data of the corresponding header
    *
    * \param block_location Where the block is located (pointer to start of data)
+   * \param label The label to put in the external header
+   * \param alloc_num The allocation number to record
    */
-  void header_update_alloc(GenericObject *block_location, const char *label);
+  void header_update_alloc(GenericObject *block_location, const char *label, unsigned alloc_num);
 
   /*!
    * \brief This function will update a basic header's data
    *
    * \param block_location Where the block is located (pointer to start of data)
+   * \param alloc_num The allocation number to record
    */
-  void header_basic_update_alloc(GenericObject *block_location);
+  void header_basic_update_alloc(GenericObject *block_location, unsigned alloc_num);
 
   /*!
    * \brief This function will update the extended header due to an allocation
    *
    * \param block_location Where the block is located (pointer to start of data)
+   * \param alloc_num The allocation number to record
    */
-  void header_extended_update_alloc(GenericObject *block_location);
+  void header_extended_update_alloc(GenericObject *block_location, unsigned alloc_num);
 
   /*!
    * \brief This function will update the external header due to an allocation. This means it will allocate the header
-   * with the corresponding data.
+   * with the corresponding data. Throws an exception if there is no memory, the header is left as it was then.
+   * (Memory allocation problem)
    *
    * \param block_location Where the block is located (pointer to start of data)
+   * \param label The label to put in the external header
+   * \param alloc_num The allocation number to record
    */
-  void header_external_update_alloc(GenericObject *block_location, const char *label);
+  void header_external_update_alloc(GenericObject *block_location, const char *label, unsigned alloc_num);
 
   /*!
    * \brief This function will update the data for the corresponding header's deallocation
@@ -538,6 +1069,88 @@ private:
    */
   void page_push_front(GenericObject *page);
 
+  /*!
+   * \brief Formats the last unformatted block of the lazy page and hands it out, as if it was popped off the free list
+   *
+   * \return The block
+   */
+  GenericObject *lazy_carve();
+
+  /*!
+   * \brief Returns how many blocks at the start of a page are unformatted
+   *
+   * \param page The page to check
+   * \return The amount of blocks, 0 for every page but the lazy one
+   */
+  size_t lazy_unformatted(const GenericObject *page) const;
+
+  /*!
+   * \brief Checks if an object lies in the unformatted part of the lazy page
+   *
+   * \param object The object to check
+   * \return Whether the object was never handed out
+   */
+  bool lazy_contains(const GenericObject *object) const;
+
+  /*!
+   * \brief Decides whether a new page gets the debug checks
+   *
+   * \return True for about one page in DebugSampleRate_, always true when sampling is off
+   */
+  bool page_sample();
+
+  /*!
+   * \brief Returns whether the debug checks and signatures apply to a page
+   *
+   * \param info The bookkeeping of the page, nullptr for an address outside every page
+   * \return Whether debugging is on for the page
+   */
+  bool page_debug(const PageInfo *info) const;
+
+  /*!
+   * \brief Returns the memory of a page to where it came from (never throws)
+   *
+   * \param page The page to free
+   */
+  void free_page(GenericObject *page);
+
+  /*!
+   * \brief Returns where the pages come from
+   *
+   * \return The provider, nullptr for plain new[]
+   */
+  PageProvider *page_provider() const;
+
+  /*!
+   * \brief Calls the callback fn for each block of a page whose padding is corrupted
+   *
+   * \param page The page to check
+   * \param fn Callback to call for each block
+   * \param found When given, the blocks are added to it instead of being passed to fn
+   * \return Amount of blocks corrupted
+   */
+  unsigned page_validate(const GenericObject *page, VALIDATECALLBACK fn, std::vector<const void *> *found) const;
+
+  /*!
+   * \brief Checks one block the way ScrubPages does
+   *
+   * \param info The bookkeeping of the block's page
+   * \param index The index of the block in the page
+   * \return Whether the block is intact
+   */
+  bool block_scrub(const PageInfo *info, size_t index) const;
+
+  /*!
+   * \brief Collects the blocks of a page still in use. Only reads the allocator, so pages can be dumped in parallel.
+   *
+   * \param info The bookkeeping of the page
+   * \param free_blocks Every free block, only used without the occupancy bitmap or headers
+   * \param found Receives the blocks in use
+   */
+  void page_dump(
+      const PageInfo *info, const std::unordered_set<const GenericObject *> &free_blocks,
+      std::vector<const void *> &found) const;
+
   /*!
    * \brief Returns the first page in the list. It will not check if a page has objects in use or not.
    *
@@ -545,6 +1158,58 @@ private:
    */
   GenericObject *page_pop_front();
 
+  /*!
+   * \brief Adds a page to the address sorted page index. Throws an exception if the index can't grow.
+   *
+   * \param page The page to add
+   * \return The bookkeeping created for the page
+   */
+  PageInfo *page_index_insert(GenericObject *page);
+
+  /*!
+   * \brief Removes a page from the address sorted page index
+   *
+   * \param page The page to remove
+   */
+  void page_index_erase(GenericObject *page);
+
+  /*!
+   * \brief Binary searches the page index for the bookkeeping of a page
+   *
+   * \param page The page to look for
+   * \return The bookkeeping of the page, nullptr if the page is not in the index
+   */
+  PageInfo *page_index_get(GenericObject *page) const;
+
+  /*!
+   * \brief Finds the page that contains the address, by masking with AlignedPages_ and with a binary search otherwise
+   *
+   * \param address The address to look for
+   * \return The bookkeeping of the page containing the address, nullptr if there is none
+   */
+  PageInfo *page_index_find(uint8_t *address) const;
+
+  /*!
+   * \brief Adds the page to the slab list matching its live object count
+   *
+   * \param info The page to link
+   */
+  void slab_link(PageInfo *info);
+
+  /*!
+   * \brief Removes the page from the slab list matching its live object count
+   *
+   * \param info The page to unlink
+   */
+  void slab_unlink(PageInfo *info);
+
+  /*!
+   * \brief Picks the page the next allocation is served from: the fullest partial page, or else an empty one
+   *
+   * \return The chosen page, nullptr when every page is full
+   */
+  PageInfo *slab_select_page() const;
+
   // Calculations
 
   /*!
@@ -602,25 +1267,6 @@ private:
    * \param size The length of the signature
    */
   void write_signature(uint8_t *location, const unsigned char pattern, size_t size);
-
-  /*!
-   * \brief This will check whether the address is within the range of start and start + length
-   *
-   * \param start The start of the range
-   * \param length The length of the range
-   * \param address The location to check bounds
-   *
-   * \return Whether the address is inside of the provided range
-   */
-  bool is_in_range(uint8_t *start, size_t length, uint8_t *address) const;
-
-  /*!
-   * \brief This function will remove a node from the given linked list
-   *
-   * \param head The head of the list in which the node is in.
-   * \param to_remove The node in the list to remove
-   */
-  void generic_object_remove(GenericObject *&head, GenericObject *to_remove);
 };
 
 #endif
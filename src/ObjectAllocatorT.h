@@ -0,0 +1,606 @@
+/**
+ * @file ObjectAllocatorT.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Object allocator whose configuration and page layout are fixed at compile time
+ */
+
+//---------------------------------------------------------------------------
+#ifndef OBJECTALLOCATORTH
+#define OBJECTALLOCATORTH
+//---------------------------------------------------------------------------
+
+#include "OALayout.h"
+#include "ObjectAllocator.h"
+#include "PageProvider.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+/*!
+  Compile-time counterpart of OAConfig, for ObjectAllocatorT. The fields mean the same as their OAConfig namesakes.
+*/
+template <
+    unsigned ObjectsPerPage = DEFAULT_OBJECTS_PER_PAGE,
+    unsigned MaxPages = DEFAULT_MAX_PAGES,
+    bool DebugOn = false,
+    unsigned PadBytes = 0,
+    OAConfig::HBLOCK_TYPE HeaderType = OAConfig::hbNone,
+    unsigned HeaderAdditional = 0,
+    unsigned Alignment = 0>
+struct OAStaticConfig {
+  static constexpr unsigned ObjectsPerPage_ = ObjectsPerPage; //!< number of objects on each page
+  static constexpr unsigned MaxPages_ = MaxPages; //!< maximum number of pages (0=unlimited)
+  static constexpr bool DebugOn_ = DebugOn; //!< enable/disable debugging code (signatures, checks, etc.)
+  static constexpr unsigned PadBytes_ = PadBytes; //!< size of the left/right padding for each block
+  static constexpr OAConfig::HBLOCK_TYPE HeaderType_ = HeaderType; //!< kind of header blocks (no hbExternal)
+  static constexpr unsigned HeaderAdditional_ = HeaderAdditional; //!< user-defined bytes of an extended header
+  static constexpr unsigned Alignment_ = Alignment; //!< address alignment of each block
+};
+
+/*!
+  Same pages, headers, signatures and checks as an ObjectAllocator with the equivalent OAConfig, but every size,
+  offset and option is a constant. With DebugOn_ off and no headers Allocate and Free are a bare free list pop and push.
+  External headers allocate on every call and are left to ObjectAllocator.
+
+  The page lookups, block checks, signatures and header updates are the OALayout ones ObjectAllocator runs, over a
+  page index sorted by address. With DebugOn_ and no headers the index also keeps the occupancy bitmap the double free
+  check reads. The loops over pages and blocks (formatting, FreeEmptyPages, the sweeps) are its own: ObjectAllocator's
+  are interleaved with lazy formatting, debug sampling, the slab lists and the concurrent modes, none of which exist
+  here, and sharing them would put those runtime branches back on this allocator's path.
+*/
+template <size_t ObjectSize, typename Config = OAStaticConfig<>>
+class ObjectAllocatorT {
+  static_assert(Config::HeaderType_ != OAConfig::hbExternal, "External headers are only supported by ObjectAllocator");
+  static_assert(ObjectSize >= sizeof(GenericObject), "A free object has to be able to hold the free list link");
+  static_assert(Config::ObjectsPerPage_ > 0, "A page needs at least one object");
+
+public:
+  typedef ObjectAllocator::DUMPCALLBACK DUMPCALLBACK; //!< Callback function when dumping memory leaks
+  typedef ObjectAllocator::VALIDATECALLBACK VALIDATECALLBACK; //!< Callback function when validating blocks
+
+  static constexpr size_t HEADER_SIZE = OALayout::header_size(Config::HeaderType_, Config::HeaderAdditional_);
+  static constexpr size_t LEFT_ALIGN_SIZE =
+      OALayout::left_alignment(Config::PadBytes_, HEADER_SIZE, Config::Alignment_);
+  static constexpr size_t INTER_ALIGN_SIZE =
+      OALayout::inter_alignment(ObjectSize, Config::PadBytes_, HEADER_SIZE, Config::Alignment_);
+  static constexpr size_t BLOCK_SIZE =
+      OALayout::block_size(ObjectSize, Config::PadBytes_, HEADER_SIZE, INTER_ALIGN_SIZE);
+  static constexpr size_t FIRST_OBJECT_OFFSET =
+      OALayout::first_object_offset(Config::PadBytes_, HEADER_SIZE, LEFT_ALIGN_SIZE);
+  static constexpr size_t PAGE_SIZE = OALayout::page_size(
+      ObjectSize, Config::ObjectsPerPage_, Config::PadBytes_, HEADER_SIZE, LEFT_ALIGN_SIZE, INTER_ALIGN_SIZE);
+  static constexpr bool TRACKS_OCCUPANCY = Config::DebugOn_ && Config::HeaderType_ == OAConfig::hbNone;
+
+  /*!
+   * \brief Creates the allocator with its first page. Throws an exception if the construction fails. (Memory
+   * allocation problem)
+   *
+   * \param provider Where the pages come from, same as OAConfig::PageProvider_ (nullptr means the global heap)
+   */
+  explicit ObjectAllocatorT(PageProvider *provider = nullptr) :
+      page_list(nullptr), free_objects_list(nullptr), pages(), stats(), provider(provider) {
+    stats.ObjectSize_ = ObjectSize;
+    stats.PageSize_ = PAGE_SIZE;
+
+    page_push_front();
+  }
+
+  /*!
+   * \brief Destroys the allocator and every page (never throws)
+   */
+  ~ObjectAllocatorT() {
+    while (page_list != nullptr) {
+      GenericObject *page = page_list;
+      page_list = page->Next;
+      page_release(page);
+    }
+  }
+
+  /*!
+   * \brief Take an object from the free list and give it to the client (simulates new). Throws an exception if the
+   * object can't be allocated. (Memory allocation problem)
+   *
+   * \return Pointer to the allocated block
+   */
+  void *Allocate() {
+    if (free_objects_list == nullptr) {
+      page_push_front();
+    }
+
+    GenericObject *output = free_objects_list;
+    free_objects_list = output->Next;
+
+    if (Config::DebugOn_) {
+      memset(output, ObjectAllocator::ALLOCATED_PATTERN, ObjectSize);
+    }
+
+    if (TRACKS_OCCUPANCY) {
+      object_mark(output, true);
+    }
+
+    if (Config::HeaderType_ != OAConfig::hbNone) {
+      header_update_alloc(output, static_cast<unsigned>(stats.Allocations_ + 1));
+    }
+
+    stats.FreeObjects_--;
+    stats.Allocations_++;
+    stats.ObjectsInUse_++;
+    stats.MostObjects_ = std::max(stats.MostObjects_, stats.ObjectsInUse_);
+
+    return output;
+  }
+
+  /*!
+   * \brief Returns an object to the free list for the client (simulates delete). Throws an exception if the the
+   * object can't be freed. (Invalid object)
+   *
+   * \param Object Pointer to the block to deallocate
+   */
+  void Free(void *Object) {
+    GenericObject *object = static_cast<GenericObject *>(Object);
+
+    if (Config::DebugOn_) {
+      object_validate_free(object);
+    }
+
+    if (TRACKS_OCCUPANCY) {
+      object_mark(object, false);
+    }
+
+    if (Config::HeaderType_ != OAConfig::hbNone) {
+      header_update_dealloc(object);
+    }
+
+    object_push_front(object, ObjectAllocator::FREED_PATTERN);
+
+    stats.Deallocations_++;
+    stats.ObjectsInUse_--;
+  }
+
+  /*!
+   * \brief Calls the callback fn for each block still in use. Throws an exception if the free blocks can't be
+   * collected. (Memory allocation problem)
+   *
+   * \param fn Callback to call for each block
+   *
+   * \return Amount of blocks still in use
+   */
+  unsigned DumpMemoryInUse(DUMPCALLBACK fn) const {
+    // Without headers or the bitmap a block is only known to be free by being in the free list, which is hashed once
+    // instead of walked for every block
+    std::unordered_set<const GenericObject *> free_blocks;
+    if (Config::HeaderType_ == OAConfig::hbNone && !TRACKS_OCCUPANCY) {
+      try {
+        for (const GenericObject *object = free_objects_list; object != nullptr; object = object->Next) {
+          free_blocks.insert(object);
+        }
+
+      } catch (const std::bad_alloc &) {
+        throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while sweeping the pages.");
+      }
+    }
+
+    unsigned in_use_count = 0;
+
+    for (GenericObject *page = page_list; page != nullptr; page = page->Next) {
+      const PageEntry &entry = pages[page_position(page_object(page, 0))];
+
+      for (size_t i = 0; i < Config::ObjectsPerPage_; i++) {
+        GenericObject *object = page_object(page, i);
+        bool is_free = false;
+
+        if (Config::HeaderType_ != OAConfig::hbNone) {
+          is_free = OALayout::header_is_free(header_of(object), HEADER_SIZE);
+        } else if (TRACKS_OCCUPANCY) {
+          is_free = !OALayout::bit_test(entry.occupancy, i);
+        } else {
+          is_free = free_blocks.count(object) != 0;
+        }
+
+        if (!is_free) {
+          fn(object, ObjectSize);
+          in_use_count++;
+        }
+      }
+    }
+
+    return in_use_count;
+  }
+
+  /*!
+   * \brief Calls the callback fn for each block that is potentially corrupted
+   *
+   * \param fn Callback to call for each block
+   *
+   * \return Amount of blocks corrupted
+   */
+  unsigned ValidatePages(VALIDATECALLBACK fn) const {
+    if (!Config::DebugOn_ || Config::PadBytes_ == 0) {
+      return 0;
+    }
+
+    unsigned corrupted_count = 0;
+
+    for (GenericObject *page = page_list; page != nullptr; page = page->Next) {
+      for (size_t i = 0; i < Config::ObjectsPerPage_; i++) {
+        GenericObject *object = page_object(page, i);
+
+        if (!object_validate_padding(object)) {
+          fn(object, ObjectSize);
+          corrupted_count++;
+        }
+      }
+    }
+
+    return corrupted_count;
+  }
+
+  /*!
+   * \brief Frees all empty pages. Throws an exception if the bookkeeping can't be allocated. (Memory allocation
+   * problem)
+   *
+   * \return Amount of pages freed
+   */
+  unsigned FreeEmptyPages() {
+    // How many blocks of each page are free, in the order of the page index
+    std::vector<unsigned> free_counts;
+
+    try {
+      free_counts.assign(pages.size(), 0);
+
+    } catch (const std::bad_alloc &) {
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while counting the free blocks.");
+    }
+
+    for (GenericObject *object = free_objects_list; object != nullptr; object = object->Next) {
+      free_counts[page_position(object)]++;
+    }
+
+    unsigned empty_pages = 0;
+    for (unsigned count : free_counts) {
+      if (count == Config::ObjectsPerPage_) {
+        empty_pages++;
+      }
+    }
+
+    if (empty_pages == 0) {
+      return 0;
+    }
+
+    GenericObject **link = &free_objects_list;
+    while (*link != nullptr) {
+      if (free_counts[page_position(*link)] == Config::ObjectsPerPage_) {
+        *link = (*link)->Next;
+        stats.FreeObjects_--;
+      } else {
+        link = &(*link)->Next;
+      }
+    }
+
+    link = &page_list;
+    while (*link != nullptr) {
+      GenericObject *page = *link;
+
+      if (free_counts[page_position(page_object(page, 0))] == Config::ObjectsPerPage_) {
+        *link = page->Next;
+        page_release(page);
+        stats.PagesInUse_--;
+      } else {
+        link = &page->Next;
+      }
+    }
+
+    // The lookups above only compare addresses, so the index is compacted once every page is gone
+    size_t kept = 0;
+    for (size_t i = 0; i < pages.size(); i++) {
+      if (free_counts[i] != Config::ObjectsPerPage_) {
+        pages[kept++] = std::move(pages[i]);
+      }
+    }
+    pages.erase(pages.begin() + static_cast<ptrdiff_t>(kept), pages.end());
+
+    return empty_pages;
+  }
+
+  /*!
+   * \brief Getter for the list of free objects in the allocator
+   *
+   * \return Pointer to the head of the list
+   */
+  const void *GetFreeList() const { return free_objects_list; }
+
+  /*!
+   * \brief Getter for the list of pages being used by the allocator
+   *
+   * \return Pointer to the head of the list
+   */
+  const void *GetPageList() const { return page_list; }
+
+  /*!
+   * \brief Getter for the runtime configuration equivalent to Config
+   *
+   * \return The configuration of the allocator
+   */
+  OAConfig GetConfig() const {
+    OAConfig output(
+        false, Config::ObjectsPerPage_, Config::MaxPages_, Config::DebugOn_, Config::PadBytes_,
+        OAConfig::HeaderBlockInfo(Config::HeaderType_, Config::HeaderAdditional_), Config::Alignment_);
+
+    output.LeftAlignSize_ = static_cast<unsigned>(LEFT_ALIGN_SIZE);
+    output.InterAlignSize_ = static_cast<unsigned>(INTER_ALIGN_SIZE);
+    output.PageProvider_ = provider;
+    return output;
+  }
+
+  /*!
+   * \brief Getter for the statistics of the allocator
+   *
+   * \return The statistics of the allocator
+   */
+  OAStats GetStats() const { return stats; }
+
+  // Prevent copy construction and assignment
+  ObjectAllocatorT(const ObjectAllocatorT &other) = delete; //!< Do not implement!
+  ObjectAllocatorT &operator=(const ObjectAllocatorT &other) = delete; //!< Do not implement!
+
+private:
+  /*!
+    Bookkeeping of one page
+  */
+  struct PageEntry {
+    GenericObject *page; //!< The page
+    std::vector<uint64_t> occupancy; //!< TRACKS_OCCUPANCY only, one bit per block, set while the client owns it
+  };
+
+  GenericObject *page_list;
+  GenericObject *free_objects_list;
+  std::vector<PageEntry> pages; //!< Every page, sorted by address
+  OAStats stats;
+  PageProvider *provider; //!< Where the pages come from, nullptr means the global heap
+
+  /*!
+   * \brief Allocates a page, formats its blocks and puts them on the free list. Throws an exception if the page can't
+   * be allocated. (Memory allocation problem)
+   */
+  void page_push_front() {
+    if (Config::MaxPages_ != 0 && stats.PagesInUse_ + 1 > Config::MaxPages_) {
+      throw OAException(OAException::E_NO_PAGES, "The maximum amount of pages has been allocated");
+    }
+
+    uint8_t *raw_page = nullptr;
+    if (provider != nullptr) {
+      raw_page = static_cast<uint8_t *>(provider->AllocatePage(PAGE_SIZE, alignof(std::max_align_t)));
+
+      if (raw_page == nullptr) {
+        throw OAException(OAException::E_NO_MEMORY, "The page provider is out of memory.");
+      }
+    }
+
+    GenericObject *page = nullptr;
+    try {
+      raw_page = raw_page != nullptr ? raw_page : new uint8_t[PAGE_SIZE];
+      page = reinterpret_cast<GenericObject *>(raw_page);
+
+      auto position = std::upper_bound(
+          pages.begin(), pages.end(), page, [](GenericObject *value, const PageEntry &entry) {
+            return std::less<GenericObject *>()(value, entry.page);
+          });
+
+      size_t occupancy_words = TRACKS_OCCUPANCY ? (Config::ObjectsPerPage_ + 63) / 64 : 0;
+      pages.insert(position, PageEntry{page, std::vector<uint64_t>(occupancy_words, 0)});
+
+    } catch (const std::bad_alloc &) {
+      page_release(page);
+      throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
+    }
+
+    if (Config::DebugOn_) {
+      memset(raw_page + sizeof(void *), ObjectAllocator::ALIGN_PATTERN, LEFT_ALIGN_SIZE);
+    }
+
+    for (size_t i = 0; i < Config::ObjectsPerPage_; i++) {
+      GenericObject *object = page_object(page, i);
+      uint8_t *raw_object = reinterpret_cast<uint8_t *>(object);
+
+      if (Config::HeaderType_ != OAConfig::hbNone) {
+        OALayout::header_clear(header_of(object), HEADER_SIZE);
+      }
+
+      object_push_front(object, ObjectAllocator::UNALLOCATED_PATTERN);
+
+      if (Config::DebugOn_ && i + 1 < Config::ObjectsPerPage_) {
+        memset(raw_object + ObjectSize + Config::PadBytes_, ObjectAllocator::ALIGN_PATTERN, INTER_ALIGN_SIZE);
+      }
+    }
+
+    page->Next = page_list;
+    page_list = page;
+
+    stats.PagesInUse_++;
+  }
+
+  /*!
+   * \brief Returns a page's memory to where it came from (never throws)
+   *
+   * \param page The page, nullptr is ignored
+   */
+  void page_release(GenericObject *page) {
+    if (page == nullptr) {
+      return;
+    }
+
+    if (provider != nullptr) {
+      provider->FreePage(page, PAGE_SIZE, alignof(std::max_align_t));
+    } else {
+      delete[] reinterpret_cast<uint8_t *>(page);
+    }
+  }
+
+  /*!
+   * \brief Returns an object of a page
+   *
+   * \param page The page the object is in
+   * \param index The position of the object in the page
+   * \return The object
+   */
+  static GenericObject *page_object(GenericObject *page, size_t index) {
+    uint8_t *raw_page = reinterpret_cast<uint8_t *>(page);
+    return reinterpret_cast<GenericObject *>(raw_page + FIRST_OBJECT_OFFSET + index * BLOCK_SIZE);
+  }
+
+  /*!
+   * \brief Finds the page that contains an address
+   *
+   * \param address The address to look for
+   * \return The position of the page in the page index, the size of the index if no page contains the address
+   */
+  size_t page_position(const void *address) const {
+    auto position = OALayout::page_find(
+        pages.begin(), pages.end(), address, PAGE_SIZE, [](const PageEntry &entry) { return entry.page; });
+
+    return static_cast<size_t>(position - pages.begin());
+  }
+
+  /*!
+   * \brief Updates the occupancy bit of an object, TRACKS_OCCUPANCY only
+   *
+   * \param object The object that changed state, a block of the allocator
+   * \param in_use Whether the object is now owned by the client
+   */
+  void object_mark(GenericObject *object, bool in_use) {
+    PageEntry &entry = pages[page_position(object)];
+    size_t index = OALayout::block_index(entry.page, FIRST_OBJECT_OFFSET, BLOCK_SIZE, object);
+
+    OALayout::bit_assign(entry.occupancy, index, in_use);
+  }
+
+  /*!
+   * \brief Links object in such a way that it is the front of the free object list
+   *
+   * \param object The object that will be inserted into the linked list
+   * \param signature Pattern to sign the object with
+   */
+  void object_push_front(GenericObject *object, const unsigned char signature) {
+    if (Config::DebugOn_) {
+      OALayout::block_sign(object, ObjectSize, Config::PadBytes_, signature);
+    }
+
+    object->Next = free_objects_list;
+    free_objects_list = object;
+
+    stats.FreeObjects_++;
+  }
+
+  /*!
+   * \brief Runs the debug checks on an object the client wants to free. Throws an exception if the object can't be
+   * freed. (Invalid object)
+   *
+   * \param object The object to check
+   */
+  void object_validate_free(GenericObject *object) const {
+    if (!object_validate_location(object)) {
+      throw OAException(
+          OAException::E_BAD_BOUNDARY, "The memory address lies outside of the allocated blocks' boundaries");
+    }
+
+    if (object_is_free(object)) {
+      throw OAException(OAException::E_MULTIPLE_FREE, "The object is being deallocated multiple times");
+    }
+
+    if (!object_validate_padding(object)) {
+      throw OAException(
+          OAException::E_CORRUPTED_BLOCK,
+          "The object's padding bytes have been corrupted, check pointer math in your code");
+    }
+  }
+
+  /*!
+   * \brief Checks if the pointer is on a block boundary of one of the pages
+   *
+   * \param object The location to validate
+   * \return Whether the object is a block of the allocator
+   */
+  bool object_validate_location(GenericObject *object) const {
+    size_t position = page_position(object);
+    return position < pages.size() && OALayout::is_block(pages[position].page, FIRST_OBJECT_OFFSET, BLOCK_SIZE, object);
+  }
+
+  /*!
+   * \brief Checks if the object is already free, using its header or else the occupancy bitmap. DebugOn_ only.
+   *
+   * \param object The object to check, a block of the allocator
+   * \return Whether the object is free
+   */
+  bool object_is_free(GenericObject *object) const {
+    if (Config::HeaderType_ != OAConfig::hbNone) {
+      return OALayout::header_is_free(header_of(object), HEADER_SIZE);
+    }
+
+    const PageEntry &entry = pages[page_position(object)];
+    size_t index = OALayout::block_index(entry.page, FIRST_OBJECT_OFFSET, BLOCK_SIZE, object);
+
+    return !OALayout::bit_test(entry.occupancy, index);
+  }
+
+  /*!
+   * \brief Checks if the object padding is intact
+   *
+   * \param object The object to check
+   * \return Whether the padding is valid
+   */
+  bool object_validate_padding(GenericObject *object) const {
+    return Config::PadBytes_ == 0 || OALayout::pads_intact(object, ObjectSize, Config::PadBytes_);
+  }
+
+  /*!
+   * \brief Returns the first byte of the object's header
+   *
+   * \param object The object the header belongs to
+   * \return The header
+   */
+  static uint8_t *header_of(GenericObject *object) {
+    return reinterpret_cast<uint8_t *>(object) - Config::PadBytes_ - HEADER_SIZE;
+  }
+
+  /*!
+   * \brief Updates a basic or extended header due to an allocation
+   *
+   * \param object The object the header belongs to
+   * \param alloc_num The allocation number to record
+   */
+  static void header_update_alloc(GenericObject *object, unsigned alloc_num) {
+    OALayout::header_mark_allocated(
+        header_of(object), HEADER_SIZE, Config::HeaderType_ == OAConfig::hbExtended, alloc_num);
+  }
+
+  /*!
+   * \brief Updates a basic or extended header due to a deallocation
+   *
+   * \param object The object the header belongs to
+   */
+  static void header_update_dealloc(GenericObject *object) {
+    OALayout::header_mark_free(header_of(object), HEADER_SIZE);
+  }
+};
+
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::HEADER_SIZE;
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::LEFT_ALIGN_SIZE;
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::INTER_ALIGN_SIZE;
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::BLOCK_SIZE;
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::FIRST_OBJECT_OFFSET;
+template <size_t ObjectSize, typename Config>
+constexpr size_t ObjectAllocatorT<ObjectSize, Config>::PAGE_SIZE;
+template <size_t ObjectSize, typename Config>
+constexpr bool ObjectAllocatorT<ObjectSize, Config>::TRACKS_OCCUPANCY;
+
+#endif
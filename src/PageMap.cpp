@@ -0,0 +1,234 @@
+/**
+ * \file PageMap.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the lock-free page to owner map
+ */
+
+#include "PageMap.h"
+#include "ObjectAllocator.h"
+#include <new>
+
+namespace {
+  const unsigned COVERED_BITS = 13; //!< Bits of an entry holding the covered bytes, enough for GRANULE itself
+} // namespace
+
+/*!
+ * \brief Creates an empty map. Throws an exception if there is no memory. (Memory allocation problem)
+ */
+PageMap::PageMap() : root() {
+  try {
+    // Value-initialized, so every middle node starts as nullptr
+    root.reset(new std::atomic<Middle *>[size_t(1) << ROOT_BITS]());
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the page map.");
+  }
+}
+
+/*!
+ * \brief Frees every tree node (never throws)
+ */
+PageMap::~PageMap() {
+  for (size_t i = 0; i < (size_t(1) << ROOT_BITS); i++) {
+    Middle *middle = root[i].load(std::memory_order_relaxed);
+
+    if (middle == nullptr) {
+      continue;
+    }
+
+    for (size_t j = 0; j < (size_t(1) << MIDDLE_BITS); j++) {
+      delete middle->leaves[j].load(std::memory_order_relaxed);
+    }
+
+    delete middle;
+  }
+}
+
+/*!
+ * \brief Records a page. Throws an exception if a tree node can't be allocated or the page is beyond the addresses
+ * or owners the map covers, the page is not recorded then. (Memory allocation problem)
+ *
+ * \param page The first byte of the page, a multiple of GRANULE
+ * \param size The size of the page
+ * \param owner The index of the allocator that owns the page, below MAX_OWNERS
+ */
+void PageMap::Insert(const void *page, size_t size, unsigned owner) {
+  uintptr_t first = reinterpret_cast<uintptr_t>(page) >> GRANULE_BITS;
+  uintptr_t last = (reinterpret_cast<uintptr_t>(page) + size - 1) >> GRANULE_BITS;
+
+  if (last >> KEY_BITS != 0 || owner >= MAX_OWNERS) {
+    throw OAException(OAException::E_NO_MEMORY, "The page is beyond the addresses or owners the page map covers.");
+  }
+
+  // Every node is in place before the first piece is claimed, so a failure leaves nothing half recorded
+  for (uintptr_t key = first; key <= last; key++) {
+    leaf_create(key);
+  }
+
+  uintptr_t end = reinterpret_cast<uintptr_t>(page) + size;
+
+  for (uintptr_t key = first; key <= last; key++) {
+    // Only the last piece may be partly covered
+    uintptr_t covered = key < last ? GRANULE : end - (key << GRANULE_BITS);
+    uint32_t entry = static_cast<uint32_t>(((owner + 1) << COVERED_BITS) | covered);
+
+    leaf_find(key)->owners[key & ((uintptr_t(1) << LEAF_BITS) - 1)].store(entry, std::memory_order_relaxed);
+  }
+}
+
+/*!
+ * \brief Forgets a page recorded by Insert (never throws)
+ *
+ * \param page The first byte of the page
+ * \param size The size of the page
+ */
+void PageMap::Remove(const void *page, size_t size) {
+  uintptr_t first = reinterpret_cast<uintptr_t>(page) >> GRANULE_BITS;
+  uintptr_t last = (reinterpret_cast<uintptr_t>(page) + size - 1) >> GRANULE_BITS;
+
+  for (uintptr_t key = first; key <= last; key++) {
+    leaf_find(key)->owners[key & ((uintptr_t(1) << LEAF_BITS) - 1)].store(0, std::memory_order_relaxed);
+  }
+}
+
+/*!
+ * \brief Finds the owner of the page that contains the address
+ *
+ * \param address The address to look for
+ * \return The owner's index, NO_OWNER when no page contains the address
+ */
+unsigned PageMap::Find(const void *address) const {
+  uintptr_t key = reinterpret_cast<uintptr_t>(address) >> GRANULE_BITS;
+
+  if (key >> KEY_BITS != 0) {
+    return NO_OWNER;
+  }
+
+  const Leaf *leaf = leaf_find(key);
+  if (leaf == nullptr) {
+    return NO_OWNER;
+  }
+
+  // A live block was handed out after its page was recorded, so the caller already sees the entry
+  uint32_t entry = leaf->owners[key & ((uintptr_t(1) << LEAF_BITS) - 1)].load(std::memory_order_relaxed);
+  uintptr_t offset = reinterpret_cast<uintptr_t>(address) & (GRANULE - 1);
+
+  if (offset >= (entry & ((1u << COVERED_BITS) - 1))) {
+    return NO_OWNER;
+  }
+
+  return (entry >> COVERED_BITS) - 1;
+}
+
+/*!
+ * \brief Finds the leaf of a piece
+ *
+ * \param key The piece number
+ * \return The leaf, nullptr if no page was ever recorded in it
+ */
+PageMap::Leaf *PageMap::leaf_find(uintptr_t key) const {
+  const Middle *middle = root[key >> (LEAF_BITS + MIDDLE_BITS)].load(std::memory_order_acquire);
+
+  if (middle == nullptr) {
+    return nullptr;
+  }
+
+  return middle->leaves[(key >> LEAF_BITS) & ((uintptr_t(1) << MIDDLE_BITS) - 1)].load(std::memory_order_acquire);
+}
+
+/*!
+ * \brief Finds the leaf of a piece, creating the nodes on the way. Throws an exception if a node can't be allocated.
+ * (Memory allocation problem)
+ *
+ * \param key The piece number
+ * \return The leaf
+ */
+PageMap::Leaf *PageMap::leaf_create(uintptr_t key) {
+  std::atomic<Middle *> &middle_slot = root[key >> (LEAF_BITS + MIDDLE_BITS)];
+  Middle *middle = middle_slot.load(std::memory_order_acquire);
+
+  try {
+    // Owners of neighbouring pages may race to create the same node, the loser frees its own
+    if (middle == nullptr) {
+      Middle *created = new Middle();
+
+      if (middle_slot.compare_exchange_strong(middle, created, std::memory_order_acq_rel)) {
+        middle = created;
+      } else {
+        delete created;
+      }
+    }
+
+    std::atomic<Leaf *> &leaf_slot = middle->leaves[(key >> LEAF_BITS) & ((uintptr_t(1) << MIDDLE_BITS) - 1)];
+    Leaf *leaf = leaf_slot.load(std::memory_order_acquire);
+
+    if (leaf == nullptr) {
+      Leaf *created = new Leaf();
+
+      if (leaf_slot.compare_exchange_strong(leaf, created, std::memory_order_acq_rel)) {
+        leaf = created;
+      } else {
+        delete created;
+      }
+    }
+
+    return leaf;
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while growing the page map.");
+  }
+}
+
+/*!
+ * \brief Creates the provider of an owner
+ *
+ * \param map The map to record the pages in, it has to outlive the provider
+ * \param owner The index of the owner
+ * \param provider Where the pages come from, nullptr means the global heap
+ */
+PageMapProvider::PageMapProvider(PageMap &map, unsigned owner, PageProvider *provider) :
+    map(map), owner(owner), heap(), provider(provider != nullptr ? provider : &heap) {}
+
+/*!
+ * \brief Gets the memory for one page, aligned to at least PageMap::GRANULE, and records it
+ *
+ * \param size The size of the page in bytes
+ * \param alignment The alignment of the page, a power of two
+ * \return Pointer to the page, nullptr if there is no memory or the map can't record it
+ */
+void *PageMapProvider::AllocatePage(size_t size, size_t alignment) {
+  size_t granule = PageMap::GRANULE;
+  alignment = alignment > granule ? alignment : granule;
+
+  void *page = provider->AllocatePage(size, alignment);
+  if (page == nullptr) {
+    return nullptr;
+  }
+
+  try {
+    map.Insert(page, size, owner);
+
+  } catch (const OAException &) {
+    provider->FreePage(page, size, alignment);
+    return nullptr;
+  }
+
+  return page;
+}
+
+/*!
+ * \brief Forgets a page and returns its memory (never throws)
+ *
+ * \param page Pointer returned by AllocatePage
+ * \param size The size the page was allocated with
+ * \param alignment The alignment the page was allocated with
+ */
+void PageMapProvider::FreePage(void *page, size_t size, size_t alignment) {
+  size_t granule = PageMap::GRANULE;
+
+  map.Remove(page, size);
+  provider->FreePage(page, size, alignment > granule ? alignment : granule);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file PageMap.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Lock-free map from page addresses back to the allocator that owns them
+ */
+
+//---------------------------------------------------------------------------
+#ifndef PAGEMAPH
+#define PAGEMAPH
+//---------------------------------------------------------------------------
+
+#include "PageProvider.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*!
+  Front ends that own several ObjectAllocators use this to find which of them handed out a block, using nothing but
+  the block's address. The address space is cut into GRANULE sized pieces and a three level radix tree maps each piece
+  to the owner of the page covering it, along with how much of the piece the page covers, so Find is three loads and
+  never locks. Pages have to be aligned to GRANULE, PageMapProvider takes care of that and of keeping the map up to
+  date. The rest of a page's last piece may hold anything else, addresses there have no owner.
+
+  Insert and Remove may run on several threads at once, and at the same time as Find, as long as they touch different
+  pages. Tree nodes are only freed with the map.
+*/
+class PageMap {
+public:
+  static const unsigned NO_OWNER = ~0u; //!< Returned by Find when no page contains the address
+  static const size_t GRANULE = 4096; //!< Pages start at a multiple of this
+  static const unsigned MAX_OWNERS = 1u << 18; //!< Owner indices have to be below this
+
+  /*!
+   * \brief Creates an empty map. Throws an exception if there is no memory. (Memory allocation problem)
+   */
+  PageMap();
+
+  /*!
+   * \brief Frees every tree node (never throws)
+   */
+  ~PageMap();
+
+  /*!
+   * \brief Records a page. Throws an exception if a tree node can't be allocated or the page is beyond the addresses
+   * or owners the map covers, the page is not recorded then. (Memory allocation problem)
+   *
+   * \param page The first byte of the page, a multiple of GRANULE
+   * \param size The size of the page
+   * \param owner The index of the allocator that owns the page, below MAX_OWNERS
+   */
+  void Insert(const void *page, size_t size, unsigned owner);
+
+  /*!
+   * \brief Forgets a page recorded by Insert (never throws)
+   *
+   * \param page The first byte of the page
+   * \param size The size of the page
+   */
+  void Remove(const void *page, size_t size);
+
+  /*!
+   * \brief Finds the owner of the page that contains the address
+   *
+   * \param address The address to look for
+   * \return The owner's index, NO_OWNER when no page contains the address
+   */
+  unsigned Find(const void *address) const;
+
+  // Prevent copy construction and assignment
+  PageMap(const PageMap &other) = delete; //!< Do not implement!
+  PageMap &operator=(const PageMap &other) = delete; //!< Do not implement!
+
+private:
+  static const unsigned GRANULE_BITS = 12; //!< log2(GRANULE)
+  static const unsigned KEY_BITS = (sizeof(uintptr_t) > 4 ? 48 : 32) - GRANULE_BITS; //!< Bits of a piece number
+  static const unsigned LEAF_BITS = KEY_BITS / 3; //!< Bits of a piece number a leaf resolves
+  static const unsigned MIDDLE_BITS = KEY_BITS / 3; //!< Bits of a piece number a middle node resolves
+  static const unsigned ROOT_BITS = KEY_BITS - LEAF_BITS - MIDDLE_BITS; //!< Bits of a piece number the root resolves
+
+  /*!
+    The owners of a run of pieces. Each entry is the owner plus one, shifted past the count of bytes of the piece the
+    page covers (up to GRANULE), so a zeroed entry has no owner.
+  */
+  struct Leaf {
+    std::atomic<uint32_t> owners[size_t(1) << LEAF_BITS]; //!< One entry per piece
+  };
+
+  /*!
+    The leaves of a run of pieces
+  */
+  struct Middle {
+    std::atomic<Leaf *> leaves[size_t(1) << MIDDLE_BITS]; //!< nullptr until a page is recorded in the leaf
+  };
+
+  std::unique_ptr<std::atomic<Middle *>[]> root; //!< nullptr until a page is recorded in the middle node
+
+  /*!
+   * \brief Finds the leaf of a piece
+   *
+   * \param key The piece number
+   * \return The leaf, nullptr if no page was ever recorded in it
+   */
+  Leaf *leaf_find(uintptr_t key) const;
+
+  /*!
+   * \brief Finds the leaf of a piece, creating the nodes on the way. Throws an exception if a node can't be allocated.
+   * (Memory allocation problem)
+   *
+   * \param key The piece number
+   * \return The leaf
+   */
+  Leaf *leaf_create(uintptr_t key);
+};
+
+/*!
+  Page provider that records every page it hands out in a PageMap, before the allocator sees it, and forgets it when
+  it comes back. Give each owner one of these as its OAConfig::PageProvider_ and the map follows the owner's pages
+  without the owner having to report them, and without a moment where a page of the owner is missing from the map.
+  If the map can't record a page, the page is returned and the owner gets E_NO_MEMORY.
+*/
+class PageMapProvider : public PageProvider {
+public:
+  /*!
+   * \brief Creates the provider of an owner
+   *
+   * \param map The map to record the pages in, it has to outlive the provider
+   * \param owner The index of the owner
+   * \param provider Where the pages come from, nullptr means the global heap
+   */
+  PageMapProvider(PageMap &map, unsigned owner, PageProvider *provider);
+
+  /*!
+   * \brief Gets the memory for one page, aligned to at least PageMap::GRANULE, and records it
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory or the map can't record it
+   */
+  void *AllocatePage(size_t size, size_t alignment) override;
+
+  /*!
+   * \brief Forgets a page and returns its memory (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  void FreePage(void *page, size_t size, size_t alignment) override;
+
+  // Prevent copy construction and assignment
+  PageMapProvider(const PageMapProvider &other) = delete; //!< Do not implement!
+  PageMapProvider &operator=(const PageMapProvider &other) = delete; //!< Do not implement!
+
+private:
+  PageMap &map; //!< Where the pages are recorded
+  unsigned owner; //!< Recorded as the owner of every page
+  HeapPageProvider heap; //!< Used when no provider was given
+  PageProvider *provider; //!< Where the pages come from
+};
+
+#endif
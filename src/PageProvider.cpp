@@ -0,0 +1,279 @@
+/**
+ * \file PageProvider.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the page providers
+ */
+
+#include "PageProvider.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #define OA_HAS_MMAP 1
+#else
+  #define OA_HAS_MMAP 0
+#endif
+
+namespace {
+  /*!
+   * \brief Rounds a size up to a multiple of a power of two
+   *
+   * \param size The size to round
+   * \param granularity The power of two
+   * \return The rounded size
+   */
+  size_t round_up(size_t size, size_t granularity) { return (size + granularity - 1) & ~(granularity - 1); }
+
+#if OA_HAS_MMAP
+  /*!
+   * \brief Returns the size of a system page
+   *
+   * \return The granularity of the mappings
+   */
+  size_t system_page_size() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+  }
+
+  /*!
+   * \brief Maps anonymous private memory
+   *
+   * \param size The size of the mapping, a multiple of the system page size
+   * \param flags Extra mmap flags
+   * \return The mapping, nullptr if it failed
+   */
+  void *map_anonymous(size_t size, int flags) {
+    void *output = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return output != MAP_FAILED ? output : nullptr;
+  }
+
+  /*!
+   * \brief Maps anonymous private memory at an aligned address
+   *
+   * \param size The size of the mapping, a multiple of the system page size
+   * \param alignment The alignment of the mapping, a power of two
+   * \return The mapping, nullptr if it failed
+   */
+  void *map_aligned(size_t size, size_t alignment) {
+    if (alignment <= system_page_size()) {
+      return map_anonymous(size, 0);
+    }
+
+    // Map extra and trim both ends, what is left is exactly size bytes starting at an aligned address
+    uint8_t *mapping = static_cast<uint8_t *>(map_anonymous(size + alignment, 0));
+    if (mapping == nullptr) {
+      return nullptr;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(mapping);
+    size_t head = round_up(address, alignment) - address;
+
+    if (head != 0) {
+      munmap(mapping, head);
+    }
+    munmap(mapping + head + size, alignment - head);
+
+    return mapping + head;
+  }
+#endif
+
+  /*!
+   * \brief Gets a page from the global heap
+   *
+   * \param size The size of the page
+   * \param alignment The alignment of the page
+   * \return Pointer to the page, nullptr if there is no memory
+   */
+  void *heap_allocate(size_t size, size_t alignment) {
+    if (alignment <= alignof(std::max_align_t)) {
+      return new (std::nothrow) unsigned char[size];
+    }
+
+#if OA_HAS_MMAP
+    void *output = nullptr;
+    return posix_memalign(&output, alignment, size) == 0 ? output : nullptr;
+#else
+    // The start of the block is kept right before the aligned page
+    unsigned char *block = new (std::nothrow) unsigned char[size + alignment];
+    if (block == nullptr) {
+      return nullptr;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(block) + sizeof(void *);
+    unsigned char *output = block + (round_up(address, alignment) - reinterpret_cast<uintptr_t>(block));
+    reinterpret_cast<unsigned char **>(output)[-1] = block;
+
+    return output;
+#endif
+  }
+
+  /*!
+   * \brief Returns a page to the global heap
+   *
+   * \param page The page to free
+   * \param alignment The alignment the page was allocated with
+   */
+  void heap_free(void *page, size_t alignment) {
+    if (alignment <= alignof(std::max_align_t)) {
+      delete[] static_cast<unsigned char *>(page);
+      return;
+    }
+
+#if OA_HAS_MMAP
+    free(page);
+#else
+    delete[] static_cast<unsigned char **>(page)[-1];
+#endif
+  }
+} // namespace
+
+/*!
+ * \brief Gets the memory for one page
+ *
+ * \param size The size of the page in bytes
+ * \param alignment The alignment of the page, a power of two
+ * \return Pointer to the page, nullptr if there is no memory
+ */
+void *HeapPageProvider::AllocatePage(size_t size, size_t alignment) { return heap_allocate(size, alignment); }
+
+/*!
+ * \brief Returns the memory of a page (never throws)
+ *
+ * \param page Pointer returned by AllocatePage
+ * \param alignment The alignment the page was allocated with
+ */
+void HeapPageProvider::FreePage(void *page, size_t, size_t alignment) { heap_free(page, alignment); }
+
+/*!
+ * \brief Gets the memory for one page
+ *
+ * \param size The size of the page in bytes
+ * \param alignment The alignment of the page, a power of two
+ * \return Pointer to the page, nullptr if there is no memory
+ */
+void *MmapPageProvider::AllocatePage(size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  return map_aligned(round_up(size, system_page_size()), alignment);
+#else
+  return heap_allocate(size, alignment);
+#endif
+}
+
+/*!
+ * \brief Returns the memory of a page (never throws)
+ *
+ * \param page Pointer returned by AllocatePage
+ * \param size The size the page was allocated with
+ * \param alignment The alignment the page was allocated with
+ */
+void MmapPageProvider::FreePage(void *page, size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  static_cast<void>(alignment);
+  munmap(page, round_up(size, system_page_size()));
+#else
+  static_cast<void>(size);
+  heap_free(page, alignment);
+#endif
+}
+
+/*!
+ * \brief Gets the memory for one page
+ *
+ * \param size The size of the page in bytes
+ * \param alignment The alignment of the page, a power of two
+ * \return Pointer to the page, nullptr if there is no memory
+ */
+void *HugePageProvider::AllocatePage(size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  size_t length = round_up(size, HUGE_PAGE_SIZE);
+
+  #if defined(MAP_HUGETLB)
+  // Huge page mappings are only guaranteed to be aligned to the huge page size
+  if (alignment <= HUGE_PAGE_SIZE) {
+    void *reserved = map_anonymous(length, MAP_HUGETLB);
+    if (reserved != nullptr) {
+      return reserved;
+    }
+  }
+  #endif
+
+  // Transparent huge pages only back ranges aligned to the huge page size
+  void *output = map_aligned(length, alignment > HUGE_PAGE_SIZE ? alignment : HUGE_PAGE_SIZE);
+
+  #if defined(MADV_HUGEPAGE)
+  if (output != nullptr) {
+    madvise(output, length, MADV_HUGEPAGE);
+  }
+  #endif
+
+  return output;
+#else
+  return heap_allocate(size, alignment);
+#endif
+}
+
+/*!
+ * \brief Returns the memory of a page (never throws)
+ *
+ * \param page Pointer returned by AllocatePage
+ * \param size The size the page was allocated with
+ * \param alignment The alignment the page was allocated with
+ */
+void HugePageProvider::FreePage(void *page, size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  static_cast<void>(alignment);
+  munmap(page, round_up(size, HUGE_PAGE_SIZE));
+#else
+  static_cast<void>(size);
+  heap_free(page, alignment);
+#endif
+}
+
+/*!
+ * \brief Gets the memory for one page
+ *
+ * \param size The size of the page in bytes
+ * \param alignment The alignment of the page, a power of two
+ * \return Pointer to the page, nullptr if there is no memory or the lock limit was reached
+ */
+void *LockedPageProvider::AllocatePage(size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  size_t length = round_up(size, system_page_size());
+  void *page = map_aligned(length, alignment);
+
+  // Locking faults every page in, so nothing is left to fault on the hot path
+  if (page != nullptr && mlock(page, length) != 0) {
+    munmap(page, length);
+    return nullptr;
+  }
+
+  return page;
+#else
+  return heap_allocate(size, alignment);
+#endif
+}
+
+/*!
+ * \brief Returns the memory of a page (never throws)
+ *
+ * \param page Pointer returned by AllocatePage
+ * \param size The size the page was allocated with
+ * \param alignment The alignment the page was allocated with
+ */
+void LockedPageProvider::FreePage(void *page, size_t size, size_t alignment) {
+#if OA_HAS_MMAP
+  static_cast<void>(alignment);
+  size_t length = round_up(size, system_page_size());
+  munlock(page, length);
+  munmap(page, length);
+#else
+  static_cast<void>(size);
+  heap_free(page, alignment);
+#endif
+}
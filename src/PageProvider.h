@@ -0,0 +1,152 @@
+/**
+ * @file PageProvider.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Sources of raw page memory for the ObjectAllocator (heap, mmap, huge pages and locked pages)
+ */
+
+//---------------------------------------------------------------------------
+#ifndef PAGEPROVIDERH
+#define PAGEPROVIDERH
+//---------------------------------------------------------------------------
+
+#include <cstddef>
+
+/*!
+  Where an ObjectAllocator gets its pages from, see OAConfig::PageProvider_. Pages must be aligned to the requested
+  alignment, a power of two no smaller than alignof(std::max_align_t). A provider may be shared by several allocators
+  and has to outlive all of them. Every provider here is stateless, so it can be used from several threads at once.
+*/
+class PageProvider {
+public:
+  /*!
+   * \brief Destroys the provider
+   */
+  virtual ~PageProvider() {}
+
+  /*!
+   * \brief Gets the memory for one page
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory
+   */
+  virtual void *AllocatePage(size_t size, size_t alignment) = 0;
+
+  /*!
+   * \brief Returns the memory of a page (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  virtual void FreePage(void *page, size_t size, size_t alignment) = 0;
+};
+
+/*!
+  The global heap, what the allocator uses when no provider is given
+*/
+class HeapPageProvider : public PageProvider {
+public:
+  /*!
+   * \brief Gets the memory for one page
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory
+   */
+  void *AllocatePage(size_t size, size_t alignment) override;
+
+  /*!
+   * \brief Returns the memory of a page (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  void FreePage(void *page, size_t size, size_t alignment) override;
+};
+
+/*!
+  One anonymous private mapping per page, rounded up to the system page size. Freed pages go straight back to the
+  system instead of staying in the heap. Alignments above the system page size map extra and trim it. Falls back to
+  the heap where mmap is not available.
+*/
+class MmapPageProvider : public PageProvider {
+public:
+  /*!
+   * \brief Gets the memory for one page
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory
+   */
+  void *AllocatePage(size_t size, size_t alignment) override;
+
+  /*!
+   * \brief Returns the memory of a page (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  void FreePage(void *page, size_t size, size_t alignment) override;
+};
+
+/*!
+  One mapping per page, rounded up to HUGE_PAGE_SIZE and backed by huge pages, so a page of a large ObjectsPerPage_
+  configuration costs a single TLB entry. Tries MAP_HUGETLB first (needs reserved huge pages) and otherwise asks for
+  transparent huge pages with madvise. Only worth it when pages are close to HUGE_PAGE_SIZE, smaller ones waste the
+  rest of the mapping.
+*/
+class HugePageProvider : public PageProvider {
+public:
+  static const size_t HUGE_PAGE_SIZE = size_t(2) << 20; //!< 2 MiB, the x86-64 and AArch64 default
+
+  /*!
+   * \brief Gets the memory for one page
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory
+   */
+  void *AllocatePage(size_t size, size_t alignment) override;
+
+  /*!
+   * \brief Returns the memory of a page (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  void FreePage(void *page, size_t size, size_t alignment) override;
+};
+
+/*!
+  Like MmapPageProvider, but the page is faulted in and locked in RAM before it is handed out, so touching it never
+  page faults or swaps. Fails with nullptr when the lock limit (RLIMIT_MEMLOCK) is reached.
+*/
+class LockedPageProvider : public PageProvider {
+public:
+  /*!
+   * \brief Gets the memory for one page
+   *
+   * \param size The size of the page in bytes
+   * \param alignment The alignment of the page, a power of two
+   * \return Pointer to the page, nullptr if there is no memory or the lock limit was reached
+   */
+  void *AllocatePage(size_t size, size_t alignment) override;
+
+  /*!
+   * \brief Returns the memory of a page (never throws)
+   *
+   * \param page Pointer returned by AllocatePage
+   * \param size The size the page was allocated with
+   * \param alignment The alignment the page was allocated with
+   */
+  void FreePage(void *page, size_t size, size_t alignment) override;
+};
+
+#endif
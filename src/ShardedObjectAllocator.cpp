@@ -0,0 +1,272 @@
+/**
+ * \file ShardedObjectAllocator.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the per-core sharded front end
+ */
+
+#include "ShardedObjectAllocator.h"
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__linux__)
+  #include <sched.h>
+#endif
+
+namespace {
+  const size_t CACHE_LINE_SIZE = 64;
+} // namespace
+
+/*!
+  One independent allocator with its own lock, padded so neighbouring shards never share a cache line
+*/
+struct ShardedObjectAllocator::Shard {
+  std::mutex mutex; //!< Guards allocator
+  std::unique_ptr<PageMapProvider> provider; //!< Records the shard's pages in the page map, outlives allocator
+  std::unique_ptr<ObjectAllocator> allocator; //!< The shard's pages and free list
+  std::unordered_map<const void *, unsigned> bypass_owners; //!< bypass_pages only, owners of the objects hashed here
+  char padding[CACHE_LINE_SIZE]; //!< Keeps the next shard's mutex off this cache line
+};
+
+/*!
+ * \brief Creates every shard. Throws an exception if the construction fails. (Memory allocation problem)
+ *
+ * \param ObjectSize The size to allocate for each object
+ * \param config The configuration every shard uses
+ * \param ShardCount How many shards to create, 0 creates one per hardware thread
+ */
+ShardedObjectAllocator::ShardedObjectAllocator(size_t ObjectSize, const OAConfig &config, unsigned ShardCount) :
+    page_map(), shards(), shard_count(ShardCount), bypass_pages(config.UseCPPMemManager_),
+    page_provider(config.PageProvider_) {
+  if (shard_count == 0) {
+    shard_count = std::thread::hardware_concurrency();
+  }
+
+  if (shard_count == 0) {
+    shard_count = 1;
+  }
+
+  try {
+    shards.reset(new Shard[shard_count]);
+
+    for (unsigned i = 0; i < shard_count; i++) {
+      OAConfig shard_config(config);
+
+      // Every page a shard gets is in the page map before the shard can hand out a block of it
+      if (!bypass_pages) {
+        shards[i].provider.reset(new PageMapProvider(page_map, i, page_provider));
+        shard_config.PageProvider_ = shards[i].provider.get();
+      }
+
+      shards[i].allocator.reset(new ObjectAllocator(ObjectSize, shard_config));
+    }
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating the shards.");
+  }
+}
+
+/*!
+ * \brief Destroys every shard (never throws)
+ */
+ShardedObjectAllocator::~ShardedObjectAllocator() {}
+
+/*!
+ * \brief Allocates from the shard of the calling thread's core. Throws an exception if the object can't be
+ * allocated. (Memory allocation problem)
+ *
+ * \param label The label to put in the external header
+ *
+ * \return Pointer to the allocated block
+ */
+void *ShardedObjectAllocator::Allocate(const char *label) {
+  unsigned index = shard_select();
+  Shard &shard = shards[index];
+  void *object = nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    object = shard.allocator->Allocate(label);
+  }
+
+  // Taken after the shard's lock is released, so no thread ever holds two
+  if (bypass_pages) {
+    bypass_record(object, index);
+  }
+
+  return object;
+}
+
+/*!
+ * \brief Returns an object to the shard that owns it. Throws an exception if the object can't be freed. (Invalid
+ * object)
+ *
+ * \param Object Pointer to the block to deallocate
+ */
+void ShardedObjectAllocator::Free(void *Object) {
+  // Each shard counts its own objects, so the one that allocated the object frees it in both cases
+  unsigned index = bypass_pages ? bypass_forget(Object) : page_map.Find(Object);
+
+  if (index == PageMap::NO_OWNER) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "The memory address does not belong to any shard's pages");
+  }
+
+  // The page can't go away or change owner in between, it still holds this live object
+  std::lock_guard<std::mutex> lock(shards[index].mutex);
+  shards[index].allocator->Free(Object);
+}
+
+/*!
+ * \brief Frees the empty pages of every shard
+ *
+ * \return Amount of pages freed
+ */
+unsigned ShardedObjectAllocator::FreeEmptyPages() {
+  unsigned freed = 0;
+
+  for (unsigned i = 0; i < shard_count; i++) {
+    // The shard's provider takes every freed page out of the page map
+    std::lock_guard<std::mutex> lock(shards[i].mutex);
+    freed += shards[i].allocator->FreeEmptyPages();
+  }
+
+  return freed;
+}
+
+/*!
+ * \brief Getter for the amount of shards
+ *
+ * \return The amount of shards
+ */
+unsigned ShardedObjectAllocator::GetShardCount() const { return shard_count; }
+
+/*!
+ * \brief Getter for the configuration every shard uses
+ *
+ * \return The configuration of the shards
+ */
+OAConfig ShardedObjectAllocator::GetConfig() const {
+  OAConfig output = shards[0].allocator->GetConfig();
+  output.PageProvider_ = page_provider;
+
+  return output;
+}
+
+/*!
+ * \brief Getter for the statistics of a single shard
+ *
+ * \param shard The index of the shard
+ * \return The statistics of the shard
+ */
+OAStats ShardedObjectAllocator::GetShardStats(unsigned shard) const {
+  std::lock_guard<std::mutex> lock(shards[shard].mutex);
+  return shards[shard].allocator->GetStats();
+}
+
+/*!
+ * \brief Getter for the statistics of every shard added together. MostObjects_ is the sum of every shard's peak,
+ * so it is an upper bound of the real peak.
+ *
+ * \return The aggregated statistics
+ */
+OAStats ShardedObjectAllocator::GetStats() const {
+  OAStats output;
+
+  for (unsigned i = 0; i < shard_count; i++) {
+    OAStats shard = GetShardStats(i);
+
+    output.ObjectSize_ = shard.ObjectSize_;
+    output.PageSize_ = shard.PageSize_;
+    output.FreeObjects_ += shard.FreeObjects_;
+    output.ObjectsInUse_ += shard.ObjectsInUse_;
+    output.PagesInUse_ += shard.PagesInUse_;
+    output.MostObjects_ += shard.MostObjects_;
+    output.Allocations_ += shard.Allocations_;
+    output.Deallocations_ += shard.Deallocations_;
+    output.CacheHits_ += shard.CacheHits_;
+    output.CacheRefills_ += shard.CacheRefills_;
+    output.CacheFlushes_ += shard.CacheFlushes_;
+    output.SampledPages_ += shard.SampledPages_;
+    output.DebugChecks_ += shard.DebugChecks_;
+    output.DebugHits_ += shard.DebugHits_;
+    output.ScrubPasses_ += shard.ScrubPasses_;
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Picks the shard of the core the calling thread runs on
+ *
+ * \return The index of the shard
+ */
+unsigned ShardedObjectAllocator::shard_select() const {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return static_cast<unsigned>(cpu) % shard_count;
+  }
+#endif
+
+  // Without a way to ask for the core, threads are spread by their id instead
+  static thread_local size_t thread_hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+  return static_cast<unsigned>(thread_hash % shard_count);
+}
+
+/*!
+ * \brief Picks the shard whose bypass_owners holds the owner of an object, bypass_pages only
+ *
+ * \param object The object
+ * \return The index of the shard
+ */
+unsigned ShardedObjectAllocator::bypass_shard(const void *object) const {
+  // The low bits are the same for every object new hands out
+  return static_cast<unsigned>((reinterpret_cast<uintptr_t>(object) / alignof(std::max_align_t)) % shard_count);
+}
+
+/*!
+ * \brief Remembers the owner of an object allocated with bypass_pages. Throws an exception if there is no memory to
+ * remember it, the object is freed then. (Memory allocation problem)
+ *
+ * \param object The object
+ * \param owner The index of the shard that allocated it
+ */
+void ShardedObjectAllocator::bypass_record(void *object, unsigned owner) {
+  Shard &table = shards[bypass_shard(object)];
+
+  try {
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.bypass_owners[object] = owner;
+
+  } catch (const std::bad_alloc &) {
+    std::lock_guard<std::mutex> lock(shards[owner].mutex);
+    shards[owner].allocator->Free(object);
+
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while recording the owner of an object.");
+  }
+}
+
+/*!
+ * \brief Looks up and forgets the owner of an object allocated with bypass_pages
+ *
+ * \param object The object
+ * \return The index of the shard that allocated it, PageMap::NO_OWNER if it is not a live object
+ */
+unsigned ShardedObjectAllocator::bypass_forget(const void *object) {
+  Shard &table = shards[bypass_shard(object)];
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  auto position = table.bypass_owners.find(object);
+  if (position == table.bypass_owners.end()) {
+    return PageMap::NO_OWNER;
+  }
+
+  // Freeing an object in bypass mode never fails, so it can be forgotten before the free
+  unsigned owner = position->second;
+  table.bypass_owners.erase(position);
+  return owner;
+}
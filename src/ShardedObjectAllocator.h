@@ -0,0 +1,146 @@
+/**
+ * @file ShardedObjectAllocator.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Front end that spreads allocations over one ObjectAllocator per core
+ */
+
+//---------------------------------------------------------------------------
+#ifndef SHARDEDOBJECTALLOCATORH
+#define SHARDEDOBJECTALLOCATORH
+//---------------------------------------------------------------------------
+
+#include "ObjectAllocator.h"
+#include "PageMap.h"
+#include <memory>
+#include <mutex>
+
+/*!
+  Owns one independent ObjectAllocator (a shard) per core, each behind its own lock. Allocate goes to the shard of the
+  core the calling thread runs on, so threads on different cores never share a lock. Free goes to the shard that owns
+  the block's page, looked up from the block's address in a PageMap that each shard's page provider keeps up to date,
+  so the lookup takes no lock and only the owning shard's lock is taken. With UseCPPMemManager_ there are no pages, so
+  the owner of each object is remembered in a table spread over the shards by address instead.
+
+  Every shard uses the same configuration, so MaxPages_ applies to each shard on its own.
+*/
+class ShardedObjectAllocator {
+public:
+  /*!
+   * \brief Creates every shard. Throws an exception if the construction fails. (Memory allocation problem)
+   *
+   * \param ObjectSize The size to allocate for each object
+   * \param config The configuration every shard uses
+   * \param ShardCount How many shards to create, 0 creates one per hardware thread
+   */
+  ShardedObjectAllocator(size_t ObjectSize, const OAConfig &config, unsigned ShardCount = 0);
+
+  /*!
+   * \brief Destroys every shard (never throws)
+   */
+  ~ShardedObjectAllocator();
+
+  /*!
+   * \brief Allocates from the shard of the calling thread's core. Throws an exception if the object can't be
+   * allocated. (Memory allocation problem)
+   *
+   * \param label The label to put in the external header
+   *
+   * \return Pointer to the allocated block
+   */
+  void *Allocate(const char *label = 0);
+
+  /*!
+   * \brief Returns an object to the shard that owns it. Throws an exception if the object can't be freed. (Invalid
+   * object)
+   *
+   * \param Object Pointer to the block to deallocate
+   */
+  void Free(void *Object);
+
+  /*!
+   * \brief Frees the empty pages of every shard
+   *
+   * \return Amount of pages freed
+   */
+  unsigned FreeEmptyPages();
+
+  /*!
+   * \brief Getter for the amount of shards
+   *
+   * \return The amount of shards
+   */
+  unsigned GetShardCount() const;
+
+  /*!
+   * \brief Getter for the configuration every shard uses
+   *
+   * \return The configuration of the shards
+   */
+  OAConfig GetConfig() const;
+
+  /*!
+   * \brief Getter for the statistics of a single shard
+   *
+   * \param shard The index of the shard
+   * \return The statistics of the shard
+   */
+  OAStats GetShardStats(unsigned shard) const;
+
+  /*!
+   * \brief Getter for the statistics of every shard added together. MostObjects_ is the sum of every shard's peak,
+   * so it is an upper bound of the real peak.
+   *
+   * \return The aggregated statistics
+   */
+  OAStats GetStats() const;
+
+  // Prevent copy construction and assignment
+  ShardedObjectAllocator(const ShardedObjectAllocator &other) = delete; //!< Do not implement!
+  ShardedObjectAllocator &operator=(const ShardedObjectAllocator &other) = delete; //!< Do not implement!
+
+private:
+  struct Shard;
+
+  PageMap page_map; //!< Which shard owns which page, outlives the shards
+  std::unique_ptr<Shard[]> shards;
+  unsigned shard_count;
+  bool bypass_pages; //!< UseCPPMemManager_ hands out no pages, the owners are kept in the shards' bypass_owners
+  PageProvider *page_provider; //!< The configured provider, the shards get their pages through it
+
+  /*!
+   * \brief Picks the shard of the core the calling thread runs on
+   *
+   * \return The index of the shard
+   */
+  unsigned shard_select() const;
+
+  /*!
+   * \brief Picks the shard whose bypass_owners holds the owner of an object, bypass_pages only
+   *
+   * \param object The object
+   * \return The index of the shard
+   */
+  unsigned bypass_shard(const void *object) const;
+
+  /*!
+   * \brief Remembers the owner of an object allocated with bypass_pages. Throws an exception if there is no memory to
+   * remember it, the object is freed then. (Memory allocation problem)
+   *
+   * \param object The object
+   * \param owner The index of the shard that allocated it
+   */
+  void bypass_record(void *object, unsigned owner);
+
+  /*!
+   * \brief Looks up and forgets the owner of an object allocated with bypass_pages
+   *
+   * \param object The object
+   * \return The index of the shard that allocated it, PageMap::NO_OWNER if it is not a live object
+   */
+  unsigned bypass_forget(const void *object);
+};
+
+#endif
@@ -0,0 +1,256 @@
+/**
+ * \file SizeClassAllocator.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the size class allocator
+ */
+
+#include "SizeClassAllocator.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+namespace {
+  // Four classes per power of two keep the rounding waste under 25%
+  const size_t CLASS_SIZES[SizeClassAllocator::CLASS_COUNT] = {
+      8, 16, 24, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+
+  const size_t CLASS_GRANULE = 8; //!< Every class size is a multiple of this
+
+  /*!
+    Maps a size, in granules rounded up, to its class, so the lookup is a single load
+  */
+  struct ClassTable {
+    unsigned char index[SizeClassAllocator::MAX_CLASS_SIZE / CLASS_GRANULE + 1]; //!< Class for each granule count
+
+    /*!
+     * \brief Fills the table from CLASS_SIZES
+     */
+    ClassTable() : index() {
+      unsigned current = 0;
+
+      for (size_t granules = 0; granules <= SizeClassAllocator::MAX_CLASS_SIZE / CLASS_GRANULE; granules++) {
+        while (CLASS_SIZES[current] < granules * CLASS_GRANULE) {
+          current++;
+        }
+
+        index[granules] = static_cast<unsigned char>(current);
+      }
+    }
+  };
+
+  const ClassTable CLASS_TABLE;
+} // namespace
+
+/*!
+ * \brief Creates the allocator, the size classes are created on first use. Throws an exception if there is no
+ * memory. (Memory allocation problem)
+ *
+ * \param config The configuration of every size class (Alignment_ is raised as needed)
+ */
+SizeClassAllocator::SizeClassAllocator(const OAConfig &config) :
+    config(config), page_map(), providers(), classes(), big_objects() {}
+
+/*!
+ * \brief Destroys every size class and frees the big objects still in use (never throws)
+ */
+SizeClassAllocator::~SizeClassAllocator() {
+  for (const std::pair<void *const, size_t> &object : big_objects) {
+    ::operator delete(object.first);
+  }
+}
+
+/*!
+ * \brief Allocates a block of at least size bytes, a size of 0 still gets a unique block. Throws an exception if the
+ * object can't be allocated. (Memory allocation problem)
+ *
+ * \param size The amount of bytes needed
+ * \param label The label to put in the external header
+ * \return Pointer to the allocated block
+ */
+void *SizeClassAllocator::Allocate(size_t size, const char *label) {
+  unsigned index = GetSizeClass(size);
+
+  // With UseCPPMemManager_ the pages are never seen, so the owning class couldn't be found on Free
+  if (index == CLASS_COUNT || config.UseCPPMemManager_) {
+    return big_allocate(size);
+  }
+
+  return class_get(index)->Allocate(label);
+}
+
+/*!
+ * \brief Returns a block to its size class, nullptr is ignored. Throws an exception if the object can't be freed.
+ * (Invalid object)
+ *
+ * \param Object Pointer to the block to deallocate
+ */
+void SizeClassAllocator::Free(void *Object) {
+  if (Object == nullptr) {
+    return;
+  }
+
+  unsigned index = page_map.Find(Object);
+
+  if (index != PageMap::NO_OWNER) {
+    classes[index]->Free(Object);
+    return;
+  }
+
+  if (big_objects.erase(Object) == 0) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "The memory address does not belong to any size class");
+  }
+
+  ::operator delete(Object);
+}
+
+/*!
+ * \brief Frees the empty pages of every size class
+ *
+ * \return Amount of pages freed
+ */
+unsigned SizeClassAllocator::FreeEmptyPages() {
+  unsigned freed = 0;
+
+  for (unsigned i = 0; i < CLASS_COUNT; i++) {
+    // The class's provider takes every freed page out of the page map
+    if (classes[i] != nullptr) {
+      freed += classes[i]->FreeEmptyPages();
+    }
+  }
+
+  return freed;
+}
+
+/*!
+ * \brief Returns the usable size of an allocated block
+ *
+ * \param Object Pointer to an allocated block
+ * \return The size of the block's class, or the requested size for big objects, 0 if the object is unknown
+ */
+size_t SizeClassAllocator::GetAllocationSize(const void *Object) const {
+  unsigned index = page_map.Find(Object);
+
+  if (index != PageMap::NO_OWNER) {
+    return CLASS_SIZES[index];
+  }
+
+  auto position = big_objects.find(const_cast<void *>(Object));
+  return position != big_objects.end() ? position->second : 0;
+}
+
+/*!
+ * \brief Returns the size class serving a request
+ *
+ * \param size The amount of bytes needed
+ * \return The index of the size class, CLASS_COUNT if the size is too big for the classes
+ */
+unsigned SizeClassAllocator::GetSizeClass(size_t size) {
+  if (size > MAX_CLASS_SIZE) {
+    return CLASS_COUNT;
+  }
+
+  return CLASS_TABLE.index[(size + CLASS_GRANULE - 1) / CLASS_GRANULE];
+}
+
+/*!
+ * \brief Returns the size of the blocks of a size class
+ *
+ * \param index The index of the size class
+ * \return The size of the blocks
+ */
+size_t SizeClassAllocator::GetClassSize(unsigned index) { return CLASS_SIZES[index]; }
+
+/*!
+ * \brief Getter for the statistics of a size class
+ *
+ * \param index The index of the size class
+ * \return The statistics of the class, all zero if it was never used
+ */
+OAStats SizeClassAllocator::GetClassStats(unsigned index) const {
+  return classes[index] != nullptr ? classes[index]->GetStats() : OAStats();
+}
+
+/*!
+ * \brief Getter for the statistics of every size class added together. Big objects are not included.
+ *
+ * \return The aggregated statistics, ObjectSize_ and PageSize_ are left at 0
+ */
+OAStats SizeClassAllocator::GetStats() const {
+  OAStats output;
+
+  for (unsigned i = 0; i < CLASS_COUNT; i++) {
+    OAStats stats = GetClassStats(i);
+
+    output.FreeObjects_ += stats.FreeObjects_;
+    output.ObjectsInUse_ += stats.ObjectsInUse_;
+    output.PagesInUse_ += stats.PagesInUse_;
+    output.MostObjects_ += stats.MostObjects_;
+    output.Allocations_ += stats.Allocations_;
+    output.Deallocations_ += stats.Deallocations_;
+    output.SampledPages_ += stats.SampledPages_;
+    output.DebugChecks_ += stats.DebugChecks_;
+    output.DebugHits_ += stats.DebugHits_;
+    output.ScrubPasses_ += stats.ScrubPasses_;
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Returns the allocator of a size class, creating it on first use. Throws an exception if it can't be
+ * created. (Memory allocation problem)
+ *
+ * \param index The index of the size class
+ * \return The allocator of the class
+ */
+ObjectAllocator *SizeClassAllocator::class_get(unsigned index) {
+  if (classes[index] != nullptr) {
+    return classes[index].get();
+  }
+
+  // The largest power of two dividing the class size, capped at what malloc guarantees
+  size_t class_size = CLASS_SIZES[index];
+  size_t alignment = std::min<size_t>(class_size & (~class_size + 1), alignof(std::max_align_t));
+
+  OAConfig class_config = OALayout::aligned_config(config, alignment);
+
+  try {
+    // Every page the class gets is in the page map before the class can hand out a block of it
+    if (providers[index] == nullptr) {
+      providers[index].reset(new PageMapProvider(page_map, index, config.PageProvider_));
+    }
+
+    class_config.PageProvider_ = providers[index].get();
+    classes[index].reset(new ObjectAllocator(class_size, class_config));
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating a size class.");
+  }
+
+  return classes[index].get();
+}
+
+/*!
+ * \brief Allocates a block bigger than every size class from the global heap. Throws an exception if the object
+ * can't be allocated. (Memory allocation problem)
+ *
+ * \param size The amount of bytes needed
+ * \return Pointer to the allocated block
+ */
+void *SizeClassAllocator::big_allocate(size_t size) {
+  void *output = nullptr;
+
+  try {
+    output = ::operator new(size);
+    big_objects.emplace(output, size);
+
+  } catch (const std::bad_alloc &) {
+    ::operator delete(output);
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown by 'new' operator.");
+  }
+
+  return output;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file SizeClassAllocator.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief General purpose allocator for variable-size small objects built from one ObjectAllocator per size class
+ */
+
+//---------------------------------------------------------------------------
+#ifndef SIZECLASSALLOCATORH
+#define SIZECLASSALLOCATORH
+//---------------------------------------------------------------------------
+
+#include "OALayout.h"
+#include "ObjectAllocator.h"
+#include "PageMap.h"
+#include <memory>
+#include <unordered_map>
+
+/*!
+  Malloc-like front end. Sizes up to MAX_CLASS_SIZE are rounded up to one of the size classes (four per power of two)
+  and served by that class's ObjectAllocator, which is created on first use. Bigger sizes go to the global heap.
+  Free finds the class from the page the object lives in, kept in a PageMap by each class's page provider, so no size
+  is stored with the object. Not thread safe.
+
+  Blocks are aligned to the largest power of two dividing their class size, up to alignof(std::max_align_t). With
+  UseCPPMemManager_ every request goes to the global heap.
+*/
+class SizeClassAllocator {
+public:
+  static const size_t MAX_CLASS_SIZE = 1024; //!< Bigger requests bypass the size classes
+  static const unsigned CLASS_COUNT = 22; //!< Amount of size classes
+
+  /*!
+   * \brief Creates the allocator, the size classes are created on first use. Throws an exception if there is no
+   * memory. (Memory allocation problem)
+   *
+   * \param config The configuration of every size class (Alignment_ is raised as needed)
+   */
+  explicit SizeClassAllocator(const OAConfig &config = OAConfig(false, POOL_OBJECTS_PER_PAGE, 0));
+
+  /*!
+   * \brief Destroys every size class and frees the big objects still in use (never throws)
+   */
+  ~SizeClassAllocator();
+
+  /*!
+   * \brief Allocates a block of at least size bytes, a size of 0 still gets a unique block. Throws an exception if the
+   * object can't be allocated. (Memory allocation problem)
+   *
+   * \param size The amount of bytes needed
+   * \param label The label to put in the external header
+   * \return Pointer to the allocated block
+   */
+  void *Allocate(size_t size, const char *label = 0);
+
+  /*!
+   * \brief Returns a block to its size class, nullptr is ignored. Throws an exception if the object can't be freed.
+   * (Invalid object)
+   *
+   * \param Object Pointer to the block to deallocate
+   */
+  void Free(void *Object);
+
+  /*!
+   * \brief Frees the empty pages of every size class
+   *
+   * \return Amount of pages freed
+   */
+  unsigned FreeEmptyPages();
+
+  /*!
+   * \brief Returns the usable size of an allocated block
+   *
+   * \param Object Pointer to an allocated block
+   * \return The size of the block's class, or the requested size for big objects, 0 if the object is unknown
+   */
+  size_t GetAllocationSize(const void *Object) const;
+
+  /*!
+   * \brief Returns the size class serving a request
+   *
+   * \param size The amount of bytes needed
+   * \return The index of the size class, CLASS_COUNT if the size is too big for the classes
+   */
+  static unsigned GetSizeClass(size_t size);
+
+  /*!
+   * \brief Returns the size of the blocks of a size class
+   *
+   * \param index The index of the size class
+   * \return The size of the blocks
+   */
+  static size_t GetClassSize(unsigned index);
+
+  /*!
+   * \brief Getter for the statistics of a size class
+   *
+   * \param index The index of the size class
+   * \return The statistics of the class, all zero if it was never used
+   */
+  OAStats GetClassStats(unsigned index) const;
+
+  /*!
+   * \brief Getter for the statistics of every size class added together. Big objects are not included.
+   *
+   * \return The aggregated statistics, ObjectSize_ and PageSize_ are left at 0
+   */
+  OAStats GetStats() const;
+
+  // Prevent copy construction and assignment
+  SizeClassAllocator(const SizeClassAllocator &other) = delete; //!< Do not implement!
+  SizeClassAllocator &operator=(const SizeClassAllocator &other) = delete; //!< Do not implement!
+
+private:
+  OAConfig config;
+  PageMap page_map; //!< Which class owns which page, outlives the classes
+  std::unique_ptr<PageMapProvider> providers[CLASS_COUNT]; //!< Record each class's pages, outlive the classes
+  std::unique_ptr<ObjectAllocator> classes[CLASS_COUNT]; //!< nullptr until the class is first used
+  std::unordered_map<void *, size_t> big_objects; //!< Blocks bigger than MAX_CLASS_SIZE with their size
+
+  /*!
+   * \brief Returns the allocator of a size class, creating it on first use. Throws an exception if it can't be
+   * created. (Memory allocation problem)
+   *
+   * \param index The index of the size class
+   * \return The allocator of the class
+   */
+  ObjectAllocator *class_get(unsigned index);
+
+  /*!
+   * \brief Allocates a block bigger than every size class from the global heap. Throws an exception if the object
+   * can't be allocated. (Memory allocation problem)
+   *
+   * \param size The amount of bytes needed
+   * \return Pointer to the allocated block
+   */
+  void *big_allocate(size_t size);
+};
+
+#endif
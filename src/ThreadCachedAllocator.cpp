@@ -0,0 +1,353 @@
+/**
+ * \file ThreadCachedAllocator.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the thread caching front end
+ */
+
+#include "ThreadCachedAllocator.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+  const size_t CACHE_LINE_SIZE = 64;
+
+  std::atomic<uint64_t> next_allocator_id(1);
+
+  // Allocators that are still alive, so exiting threads never flush into a destroyed one
+  std::mutex registry_mutex;
+  std::unordered_set<uint64_t> live_allocators;
+
+  /*!
+   * \brief Increments a counter that only the calling thread writes. Other threads may read it at any time.
+   *
+   * \param counter The counter to increment
+   * \param amount How much to add
+   */
+  void owner_add(std::atomic<uint64_t> &counter, uint64_t amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+} // namespace
+
+/*!
+  The blocks cached by one thread for one allocator. Padded on both sides, the owning thread writes the counters on
+  every call and magazines of different threads are allocated next to each other.
+*/
+struct ThreadCachedAllocator::Magazine {
+  char leading_padding[CACHE_LINE_SIZE]; //!< Keeps whatever the heap put before the magazine off its cache lines
+  std::vector<void *> blocks; //!< Written by the owning thread only, never grows past its reserved capacity
+  std::atomic<unsigned> cached; //!< Mirror of blocks.size() readable by GetStats
+  std::atomic<uint64_t> allocations; //!< Client allocations served through this magazine
+  std::atomic<uint64_t> deallocations; //!< Client frees served through this magazine
+  std::atomic<uint64_t> hits; //!< Allocations served without a refill
+  std::atomic<uint64_t> refills; //!< Batches taken from the shared allocator
+  std::atomic<uint64_t> flushes; //!< Batches returned to the shared allocator
+  bool orphaned; //!< The owning thread exited, guarded by central_mutex
+  char trailing_padding[CACHE_LINE_SIZE]; //!< Keeps whatever the heap puts after the magazine off its cache lines
+
+  /*!
+   * \brief Creates an empty magazine
+   *
+   * \param capacity The most blocks the magazine will ever hold
+   */
+  explicit Magazine(unsigned capacity) :
+      blocks(), cached(0), allocations(0), deallocations(0), hits(0), refills(0), flushes(0), orphaned(false) {
+    blocks.reserve(capacity);
+  }
+};
+
+/*!
+  The magazines of one thread, flushed back to their allocators when the thread exits
+*/
+struct ThreadCachedAllocator::ThreadMagazines {
+  /*!
+    Which magazine belongs to which allocator
+  */
+  struct Entry {
+    uint64_t owner_id; //!< Id of the allocator that owns the magazine
+    ThreadCachedAllocator *owner; //!< Only dereferenced while owner_id is known to be alive
+    Magazine *magazine; //!< The thread's magazine for that allocator
+  };
+
+  std::vector<Entry> entries; //!< Usually a single entry, searched linearly
+
+  /*!
+   * \brief Hands every magazine back to its allocator, skipping allocators that were already destroyed
+   */
+  ~ThreadMagazines() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    for (const Entry &entry : entries) {
+      if (live_allocators.count(entry.owner_id) != 0) {
+        entry.owner->magazine_release(entry.magazine);
+      }
+    }
+  }
+};
+
+thread_local ThreadCachedAllocator::ThreadMagazines ThreadCachedAllocator::thread_magazines;
+
+/*!
+ * \brief Creates the shared allocator. Throws an exception if the construction fails. (Memory allocation problem)
+ *
+ * \param ObjectSize The size to allocate for each object
+ * \param config The configuration of the shared allocator
+ * \param MagazineSize How many blocks move between a thread and the shared allocator at once
+ */
+ThreadCachedAllocator::ThreadCachedAllocator(size_t ObjectSize, const OAConfig &config, unsigned MagazineSize) :
+    central(ObjectSize, config), central_mutex(), magazines(), id(next_allocator_id++),
+    magazine_size(MagazineSize > 0 ? MagazineSize : 1),
+    bypass_cache(config.DebugOn_ || config.HBlockInfo_.type_ == OAConfig::hbExternal) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  try {
+    live_allocators.insert(id);
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while registering the allocator.");
+  }
+}
+
+/*!
+ * \brief Destroys the shared allocator along with every magazine (never throws). No other thread may be using the
+ * allocator anymore.
+ */
+ThreadCachedAllocator::~ThreadCachedAllocator() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  live_allocators.erase(id);
+}
+
+/*!
+ * \brief Takes a block from the calling thread's magazine, refilling it from the shared allocator when it is empty.
+ * Throws an exception if the object can't be allocated. (Memory allocation problem)
+ *
+ * \param label The label to put in the external header
+ *
+ * \return Pointer to the allocated block
+ */
+void *ThreadCachedAllocator::Allocate(const char *label) {
+  if (bypass_cache) {
+    std::lock_guard<std::mutex> lock(central_mutex);
+    return central.Allocate(label);
+  }
+
+  Magazine *magazine = magazine_get();
+
+  if (magazine->blocks.empty()) {
+    magazine_refill(magazine);
+  } else {
+    owner_add(magazine->hits);
+  }
+
+  void *output = magazine->blocks.back();
+  magazine->blocks.pop_back();
+
+  magazine->cached.store(static_cast<unsigned>(magazine->blocks.size()), std::memory_order_relaxed);
+  owner_add(magazine->allocations);
+
+  return output;
+}
+
+/*!
+ * \brief Returns a block to the calling thread's magazine, flushing half of it to the shared allocator when it is
+ * full. Throws an exception if the object can't be freed. (Invalid object)
+ *
+ * \param Object Pointer to the block to deallocate
+ */
+void ThreadCachedAllocator::Free(void *Object) {
+  if (bypass_cache) {
+    std::lock_guard<std::mutex> lock(central_mutex);
+    central.Free(Object);
+    return;
+  }
+
+  Magazine *magazine = magazine_get();
+
+  if (magazine->blocks.size() == magazine->blocks.capacity()) {
+    magazine_flush(magazine, magazine_size);
+  }
+
+  magazine->blocks.push_back(Object);
+
+  magazine->cached.store(static_cast<unsigned>(magazine->blocks.size()), std::memory_order_relaxed);
+  owner_add(magazine->deallocations);
+}
+
+/*!
+ * \brief Returns every block cached by the calling thread to the shared allocator
+ */
+void ThreadCachedAllocator::FlushThreadCache() {
+  for (const ThreadMagazines::Entry &entry : thread_magazines.entries) {
+    if (entry.owner_id == id && !entry.magazine->blocks.empty()) {
+      magazine_flush(entry.magazine, static_cast<unsigned>(entry.magazine->blocks.size()));
+    }
+  }
+}
+
+/*!
+ * \brief Frees the empty pages of the shared allocator. Blocks sitting in magazines keep their pages alive.
+ *
+ * \return Amount of pages freed
+ */
+unsigned ThreadCachedAllocator::FreeEmptyPages() {
+  std::lock_guard<std::mutex> lock(central_mutex);
+  return central.FreeEmptyPages();
+}
+
+/*!
+ * \brief Getter for the configuration of the shared allocator
+ *
+ * \return The configuration of the shared allocator
+ */
+OAConfig ThreadCachedAllocator::GetConfig() const { return central.GetConfig(); }
+
+/*!
+ * \brief Getter for the statistics as seen by the clients. Blocks cached in magazines count as free objects.
+ *
+ * \return The statistics of the allocator including the cache counters
+ */
+OAStats ThreadCachedAllocator::GetStats() const {
+  std::lock_guard<std::mutex> lock(central_mutex);
+  OAStats stats = central.GetStats();
+
+  if (bypass_cache) {
+    return stats;
+  }
+
+  unsigned cached = 0;
+  stats.Allocations_ = 0;
+  stats.Deallocations_ = 0;
+
+  for (const std::unique_ptr<Magazine> &magazine : magazines) {
+    cached += magazine->cached.load(std::memory_order_relaxed);
+    stats.Allocations_ += magazine->allocations.load(std::memory_order_relaxed);
+    stats.Deallocations_ += magazine->deallocations.load(std::memory_order_relaxed);
+    stats.CacheHits_ += magazine->hits.load(std::memory_order_relaxed);
+    stats.CacheRefills_ += magazine->refills.load(std::memory_order_relaxed);
+    stats.CacheFlushes_ += magazine->flushes.load(std::memory_order_relaxed);
+  }
+
+  // The shared allocator sees cached blocks as in use, the clients see them as free
+  stats.FreeObjects_ += cached;
+  stats.ObjectsInUse_ -= cached;
+
+  return stats;
+}
+
+/*!
+ * \brief Finds the calling thread's magazine, creating (or adopting an orphaned) one on first use
+ *
+ * \return The calling thread's magazine
+ */
+ThreadCachedAllocator::Magazine *ThreadCachedAllocator::magazine_get() {
+  std::vector<ThreadMagazines::Entry> &entries = thread_magazines.entries;
+
+  for (const ThreadMagazines::Entry &entry : entries) {
+    if (entry.owner_id == id) {
+      return entry.magazine;
+    }
+  }
+
+  std::lock_guard<std::mutex> registry_lock(registry_mutex);
+
+  // Forget the magazines of allocators that were destroyed since the last visit
+  auto first_stale = std::remove_if(entries.begin(), entries.end(), [](const ThreadMagazines::Entry &entry) {
+    return live_allocators.count(entry.owner_id) == 0;
+  });
+  entries.erase(first_stale, entries.end());
+
+  std::lock_guard<std::mutex> lock(central_mutex);
+  Magazine *output = nullptr;
+
+  for (const std::unique_ptr<Magazine> &magazine : magazines) {
+    if (magazine->orphaned) {
+      output = magazine.get();
+      break;
+    }
+  }
+
+  try {
+    if (output == nullptr) {
+      magazines.emplace_back(new Magazine(2 * magazine_size));
+      output = magazines.back().get();
+    }
+
+    entries.push_back(ThreadMagazines::Entry{id, this, output});
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating a thread cache.");
+  }
+
+  output->orphaned = false;
+  return output;
+}
+
+/*!
+ * \brief Moves up to magazine_size blocks from the shared allocator into the magazine
+ *
+ * \param magazine The magazine to refill
+ */
+void ThreadCachedAllocator::magazine_refill(Magazine *magazine) {
+  std::lock_guard<std::mutex> lock(central_mutex);
+  std::vector<void *> &blocks = magazine->blocks;
+  size_t cached = blocks.size();
+
+  try {
+    // Stays within the reserved capacity, so the vector never reallocates
+    blocks.resize(cached + magazine_size);
+    central.AllocateBatch(magazine_size, blocks.data() + cached);
+
+  } catch (const OAException &) {
+    blocks.resize(cached);
+
+    // Not enough room left for a whole batch, a partial one is still a refill, only fail when nothing could be taken
+    for (unsigned i = 0; i < magazine_size; i++) {
+      try {
+        blocks.push_back(central.Allocate());
+
+      } catch (const OAException &) {
+        if (i == 0) {
+          throw;
+        }
+        break;
+      }
+    }
+  }
+
+  owner_add(magazine->refills);
+}
+
+/*!
+ * \brief Moves blocks from the magazine back into the shared allocator
+ *
+ * \param magazine The magazine to flush
+ * \param count How many blocks to move
+ */
+void ThreadCachedAllocator::magazine_flush(Magazine *magazine, unsigned count) {
+  std::lock_guard<std::mutex> lock(central_mutex);
+  std::vector<void *> &blocks = magazine->blocks;
+
+  // The newest blocks go back, so the oldest ones stay cached
+  size_t kept = blocks.size() > count ? blocks.size() - count : 0;
+  central.FreeBatch(blocks.data() + kept, static_cast<unsigned>(blocks.size() - kept));
+  blocks.resize(kept);
+
+  magazine->cached.store(static_cast<unsigned>(magazine->blocks.size()), std::memory_order_relaxed);
+  owner_add(magazine->flushes);
+}
+
+/*!
+ * \brief Called when a thread exits. Flushes the thread's magazine and leaves it for another thread to adopt.
+ *
+ * \param magazine The magazine of the exiting thread
+ */
+void ThreadCachedAllocator::magazine_release(Magazine *magazine) {
+  if (!magazine->blocks.empty()) {
+    magazine_flush(magazine, static_cast<unsigned>(magazine->blocks.size()));
+  }
+
+  std::lock_guard<std::mutex> lock(central_mutex);
+  magazine->orphaned = true;
+}
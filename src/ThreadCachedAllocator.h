@@ -0,0 +1,141 @@
+/**
+ * @file ThreadCachedAllocator.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Thread caching front end for an ObjectAllocator shared between threads
+ */
+
+//---------------------------------------------------------------------------
+#ifndef THREADCACHEDALLOCATORH
+#define THREADCACHEDALLOCATORH
+//---------------------------------------------------------------------------
+
+#include "ObjectAllocator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// If the client doesn't specify it:
+static const unsigned DEFAULT_MAGAZINE_SIZE = 32;
+
+/*!
+  Shares one ObjectAllocator between threads. Every thread gets a magazine of blocks per allocator, so the common
+  Allocate/Free path takes no lock and touches no shared cache line. Magazines are refilled from and flushed back to
+  the shared allocator in batches of MagazineSize blocks.
+
+  Debug checking and external headers need every request to reach the shared allocator (validation on each Free, a
+  label on each Allocate), so with either of them enabled the magazines are bypassed.
+*/
+class ThreadCachedAllocator {
+public:
+  /*!
+   * \brief Creates the shared allocator. Throws an exception if the construction fails. (Memory allocation problem)
+   *
+   * \param ObjectSize The size to allocate for each object
+   * \param config The configuration of the shared allocator
+   * \param MagazineSize How many blocks move between a thread and the shared allocator at once
+   */
+  ThreadCachedAllocator(size_t ObjectSize, const OAConfig &config, unsigned MagazineSize = DEFAULT_MAGAZINE_SIZE);
+
+  /*!
+   * \brief Destroys the shared allocator along with every magazine (never throws). No other thread may be using the
+   * allocator anymore.
+   */
+  ~ThreadCachedAllocator();
+
+  /*!
+   * \brief Takes a block from the calling thread's magazine, refilling it from the shared allocator when it is empty.
+   * Throws an exception if the object can't be allocated. (Memory allocation problem)
+   *
+   * \param label The label to put in the external header
+   *
+   * \return Pointer to the allocated block
+   */
+  void *Allocate(const char *label = 0);
+
+  /*!
+   * \brief Returns a block to the calling thread's magazine, flushing half of it to the shared allocator when it is
+   * full. Throws an exception if the object can't be freed. (Invalid object)
+   *
+   * \param Object Pointer to the block to deallocate
+   */
+  void Free(void *Object);
+
+  /*!
+   * \brief Returns every block cached by the calling thread to the shared allocator
+   */
+  void FlushThreadCache();
+
+  /*!
+   * \brief Frees the empty pages of the shared allocator. Blocks sitting in magazines keep their pages alive.
+   *
+   * \return Amount of pages freed
+   */
+  unsigned FreeEmptyPages();
+
+  /*!
+   * \brief Getter for the configuration of the shared allocator
+   *
+   * \return The configuration of the shared allocator
+   */
+  OAConfig GetConfig() const;
+
+  /*!
+   * \brief Getter for the statistics as seen by the clients. Blocks cached in magazines count as free objects.
+   *
+   * \return The statistics of the allocator including the cache counters
+   */
+  OAStats GetStats() const;
+
+  // Prevent copy construction and assignment
+  ThreadCachedAllocator(const ThreadCachedAllocator &other) = delete; //!< Do not implement!
+  ThreadCachedAllocator &operator=(const ThreadCachedAllocator &other) = delete; //!< Do not implement!
+
+private:
+  struct Magazine;
+  struct ThreadMagazines;
+
+  static thread_local ThreadMagazines thread_magazines; //!< The magazines of the calling thread
+
+  ObjectAllocator central;
+  mutable std::mutex central_mutex; //!< Guards central and magazines
+  std::vector<std::unique_ptr<Magazine>> magazines; //!< Every magazine ever handed to a thread
+  const uint64_t id; //!< Never reused, lets exiting threads tell whether the allocator is still alive
+  const unsigned magazine_size;
+  const bool bypass_cache;
+
+  /*!
+   * \brief Finds the calling thread's magazine, creating (or adopting an orphaned) one on first use
+   *
+   * \return The calling thread's magazine
+   */
+  Magazine *magazine_get();
+
+  /*!
+   * \brief Moves up to magazine_size blocks from the shared allocator into the magazine
+   *
+   * \param magazine The magazine to refill
+   */
+  void magazine_refill(Magazine *magazine);
+
+  /*!
+   * \brief Moves blocks from the magazine back into the shared allocator
+   *
+   * \param magazine The magazine to flush
+   * \param count How many blocks to move
+   */
+  void magazine_flush(Magazine *magazine, unsigned count);
+
+  /*!
+   * \brief Called when a thread exits. Flushes the thread's magazine and leaves it for another thread to adopt.
+   *
+   * \param magazine The magazine of the exiting thread
+   */
+  void magazine_release(Magazine *magazine);
+};
+
+#endif
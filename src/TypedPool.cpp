@@ -0,0 +1,101 @@
+/**
+ * \file TypedPool.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Implementation for the pool resource shared by the standard allocator adapters
+ */
+
+#include "TypedPool.h"
+#include <algorithm>
+
+/*!
+ * \brief Creates an empty resource
+ *
+ * \param config The configuration of every allocator the resource creates (Alignment_ is raised as needed)
+ */
+PoolResource::PoolResource(const OAConfig &config) : config(config), pools() {}
+
+/*!
+ * \brief Takes a block from the allocator for the size and alignment. Throws an exception if the object can't be
+ * allocated. (Memory allocation problem)
+ *
+ * \param size The size of the object
+ * \param alignment The alignment of the object
+ * \return Pointer to the allocated block
+ */
+void *PoolResource::Allocate(size_t size, size_t alignment) { return GetAllocator(size, alignment)->Allocate(); }
+
+/*!
+ * \brief Returns a block to the allocator it came from. Throws an exception if the object can't be freed. (Invalid
+ * object)
+ *
+ * \param object Pointer to the block to deallocate
+ * \param size The size the object was allocated with
+ * \param alignment The alignment the object was allocated with
+ */
+void PoolResource::Free(void *object, size_t size, size_t alignment) { GetAllocator(size, alignment)->Free(object); }
+
+/*!
+ * \brief Finds the allocator for a size and alignment, creating it on first use. Throws an exception if it can't be
+ * created. (Memory allocation problem)
+ *
+ * \param size The size of the objects
+ * \param alignment The alignment of the objects
+ * \return The allocator, owned by the resource
+ */
+ObjectAllocator *PoolResource::GetAllocator(size_t size, size_t alignment) {
+  std::pair<size_t, size_t> key(BlockSize(size, alignment), alignment);
+
+  auto position = pools.find(key);
+  if (position != pools.end()) {
+    return position->second.get();
+  }
+
+  try {
+    std::unique_ptr<ObjectAllocator> allocator(
+        new ObjectAllocator(key.first, OALayout::aligned_config(config, alignment)));
+    return pools.emplace(key, std::move(allocator)).first->second.get();
+
+  } catch (const std::bad_alloc &) {
+    throw OAException(OAException::E_NO_MEMORY, "Bad allocation thrown while creating a pool.");
+  }
+}
+
+/*!
+ * \brief Getter for the statistics of every allocator added together
+ *
+ * \return The aggregated statistics, ObjectSize_ and PageSize_ are left at 0
+ */
+OAStats PoolResource::GetStats() const {
+  OAStats output;
+
+  for (const auto &pool : pools) {
+    OAStats stats = pool.second->GetStats();
+
+    output.FreeObjects_ += stats.FreeObjects_;
+    output.ObjectsInUse_ += stats.ObjectsInUse_;
+    output.PagesInUse_ += stats.PagesInUse_;
+    output.MostObjects_ += stats.MostObjects_;
+    output.Allocations_ += stats.Allocations_;
+    output.Deallocations_ += stats.Deallocations_;
+    output.SampledPages_ += stats.SampledPages_;
+    output.DebugChecks_ += stats.DebugChecks_;
+    output.DebugHits_ += stats.DebugHits_;
+  }
+
+  return output;
+}
+
+/*!
+ * \brief Returns the block size used for objects of a size and alignment, big enough for the free list link
+ *
+ * \param size The size of the object
+ * \param alignment The alignment of the object
+ * \return The size to create the ObjectAllocator with
+ */
+size_t PoolResource::BlockSize(size_t size, size_t alignment) {
+  size_t block_size = std::max(size, sizeof(GenericObject));
+  return (block_size + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,310 @@
+/**
+ * @file TypedPool.h
+ * @author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * @course CS280
+ * @term Spring 2025
+ *
+ * @brief Typed front ends over ObjectAllocator: an object pool and a standard allocator adapter
+ */
+
+//---------------------------------------------------------------------------
+#ifndef TYPEDPOOLH
+#define TYPEDPOOLH
+//---------------------------------------------------------------------------
+
+#include "OALayout.h"
+#include "ObjectAllocator.h"
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <utility>
+
+/*!
+  One ObjectAllocator per object size and alignment, created on first use. Backs every PoolAllocator that was built
+  from it, whatever type they were rebound to. Not thread safe, and it has to outlive every container using it.
+*/
+class PoolResource {
+public:
+  /*!
+   * \brief Creates an empty resource
+   *
+   * \param config The configuration of every allocator the resource creates (Alignment_ is raised as needed)
+   */
+  explicit PoolResource(const OAConfig &config = OAConfig(false, POOL_OBJECTS_PER_PAGE, 0));
+
+  /*!
+   * \brief Takes a block from the allocator for the size and alignment. Throws an exception if the object can't be
+   * allocated. (Memory allocation problem)
+   *
+   * \param size The size of the object
+   * \param alignment The alignment of the object
+   * \return Pointer to the allocated block
+   */
+  void *Allocate(size_t size, size_t alignment);
+
+  /*!
+   * \brief Returns a block to the allocator it came from. Throws an exception if the object can't be freed. (Invalid
+   * object)
+   *
+   * \param object Pointer to the block to deallocate
+   * \param size The size the object was allocated with
+   * \param alignment The alignment the object was allocated with
+   */
+  void Free(void *object, size_t size, size_t alignment);
+
+  /*!
+   * \brief Finds the allocator for a size and alignment, creating it on first use. Throws an exception if it can't be
+   * created. (Memory allocation problem)
+   *
+   * \param size The size of the objects
+   * \param alignment The alignment of the objects
+   * \return The allocator, owned by the resource
+   */
+  ObjectAllocator *GetAllocator(size_t size, size_t alignment);
+
+  /*!
+   * \brief Getter for the statistics of every allocator added together
+   *
+   * \return The aggregated statistics, ObjectSize_ and PageSize_ are left at 0
+   */
+  OAStats GetStats() const;
+
+  /*!
+   * \brief Returns the block size used for objects of a size and alignment, big enough for the free list link
+   *
+   * \param size The size of the object
+   * \param alignment The alignment of the object
+   * \return The size to create the ObjectAllocator with
+   */
+  static size_t BlockSize(size_t size, size_t alignment);
+
+  // Prevent copy construction and assignment
+  PoolResource(const PoolResource &other) = delete; //!< Do not implement!
+  PoolResource &operator=(const PoolResource &other) = delete; //!< Do not implement!
+
+private:
+  OAConfig config;
+  std::map<std::pair<size_t, size_t>, std::unique_ptr<ObjectAllocator>> pools; //!< Keyed by block size and alignment
+};
+
+/*!
+  Allocates T objects from a dedicated ObjectAllocator and constructs them in place. Not thread safe.
+*/
+template <typename T>
+class TypedPool {
+  static_assert(alignof(T) <= alignof(std::max_align_t), "Pages are only aligned to std::max_align_t");
+
+public:
+  /*!
+    Lets std::unique_ptr hand its object back to the pool
+  */
+  struct Deleter {
+    TypedPool *pool; //!< The pool the object came from
+
+    /*!
+     * \brief Destroys the object and returns it to the pool
+     *
+     * \param object The object to delete
+     */
+    void operator()(T *object) const { pool->Delete(object); }
+  };
+
+  typedef std::unique_ptr<T, Deleter> Pointer; //!< Owning pointer to a pooled object
+
+  /*!
+   * \brief Creates the pool. Throws an exception if the construction fails. (Memory allocation problem)
+   *
+   * \param config The configuration of the underlying allocator (Alignment_ is raised to suit T)
+   */
+  explicit TypedPool(const OAConfig &config = OAConfig(false, POOL_OBJECTS_PER_PAGE, 0)) :
+      allocator(PoolResource::BlockSize(sizeof(T), alignof(T)), OALayout::aligned_config(config, alignof(T))) {}
+
+  /*!
+   * \brief Allocates an object and constructs it from the arguments. Throws an exception if the object can't be
+   * allocated (Memory allocation problem), or whatever the constructor of T throws.
+   *
+   * \param args The arguments forwarded to the constructor of T
+   * \return The new object
+   */
+  template <typename... Args>
+  T *New(Args &&...args) {
+    void *memory = allocator.Allocate();
+
+    try {
+      return new (memory) T(std::forward<Args>(args)...);
+
+    } catch (...) {
+      allocator.Free(memory);
+      throw;
+    }
+  }
+
+  /*!
+   * \brief Same as New, but the object is owned by a std::unique_ptr that deletes it through the pool
+   *
+   * \param args The arguments forwarded to the constructor of T
+   * \return The owning pointer to the new object
+   */
+  template <typename... Args>
+  Pointer MakeUnique(Args &&...args) {
+    return Pointer(New(std::forward<Args>(args)...), Deleter{this});
+  }
+
+  /*!
+   * \brief Destroys an object and returns it to the pool, nullptr is ignored. Throws an exception if the object can't
+   * be freed. (Invalid object)
+   *
+   * \param object The object to delete
+   */
+  void Delete(T *object) {
+    if (object == nullptr) {
+      return;
+    }
+
+    object->~T();
+    allocator.Free(object);
+  }
+
+  /*!
+   * \brief Getter for the underlying allocator
+   *
+   * \return The allocator the objects come from
+   */
+  const ObjectAllocator &GetAllocator() const { return allocator; }
+
+  /*!
+   * \brief Getter for the statistics of the underlying allocator
+   *
+   * \return The statistics of the allocator
+   */
+  OAStats GetStats() const { return allocator.GetStats(); }
+
+  // Prevent copy construction and assignment
+  TypedPool(const TypedPool &other) = delete; //!< Do not implement!
+  TypedPool &operator=(const TypedPool &other) = delete; //!< Do not implement!
+
+private:
+  ObjectAllocator allocator;
+};
+
+/*!
+  Standard allocator drawing single objects (the nodes of std::list, std::map, std::unordered_map...) from a
+  PoolResource. Requests for more than one object, like bucket arrays, go to the global heap. Copies and rebinds share
+  the resource, so they compare equal and can free each other's memory.
+*/
+template <typename T>
+class PoolAllocator {
+  static_assert(alignof(T) <= alignof(std::max_align_t), "Pages are only aligned to std::max_align_t");
+
+public:
+  typedef T value_type; //!< The type being allocated
+
+  /*!
+   * \brief Creates an allocator drawing from the resource
+   *
+   * \param resource The resource, it has to outlive every container using the allocator
+   */
+  explicit PoolAllocator(PoolResource &resource) : resource(&resource), allocator(nullptr) {}
+
+  /*!
+   * \brief Rebinds an allocator of another type to the same resource
+   *
+   * \param other The allocator to rebind
+   */
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &other) : resource(other.GetResource()), allocator(nullptr) {}
+
+  /*!
+   * \brief Allocates storage for count objects. Throws std::bad_array_new_length if count is above max_size and
+   * std::bad_alloc if the storage can't be allocated, as containers expect of a standard allocator.
+   *
+   * \param count How many objects to allocate
+   * \return The uninitialized storage
+   */
+  T *allocate(size_t count) {
+    if (count > max_size()) {
+      throw std::bad_array_new_length();
+    }
+
+    if (count != 1) {
+      return static_cast<T *>(::operator new(count * sizeof(T)));
+    }
+
+    try {
+      // Every allocation of a given T goes to the same allocator, so the lookup is done once
+      if (allocator == nullptr) {
+        allocator = resource->GetAllocator(sizeof(T), alignof(T));
+      }
+
+      return static_cast<T *>(allocator->Allocate());
+
+    } catch (const OAException &) {
+      throw std::bad_alloc();
+    }
+  }
+
+  /*!
+   * \brief Releases storage obtained from allocate
+   *
+   * \param object The storage to release
+   * \param count How many objects it was allocated for
+   */
+  void deallocate(T *object, size_t count) {
+    if (count != 1) {
+      ::operator delete(object);
+      return;
+    }
+
+    if (allocator == nullptr) {
+      allocator = resource->GetAllocator(sizeof(T), alignof(T));
+    }
+
+    allocator->Free(object);
+  }
+
+  /*!
+   * \brief The largest count allocate accepts
+   *
+   * \return The most objects of type T whose total size fits in a size_t
+   */
+  size_t max_size() const { return std::numeric_limits<size_t>::max() / sizeof(T); }
+
+  /*!
+   * \brief Getter for the resource the allocator draws from
+   *
+   * \return The resource
+   */
+  PoolResource *GetResource() const { return resource; }
+
+private:
+  PoolResource *resource;
+  ObjectAllocator *allocator; //!< The resource's allocator for T, looked up on first use
+};
+
+/*!
+ * \brief Allocators are equal when they share a resource
+ *
+ * \param left The first allocator
+ * \param right The second allocator
+ * \return Whether the allocators can free each other's memory
+ */
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &left, const PoolAllocator<U> &right) {
+  return left.GetResource() == right.GetResource();
+}
+
+/*!
+ * \brief Allocators are equal when they share a resource
+ *
+ * \param left The first allocator
+ * \param right The second allocator
+ * \return Whether the allocators can't free each other's memory
+ */
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &left, const PoolAllocator<U> &right) {
+  return !(left == right);
+}
+
+#endif
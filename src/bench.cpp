@@ -0,0 +1,381 @@
+/**
+ * \file bench.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Microbenchmarks of the ObjectAllocator operations over the configuration space (header type, pad bytes,
+ * alignment, debug state and objects per page, plus the page and free list options on request), printed as CSV so
+ * builds can be compared
+ */
+
+#include "ObjectAllocator.h"
+#include "PageProvider.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  /*!
+    What a run measures, set from the command line
+  */
+  struct Options {
+    unsigned objects; //!< Objects allocated by each measurement
+    unsigned object_size; //!< Size of the objects
+    unsigned repeat; //!< Measurements per operation, the fastest one is kept
+    unsigned axes; //!< The optional axes swept, one bit per AXIS, the others stay at their defaults
+  };
+
+  /*!
+    The optional axes, each an OAConfig option left at its default unless asked for
+  */
+  enum AXIS {
+    axBitmap, //!< OccupancyBitmap_
+    axPolicy, //!< PagePolicy_
+    axAligned, //!< AlignedPages_
+    axLazy, //!< LazyPageFormat_
+    axSample, //!< DebugSampleRate_
+    axProvider, //!< PageProvider_
+    axConcurrent, //!< ConcurrentFreeList_
+    axCount //!< Number of optional axes
+  };
+
+  /*!
+    Where the pages of a point come from
+  */
+  enum PROVIDER {
+    prHeap, //!< No PageProvider_, the global heap
+    prMmap //!< MmapPageProvider
+  };
+
+  /*!
+    One point of the configuration space
+  */
+  struct Point {
+    OAConfig::HBLOCK_TYPE header; //!< HBlockInfo_ type
+    unsigned pad_bytes; //!< PadBytes_
+    unsigned alignment; //!< Alignment_
+    bool debug; //!< DebugOn_
+    unsigned objects_per_page; //!< ObjectsPerPage_
+    bool bitmap; //!< OccupancyBitmap_
+    OAConfig::PAGE_POLICY policy; //!< PagePolicy_
+    bool aligned; //!< AlignedPages_
+    bool lazy; //!< LazyPageFormat_
+    unsigned sample_rate; //!< DebugSampleRate_
+    PROVIDER provider; //!< PageProvider_
+    bool concurrent; //!< ConcurrentFreeList_
+  };
+
+  /*!
+    The fastest time of each operation at one point, in nanoseconds per operation
+  */
+  struct Timings {
+    double allocate; //!< Allocate on a fresh allocator, page growth included
+    double free; //!< Free of every object, in shuffled order
+    double pair; //!< Allocate immediately followed by Free, with every other object live
+    double free_empty_pages; //!< FreeEmptyPages once every object is freed, per page
+    double validate_pages; //!< ValidatePages with every object live, per object
+    double dump_memory_in_use; //!< DumpMemoryInUse with every object live, per object
+    unsigned pages; //!< Pages the objects took
+  };
+
+  const char *const HEADER_NAMES[] = {"none", "basic", "extended", "external"};
+  const char *const AXIS_NAMES[] = {"bitmap", "policy", "aligned", "lazy", "sample", "provider", "concurrent"};
+  const char *const POLICY_NAMES[] = {"global", "fullest"};
+  const char *const PROVIDER_NAMES[] = {"heap", "mmap"};
+  const char *const LABEL = "bench"; // External headers get a label, like most labeled callers
+  const unsigned EXTENDED_ADDITIONAL = 4; // User bytes of the extended headers
+
+  /*!
+   * \brief Does nothing with a block, for the sweeps
+   */
+  void ignore_block(const void *, size_t) {}
+
+  /*!
+   * \brief Returns the seconds elapsed since a point in time
+   *
+   * \param start The point in time
+   * \return The elapsed seconds
+   */
+  double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  /*!
+   * \brief Returns nanoseconds per operation
+   *
+   * \param seconds Time spent
+   * \param operations Operations done in that time
+   * \return The nanoseconds per operation, 0 without operations
+   */
+  double per_op(double seconds, size_t operations) {
+    return operations != 0 ? seconds * 1e9 / static_cast<double>(operations) : 0.0;
+  }
+
+  /*!
+   * \brief Builds the configuration of a point
+   *
+   * \param point The point
+   * \return The configuration, without a page limit
+   */
+  OAConfig point_config(const Point &point) {
+    static MmapPageProvider mmap_pages;
+
+    unsigned additional = point.header == OAConfig::hbExtended ? EXTENDED_ADDITIONAL : 0;
+    OAConfig config(false, point.objects_per_page, 0, point.debug, point.pad_bytes,
+                    OAConfig::HeaderBlockInfo(point.header, additional), point.alignment);
+
+    config.OccupancyBitmap_ = point.bitmap;
+    config.PagePolicy_ = point.policy;
+    config.AlignedPages_ = point.aligned;
+    config.LazyPageFormat_ = point.lazy;
+    config.DebugSampleRate_ = point.sample_rate;
+    config.PageProvider_ = point.provider == prMmap ? &mmap_pages : nullptr;
+    config.ConcurrentFreeList_ = point.concurrent;
+    return config;
+  }
+
+  /*!
+   * \brief Crosses every point with every value of one axis
+   *
+   * \param points The points, replaced by the crossed ones
+   * \param values The values of the axis
+   * \param assign Sets the axis of a point to a value
+   */
+  template <typename Value, typename Assign>
+  void points_cross(std::vector<Point> &points, const std::vector<Value> &values, Assign assign) {
+    std::vector<Point> crossed;
+
+    for (const Point &point : points) {
+      for (const Value &value : values) {
+        Point next = point;
+        assign(next, value);
+        crossed.push_back(next);
+      }
+    }
+
+    points.swap(crossed);
+  }
+
+  /*!
+   * \brief Parses a comma separated list of optional axis names
+   *
+   * \param list The list, "all" for every axis
+   * \param axes Receives one bit per AXIS named
+   * \return Whether every name is an axis
+   */
+  bool axes_parse(const std::string &list, unsigned &axes) {
+    std::istringstream names(list);
+    std::string name;
+    axes = 0;
+
+    while (std::getline(names, name, ',')) {
+      if (name == "all") {
+        axes = (1u << axCount) - 1;
+        continue;
+      }
+
+      auto found = std::find(std::begin(AXIS_NAMES), std::end(AXIS_NAMES), name);
+      if (found == std::end(AXIS_NAMES)) {
+        return false;
+      }
+
+      axes |= 1u << (found - std::begin(AXIS_NAMES));
+    }
+
+    return axes != 0;
+  }
+
+  /*!
+   * \brief Measures every operation once at one point
+   *
+   * \param point The point
+   * \param options The run options
+   * \param order The order the objects are freed in, a permutation of the object indices
+   * \return The timings
+   */
+  Timings point_measure(const Point &point, const Options &options, const std::vector<unsigned> &order) {
+    Timings timings = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0};
+    std::vector<void *> objects(options.objects, nullptr);
+
+    ObjectAllocator allocator(options.object_size, point_config(point));
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < options.objects; i++) {
+      objects[i] = allocator.Allocate(LABEL);
+    }
+    timings.allocate = per_op(seconds_since(start), options.objects);
+    timings.pages = allocator.GetStats().PagesInUse_;
+
+    start = std::chrono::steady_clock::now();
+    allocator.ValidatePages(ignore_block);
+    timings.validate_pages = per_op(seconds_since(start), options.objects);
+
+    start = std::chrono::steady_clock::now();
+    allocator.DumpMemoryInUse(ignore_block);
+    timings.dump_memory_in_use = per_op(seconds_since(start), options.objects);
+
+    // With every object live the free list stays short, the steady state of a busy allocator
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < options.objects; i++) {
+      allocator.Free(allocator.Allocate(LABEL));
+    }
+    timings.pair = per_op(seconds_since(start), options.objects);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned index : order) {
+      allocator.Free(objects[index]);
+    }
+    timings.free = per_op(seconds_since(start), options.objects);
+
+    start = std::chrono::steady_clock::now();
+    unsigned freed = allocator.FreeEmptyPages();
+    timings.free_empty_pages = per_op(seconds_since(start), freed);
+
+    return timings;
+  }
+
+  /*!
+   * \brief Prints one CSV row
+   *
+   * \param point The point measured
+   * \param operation The operation measured
+   * \param ns_per_op The fastest time
+   * \param operations The operations each measurement did
+   */
+  void print_row(const Point &point, const char *operation, double ns_per_op, unsigned operations) {
+    std::cout << HEADER_NAMES[point.header] << "," << point.pad_bytes << "," << point.alignment << ","
+              << (point.debug ? 1 : 0) << "," << point.objects_per_page << "," << (point.bitmap ? 1 : 0) << ","
+              << POLICY_NAMES[point.policy] << "," << (point.aligned ? 1 : 0) << "," << (point.lazy ? 1 : 0) << ","
+              << point.sample_rate << "," << PROVIDER_NAMES[point.provider] << "," << (point.concurrent ? 1 : 0) << ","
+              << operation << "," << ns_per_op << "," << operations << "\n";
+  }
+
+  /*!
+   * \brief Prints how to call the program
+   *
+   * \param program The name of the program
+   */
+  void print_usage(const char *program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --objects=N  objects allocated by each measurement (10000)\n"
+              << "  --size=N     object size (32)\n"
+              << "  --repeat=N   measurements per operation, the fastest is kept (3)\n"
+              << "  --axes=LIST  also sweep these options, comma separated or all (none):\n"
+              << "               bitmap, policy, aligned, lazy, sample, provider, concurrent\n";
+  }
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options = {10000, 32, 3, 0};
+
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    size_t equals = option.find('=');
+    std::string name = option.substr(0, equals);
+    std::string value = equals != std::string::npos ? option.substr(equals + 1) : std::string();
+    unsigned number = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+
+    if (name == "--objects" && number != 0) {
+      options.objects = number;
+    } else if (name == "--size" && number != 0) {
+      options.object_size = number;
+    } else if (name == "--repeat" && number != 0) {
+      options.repeat = number;
+    } else if (name == "--axes" && axes_parse(value, options.axes)) {
+      continue;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // The same shuffled order for every point, so the free patterns compare
+  std::vector<unsigned> order(options.objects);
+  uint32_t state = 2463534242u;
+  for (unsigned i = 0; i < options.objects; i++) {
+    order[i] = i;
+  }
+  for (unsigned i = options.objects - 1; i > 0; i--) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    std::swap(order[i], order[state % (i + 1)]);
+  }
+
+  // The optional axes only get their non default values when asked for, the full cross product is large
+  auto swept = [&options](AXIS axis) { return (options.axes & (1u << axis)) != 0; };
+
+  std::vector<Point> points(1, Point{OAConfig::hbNone, 0, 0, false, 0, false, OAConfig::ppGlobalFreeList, false, false,
+                                     1, prHeap, false});
+
+  points_cross(points, std::vector<OAConfig::HBLOCK_TYPE>{OAConfig::hbNone, OAConfig::hbBasic, OAConfig::hbExtended,
+                                                          OAConfig::hbExternal},
+               [](Point &point, OAConfig::HBLOCK_TYPE value) { point.header = value; });
+  points_cross(points, std::vector<unsigned>{0, 8}, [](Point &point, unsigned value) { point.pad_bytes = value; });
+  points_cross(points, std::vector<unsigned>{0, 64}, [](Point &point, unsigned value) { point.alignment = value; });
+  points_cross(points, std::vector<bool>{false, true}, [](Point &point, bool value) { point.debug = value; });
+  points_cross(points, std::vector<unsigned>{16, 256, 4096},
+               [](Point &point, unsigned value) { point.objects_per_page = value; });
+
+  if (swept(axBitmap)) {
+    points_cross(points, std::vector<bool>{false, true}, [](Point &point, bool value) { point.bitmap = value; });
+  }
+  if (swept(axPolicy)) {
+    points_cross(points, std::vector<OAConfig::PAGE_POLICY>{OAConfig::ppGlobalFreeList, OAConfig::ppFullestPageFirst},
+                 [](Point &point, OAConfig::PAGE_POLICY value) { point.policy = value; });
+  }
+  if (swept(axAligned)) {
+    points_cross(points, std::vector<bool>{false, true}, [](Point &point, bool value) { point.aligned = value; });
+  }
+  if (swept(axLazy)) {
+    points_cross(points, std::vector<bool>{false, true}, [](Point &point, bool value) { point.lazy = value; });
+  }
+  if (swept(axSample)) {
+    points_cross(points, std::vector<unsigned>{1, 8}, [](Point &point, unsigned value) { point.sample_rate = value; });
+  }
+  if (swept(axProvider)) {
+    points_cross(points, std::vector<PROVIDER>{prHeap, prMmap},
+                 [](Point &point, PROVIDER value) { point.provider = value; });
+  }
+  if (swept(axConcurrent)) {
+    points_cross(points, std::vector<bool>{false, true}, [](Point &point, bool value) { point.concurrent = value; });
+  }
+
+  std::cout << "# objects=" << options.objects << " size=" << options.object_size << " repeat=" << options.repeat
+#if defined(__VERSION__)
+            << " compiler=\"" << __VERSION__ << "\""
+#endif
+            << "\n"
+            << "header,pad_bytes,alignment,debug,objects_per_page,bitmap,policy,aligned,lazy,sample_rate,provider,"
+            << "concurrent,operation,ns_per_op,operations\n";
+
+  for (const Point &point : points) {
+    Timings best = point_measure(point, options, order);
+
+    for (unsigned run = 1; run < options.repeat; run++) {
+      Timings timings = point_measure(point, options, order);
+      best.allocate = std::min(best.allocate, timings.allocate);
+      best.free = std::min(best.free, timings.free);
+      best.pair = std::min(best.pair, timings.pair);
+      best.free_empty_pages = std::min(best.free_empty_pages, timings.free_empty_pages);
+      best.validate_pages = std::min(best.validate_pages, timings.validate_pages);
+      best.dump_memory_in_use = std::min(best.dump_memory_in_use, timings.dump_memory_in_use);
+    }
+
+    print_row(point, "allocate", best.allocate, options.objects);
+    print_row(point, "free", best.free, options.objects);
+    print_row(point, "allocate_free_pair", best.pair, options.objects);
+    print_row(point, "free_empty_pages", best.free_empty_pages, best.pages);
+    print_row(point, "validate_pages", best.validate_pages, options.objects);
+    print_row(point, "dump_memory_in_use", best.dump_memory_in_use, options.objects);
+  }
+
+  std::cout.flush();
+  return 0;
+}
@@ -13,8 +13,17 @@ int SHOWREAL = 0; // DumpPages, DumpPagesEx
 int SHOW_EXCEPTIONS = 0; // Show student exceptions in all tests
 int EXTRA_CREDIT = 1; // Run extra credit tests (Alignment, FreeEmptyPages)
 
+#include "AllocationTrace.h"
+#include "HeaderPool.h"
 #include "ObjectAllocator.h"
+#include "OAPattern.h"
+#include "ObjectAllocatorT.h"
 #include "PRNG.h"
+#include "PageProvider.h"
+#include "ShardedObjectAllocator.h"
+#include "SizeClassAllocator.h"
+#include "ThreadCachedAllocator.h"
+#include "TypedPool.h"
 
 struct Student {
   int Age;
@@ -55,6 +64,29 @@ void TestFreeEmptyPages2(void);
 void TestFreeEmptyPages3(void);
 void StressFreeChecking(void);
 void Stress(bool UseNewDelete);
+void StressConcurrent(unsigned threads);
+void StressRemoteFree(unsigned threads);
+void TestStaticAllocator();
+void TestTypedPool();
+void TestSizeClasses();
+void TestPageProviders();
+void TestAlignedPages();
+void TestLazyPages();
+void TestPatternKernels();
+void TestSampledDebug();
+void TestParallelSweeps();
+void TestScrubber();
+void TestHeaderPool();
+void TestLabelStats();
+void TestStatsSnapshots();
+void TestFlightRecorder();
+void TestAllocationTrace();
+void TestShardedAllocator();
+void TestBatches();
+void TestThreadCache();
+void TestOccupancyBitmap();
+void TestFullestPageFirst();
+void TestRemoteDoubleFree();
 
 struct Person {
   char lastName[12];
@@ -201,6 +233,1228 @@ void Stress(bool UseNewDelete) {
   }
 }
 
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+void StressConcurrent(unsigned threads) {
+  ObjectAllocator *oa;
+
+  try {
+    bool newdel = false;
+    bool debug = true;
+    unsigned padbytes = 4;
+    OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+    unsigned alignment = 0;
+
+    OAConfig config(newdel, 256, 0, debug, padbytes, header, alignment);
+    config.ConcurrentFreeList_ = true;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during construction in StressConcurrent." << endl;
+
+    return;
+  }
+
+  const unsigned per_thread = 2000;
+  const unsigned rounds = 20;
+  std::vector<std::thread> workers;
+  std::vector<int> failed(threads, 0);
+
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([oa, t, &failed]() {
+      std::vector<void *> mine(per_thread);
+
+      try {
+        for (unsigned round = 0; round < rounds; round++) {
+          for (unsigned i = 0; i < per_thread; i++) {
+            mine[i] = oa->Allocate();
+            static_cast<Student *>(mine[i])->ID = t;
+          }
+
+          // Free in a different order than allocated so blocks interleave between threads
+          for (unsigned i = 0; i < per_thread; i++) {
+            void *p = mine[(i * 7 + round) % per_thread];
+            if (static_cast<Student *>(p)->ID != static_cast<long long>(t)) failed[t] = 1;
+            oa->Free(p);
+          }
+        }
+      } catch (const OAException &e) {
+        if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+        failed[t] = 1;
+      }
+    });
+  }
+
+  for (unsigned t = 0; t < threads; t++) workers[t].join();
+
+  bool ok = true;
+  for (unsigned t = 0; t < threads; t++)
+    if (failed[t]) ok = false;
+
+  if (!ok) cout << "Exception or overlapping blocks during StressConcurrent." << endl;
+
+  OAStats stats = oa->GetStats();
+  cout << "Threads: " << threads;
+  cout << ", Objects in use: " << stats.ObjectsInUse_;
+  cout << ", Allocs: " << stats.Allocations_;
+  cout << ", Frees: " << stats.Deallocations_ << endl;
+  cout << "Leaks: " << oa->DumpMemoryInUse(DumpCallback2) << ", Corrupted: " << oa->ValidatePages(DumpCallback2)
+       << endl;
+
+  delete oa;
+}
+
+void StressRemoteFree(unsigned threads) {
+  ObjectAllocator *oa;
+
+  try {
+    bool newdel = false;
+    bool debug = true;
+    unsigned padbytes = 4;
+    OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+    unsigned alignment = 0;
+
+    OAConfig config(newdel, 256, 0, debug, padbytes, header, alignment);
+    config.RemoteFreeQueue_ = true;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during construction in StressRemoteFree." << endl;
+
+    return;
+  }
+
+  const unsigned per_thread = 40000;
+  const unsigned window = 256; // Blocks a consumer may have in flight, the owner waits for it past that
+  std::vector<void *> produced(threads * per_thread);
+  std::unique_ptr<std::atomic<unsigned>[]> published(new std::atomic<unsigned>[threads]);
+  std::unique_ptr<std::atomic<unsigned>[]> consumed(new std::atomic<unsigned>[threads]);
+  std::vector<int> failed(threads, 0);
+  std::vector<std::thread> workers;
+  std::atomic<bool> stopped(false);
+  bool ok = true;
+
+  for (unsigned t = 0; t < threads; t++) {
+    published[t].store(0);
+    consumed[t].store(0);
+  }
+
+  // The consumers free while this thread, the owner, keeps allocating, so its allocations are what drain their
+  // frees back into the free list
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([oa, t, &produced, &published, &consumed, &failed, &stopped]() {
+      try {
+        for (unsigned i = 0; i < per_thread; i++) {
+          while (published[t].load(std::memory_order_acquire) <= i) {
+            if (stopped.load()) return;
+            std::this_thread::yield();
+          }
+
+          void *block = produced[t * per_thread + i];
+          if (static_cast<Student *>(block)->ID != static_cast<long long>(t)) failed[t] = 1;
+          oa->Free(block);
+          consumed[t].store(i + 1, std::memory_order_release);
+        }
+      } catch (const OAException &e) {
+        if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+        failed[t] = 1;
+        consumed[t].store(per_thread, std::memory_order_release);
+      }
+    });
+  }
+
+  try {
+    for (unsigned i = 0; i < per_thread; i++) {
+      for (unsigned t = 0; t < threads; t++) {
+        while (i >= window && consumed[t].load(std::memory_order_acquire) <= i - window) std::this_thread::yield();
+
+        void *block = oa->Allocate();
+        static_cast<Student *>(block)->ID = t;
+        produced[t * per_thread + i] = block;
+        published[t].store(i + 1, std::memory_order_release);
+      }
+    }
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    ok = false;
+    stopped.store(true);
+  }
+
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t].join();
+    if (failed[t]) ok = false;
+  }
+
+  try {
+    oa->DrainRemoteFrees();
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    ok = false;
+  }
+
+  if (!ok) cout << "Exception or overlapping blocks during StressRemoteFree." << endl;
+
+  // A page is only added when nothing is free or queued, so every block was in flight then
+  OAStats stats = oa->GetStats();
+  cout << "Threads: " << threads;
+  cout << ", Objects in use: " << stats.ObjectsInUse_;
+  cout << ", Allocs: " << stats.Allocations_;
+  cout << ", Frees: " << stats.Deallocations_ << endl;
+  cout << "Pages within the in-flight bound: "
+       << (stats.PagesInUse_ <= (threads * window + 255) / 256 + 1 ? "yes" : "no") << endl;
+  cout << "Leaks: " << oa->DumpMemoryInUse(DumpCallback2) << ", Corrupted: " << oa->ValidatePages(DumpCallback2)
+       << endl;
+
+  delete oa;
+}
+
+void TestStaticAllocator() {
+  typedef OAStaticConfig<4, 0, true, 2, OAConfig::hbExtended, 3, 8> StaticConfig;
+  typedef ObjectAllocatorT<sizeof(Student), StaticConfig> StaticAllocator;
+
+  ObjectAllocator *oa;
+  StaticAllocator *ta;
+
+  // Where the pages come from makes no difference to what is in them
+  MmapPageProvider mapped;
+
+  try {
+    StaticAllocator reference;
+    oa = new ObjectAllocator(sizeof(Student), reference.GetConfig());
+    ta = new StaticAllocator(&mapped);
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown during construction in TestStaticAllocator." << endl;
+
+    return;
+  }
+
+  const unsigned total = 32;
+  void *pa[total];
+  void *pt[total];
+
+  // The same requests on both, ending with every block in use so no free list link is left in the pages
+  for (unsigned i = 0; i < total; i++) {
+    pa[i] = oa->Allocate();
+    pt[i] = ta->Allocate();
+  }
+
+  for (unsigned i = 0; i < total; i += 3) {
+    oa->Free(pa[i]);
+    ta->Free(pt[i]);
+  }
+
+  for (unsigned i = 0; i < total; i += 3) {
+    pa[i] = oa->Allocate();
+    pt[i] = ta->Allocate();
+  }
+
+  OAStats sa = oa->GetStats();
+  OAStats st = ta->GetStats();
+  cout << "Page size: " << sa.PageSize_ << " / " << st.PageSize_;
+  cout << ", Pages: " << sa.PagesInUse_ << " / " << st.PagesInUse_;
+  cout << ", Allocs: " << sa.Allocations_ << " / " << st.Allocations_;
+  cout << ", Most: " << sa.MostObjects_ << " / " << st.MostObjects_ << endl;
+
+  // Everything past each page's next pointer has to be byte for byte the same
+  bool same = sa.PageSize_ == st.PageSize_;
+  const GenericObject *page_a = static_cast<const GenericObject *>(oa->GetPageList());
+  const GenericObject *page_t = static_cast<const GenericObject *>(ta->GetPageList());
+
+  while (same && page_a != nullptr && page_t != nullptr) {
+    same = memcmp(page_a + 1, page_t + 1, sa.PageSize_ - sizeof(void *)) == 0;
+    page_a = page_a->Next;
+    page_t = page_t->Next;
+  }
+  same = same && page_a == nullptr && page_t == nullptr;
+  cout << "Pages match: " << (same ? "yes" : "no") << endl;
+
+  try {
+    ta->Free(pt[0]);
+    ta->Free(pt[0]);
+  } catch (const OAException &e) {
+    cout << "Double free: " << (e.code() == OAException::E_MULTIPLE_FREE ? "detected" : "wrong code") << endl;
+  }
+
+  for (unsigned i = 1; i < total; i++) {
+    oa->Free(pa[i]);
+    ta->Free(pt[i]);
+  }
+  oa->Free(pa[0]);
+
+  cout << "Pages freed: " << oa->FreeEmptyPages() << " / " << ta->FreeEmptyPages() << endl;
+
+  delete oa;
+  delete ta;
+}
+
+void TestTypedPool() {
+  typedef std::map<long long, Student, std::less<long long>, PoolAllocator<std::pair<const long long, Student>>>
+      StudentMap;
+
+  try {
+    TypedPool<Student> pool(OAConfig(false, 8, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbBasic)));
+
+    Student *student = pool.New(Student{20, 3.5f, 2025, 1});
+    {
+      TypedPool<Student>::Pointer owned = pool.MakeUnique(Student{21, 3.0f, 2024, 2});
+      cout << "Student " << owned->ID << " in use: " << pool.GetStats().ObjectsInUse_ << endl;
+    }
+    cout << "Student " << student->ID << " in use: " << pool.GetStats().ObjectsInUse_ << endl;
+    pool.Delete(student);
+    cout << "Pool objects in use: " << pool.GetStats().ObjectsInUse_ << endl;
+
+    PoolResource resource(OAConfig(false, 64, 0));
+    {
+      StudentMap students{PoolAllocator<StudentMap::value_type>(resource)};
+      for (long long i = 0; i < 100; i++) students[i] = Student{18, 2.0f, 2023, i};
+
+      OAStats stats = resource.GetStats();
+      cout << "Map nodes in use: " << stats.ObjectsInUse_ << ", Pages: " << stats.PagesInUse_ << endl;
+    }
+    cout << "Map nodes in use after clear: " << resource.GetStats().ObjectsInUse_ << endl;
+
+    // Failures reach the container as the standard exceptions, and leave it as it was
+    PoolResource small(OAConfig(false, 4, 1));
+    StudentMap students{PoolAllocator<StudentMap::value_type>(small)};
+    try {
+      for (long long i = 0; i < 5; i++) students[i] = Student{18, 2.0f, 2023, i};
+    } catch (const std::bad_alloc &) {
+      cout << "Out of pages: bad_alloc, " << students.size() << " students kept" << endl;
+    }
+
+    PoolAllocator<Student> students_allocator(small);
+    try {
+      students_allocator.allocate(students_allocator.max_size() + 1);
+    } catch (const std::bad_array_new_length &) {
+      cout << "Past max_size: bad_array_new_length" << endl;
+    }
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestTypedPool." << endl;
+  }
+}
+
+void TestSizeClasses() {
+  try {
+    SizeClassAllocator sca;
+    const size_t sizes[] = {0, 1, 8, 9, 33, 100, 200, 1000, 1024, 1025, 4096};
+    void *blocks[sizeof(sizes) / sizeof(*sizes)];
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+      blocks[i] = sca.Allocate(sizes[i]);
+      memset(blocks[i], 0xAB, sizes[i]);
+      cout << "Size " << sizes[i] << " -> " << sca.GetAllocationSize(blocks[i]) << endl;
+    }
+
+    OAStats stats = sca.GetStats();
+    cout << "Objects in use: " << stats.ObjectsInUse_ << ", Pages: " << stats.PagesInUse_ << endl;
+
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) sca.Free(blocks[i]);
+
+    cout << "Objects in use after free: " << sca.GetStats().ObjectsInUse_ << endl;
+    cout << "Pages freed: " << sca.FreeEmptyPages() << endl;
+
+    char local;
+    sca.Free(&local);
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestSizeClasses." << endl;
+  }
+}
+
+void TestPageProviders() {
+  HeapPageProvider heap;
+  MmapPageProvider mapped;
+  HugePageProvider huge;
+  LockedPageProvider locked;
+
+  const char *names[] = {"heap", "mmap", "huge", "mlock"};
+  PageProvider *providers[] = {&heap, &mapped, &huge, &locked};
+
+  for (unsigned i = 0; i < sizeof(providers) / sizeof(*providers); i++) {
+    try {
+      OAConfig config(false, 1024, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+      config.PageProvider_ = providers[i];
+      ObjectAllocator oa(sizeof(Student), config);
+
+      std::vector<void *> blocks;
+      for (unsigned j = 0; j < 3000; j++) blocks.push_back(oa.Allocate());
+
+      for (void *block : blocks) oa.Free(block);
+
+      cout << names[i] << ": pages " << oa.GetStats().PagesInUse_ << ", corrupted " << oa.ValidatePages(DumpCallback2);
+      cout << ", freed " << oa.FreeEmptyPages() << endl;
+    } catch (const OAException &e) {
+      if (SHOW_EXCEPTIONS)
+        cout << names[i] << ": " << e.what() << endl;
+      else
+        cout << "Exception thrown in TestPageProviders." << endl;
+    }
+  }
+}
+
+void TestAlignedPages() {
+  OAConfig config(false, 100, 0, true, 4, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+  config.AlignedPages_ = true;
+  ObjectAllocator oa(sizeof(Student), config);
+
+  std::vector<char *> blocks;
+  for (unsigned i = 0; i < 500; i++) blocks.push_back(static_cast<char *>(oa.Allocate()));
+
+  size_t alignment = 1;
+  while (alignment < oa.GetStats().PageSize_) alignment <<= 1;
+
+  bool aligned = true;
+  const GenericObject *page = static_cast<const GenericObject *>(oa.GetPageList());
+  for (; page != nullptr; page = page->Next)
+    aligned = aligned && reinterpret_cast<uintptr_t>(page) % alignment == 0;
+  cout << "Pages: " << oa.GetStats().PagesInUse_ << ", aligned: " << (aligned ? "yes" : "no") << endl;
+
+  char *bad_pointers[] = {blocks[7] + 1, blocks[0] + alignment, blocks[3]};
+  for (unsigned i = 0; i < 2; i++) oa.Free(blocks[3 + i * 100]);
+  for (char *pointer : bad_pointers) {
+    try {
+      oa.Free(pointer);
+    } catch (const OAException &e) {
+      cout << "Exception code: " << e.code() << endl;
+    }
+  }
+
+  for (unsigned i = 0; i < blocks.size(); i++)
+    if (i != 3 && i != 103) oa.Free(blocks[i]);
+  cout << "Objects in use: " << oa.GetStats().ObjectsInUse_ << ", pages freed: " << oa.FreeEmptyPages() << endl;
+}
+
+void TestLazyPages() {
+  OAConfig config(false, 8, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbExtended, 2), 8);
+  ObjectAllocator eager(sizeof(Student), config);
+  config.LazyPageFormat_ = true;
+  ObjectAllocator lazy(sizeof(Student), config);
+
+  // Blocks have to come out at the same page offsets in the same order
+  bool same_order = true;
+  char *eager_blocks[20];
+  char *lazy_blocks[20];
+  for (unsigned i = 0; i < 20; i++) {
+    eager_blocks[i] = static_cast<char *>(eager.Allocate());
+    lazy_blocks[i] = static_cast<char *>(lazy.Allocate());
+
+    if (i % 3 == 1) {
+      eager.Free(eager_blocks[i - 1]);
+      lazy.Free(lazy_blocks[i - 1]);
+    }
+
+    const char *eager_page = static_cast<const char *>(eager.GetPageList());
+    const char *lazy_page = static_cast<const char *>(lazy.GetPageList());
+    same_order = same_order && eager_blocks[i] - eager_page == lazy_blocks[i] - lazy_page;
+  }
+
+  OAStats stats = lazy.GetStats();
+  cout << "Same order: " << (same_order ? "yes" : "no") << ", pages: " << stats.PagesInUse_
+       << ", free objects: " << stats.FreeObjects_ << " (eager " << eager.GetStats().FreeObjects_ << ")" << endl;
+  cout << "Leaks: " << lazy.DumpMemoryInUse(DumpCallback2) << ", Corrupted: " << lazy.ValidatePages(DumpCallback2)
+       << endl;
+
+  try {
+    // Blocks are carved last first, so the one right before the first block handed out was never formatted
+    ObjectAllocator fresh(sizeof(Student), config);
+    char *first = static_cast<char *>(fresh.Allocate());
+    char *second = static_cast<char *>(fresh.Allocate());
+    fresh.Free(second - (first - second));
+  } catch (const OAException &e) {
+    cout << "Exception code: " << e.code() << endl;
+  }
+}
+
+void TestPatternKernels() {
+  unsigned char run[200];
+  const OAPattern::KERNEL kernels[] = {OAPattern::pkScalar, OAPattern::pkSSE2, OAPattern::pkAVX2};
+
+  // Every kernel has to agree, a corrupted byte anywhere in the run (or none) is reported the same way
+  unsigned disagreements = 0;
+  for (size_t length = 0; length < 100; length++) {
+    for (size_t corrupted = 0; corrupted <= length; corrupted++) {
+      memset(run, ObjectAllocator::PAD_PATTERN, sizeof(run));
+      run[corrupted] = ObjectAllocator::FREED_PATTERN;
+
+      bool expected = corrupted == length;
+      for (OAPattern::KERNEL kernel : kernels)
+        if (OAPattern::matches(kernel, run, ObjectAllocator::PAD_PATTERN, length) != expected) disagreements++;
+    }
+  }
+  cout << "Disagreements: " << disagreements << endl;
+
+  OAConfig config(false, 64, 0, true, 64, OAConfig::HeaderBlockInfo(OAConfig::hbNone));
+  ObjectAllocator oa(sizeof(Student), config);
+  char *blocks[64];
+  for (unsigned i = 0; i < 64; i++) blocks[i] = static_cast<char *>(oa.Allocate());
+
+  blocks[3][sizeof(Student)] = 0; // first byte of the right pad, shared run with the next left pad
+  blocks[10][-64] = 0; // first byte of the left pad
+  blocks[20][sizeof(Student) + 63] = 0; // last byte of the right pad
+  cout << "Corrupted: " << oa.ValidatePages(DumpCallback2) << endl;
+}
+
+void TestSampledDebug() {
+  for (unsigned rate : {1u, 4u}) {
+    OAConfig config(false, 8, 0, true, 4, OAConfig::HeaderBlockInfo(OAConfig::hbNone));
+    config.DebugSampleRate_ = rate;
+    ObjectAllocator oa(sizeof(Student), config);
+
+    std::vector<char *> blocks;
+    for (unsigned i = 0; i < 512; i++) blocks.push_back(static_cast<char *>(oa.Allocate()));
+
+    // Every block overruns by one byte, only the sampled pages can notice
+    for (char *block : blocks) block[sizeof(Student)] = 0;
+    unsigned corrupted = oa.ValidatePages(DumpCallback2);
+
+    unsigned thrown = 0;
+    for (char *block : blocks) {
+      try {
+        oa.Free(block);
+      } catch (const OAException &) {
+        thrown++;
+      }
+    }
+
+    OAStats stats = oa.GetStats();
+    cout << "Rate 1/" << rate << ": sampled pages " << stats.SampledPages_ << " of " << stats.PagesInUse_
+         << ", corrupted " << corrupted << ", checks " << stats.DebugChecks_ << ", hits " << stats.DebugHits_
+         << ", thrown " << thrown << endl;
+  }
+
+  // Without DebugOn_ no page gets the checks, whatever the sample picked
+  OAConfig config(false, 8, 0, false, 4, OAConfig::HeaderBlockInfo(OAConfig::hbNone));
+  config.DebugSampleRate_ = 4;
+  ObjectAllocator oa(sizeof(Student), config);
+  for (unsigned i = 0; i < 512; i++) oa.Allocate();
+
+  OAStats before = oa.GetStats();
+  oa.SetDebugState(true);
+  OAStats after = oa.GetStats();
+  cout << "Debug off: sampled pages " << before.SampledPages_ << " of " << before.PagesInUse_
+       << ", turned on: " << (after.SampledPages_ > 0 && after.SampledPages_ < after.PagesInUse_ ? "some" : "wrong")
+       << endl;
+}
+
+std::vector<const void *> swept_blocks;
+
+void SweepCallback(const void *block, size_t) { swept_blocks.push_back(block); }
+
+void TestParallelSweeps() {
+  OAConfig config(false, 16, 0, true, 4, OAConfig::HeaderBlockInfo(OAConfig::hbNone));
+  ObjectAllocator oa(sizeof(Student), config);
+
+  std::vector<char *> blocks;
+  for (unsigned i = 0; i < 400; i++) blocks.push_back(static_cast<char *>(oa.Allocate()));
+  for (unsigned i = 0; i < blocks.size(); i += 3) oa.Free(blocks[i]);
+  for (unsigned i = 1; i < blocks.size(); i += 9) blocks[i][-1] = 0;
+
+  // The parallel sweeps have to report the same blocks in the same order as the serial ones
+  swept_blocks.clear();
+  unsigned in_use = oa.DumpMemoryInUse(SweepCallback);
+  std::vector<const void *> serial = swept_blocks;
+  for (unsigned threads : {1u, 2u, 7u, 64u}) {
+    swept_blocks.clear();
+    unsigned count = oa.DumpMemoryInUseParallel(SweepCallback, threads);
+    cout << "Dump with " << threads << " threads: " << count << " of " << in_use
+         << (swept_blocks == serial ? ", same order" : ", different order") << endl;
+  }
+
+  swept_blocks.clear();
+  unsigned corrupted = oa.ValidatePages(SweepCallback);
+  serial = swept_blocks;
+  for (unsigned threads : {1u, 2u, 7u, 64u}) {
+    swept_blocks.clear();
+    unsigned count = oa.ValidatePagesParallel(SweepCallback, threads);
+    cout << "Validate with " << threads << " threads: " << count << " of " << corrupted
+         << (swept_blocks == serial ? ", same order" : ", different order") << endl;
+  }
+}
+
+void TestScrubber() {
+  OAConfig config(false, 10, 0, true, 4, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+  ObjectAllocator oa(sizeof(Student), config);
+
+  std::vector<char *> blocks;
+  for (unsigned i = 0; i < 50; i++) blocks.push_back(static_cast<char *>(oa.Allocate()));
+  for (unsigned i = 0; i < blocks.size(); i += 4) oa.Free(blocks[i]);
+
+  blocks[8][sizeof(Student) - 1] = 0; // written after being freed
+  blocks[21][-1] = 0; // left pad
+
+  // 5 pages of 10 blocks, 12 blocks per step
+  for (unsigned step = 0; step < 6; step++) {
+    unsigned corrupted = oa.ScrubPages(DumpCallback2, 12);
+    cout << "Step " << step << ": corrupted " << corrupted << ", passes " << oa.GetStats().ScrubPasses_ << endl;
+  }
+
+  try {
+    oa.Free(blocks[21]);
+  } catch (const OAException &e) {
+    cout << "Exception code: " << e.code() << endl;
+  }
+}
+
+void TestHeaderPool() {
+  HeaderPool pool(4);
+  std::string long_label(300, 'x');
+
+  MemBlockInfo *first = pool.Allocate("first", 1);
+  MemBlockInfo *second = pool.Allocate(long_label.c_str(), 2);
+  MemBlockInfo *third = pool.Allocate(nullptr, 3);
+  cout << first->label << " " << strlen(second->label) << " " << (third->label == nullptr ? "null" : third->label)
+       << ", capacity " << pool.GetCapacity() << endl;
+
+  // A freed record is the next one handed out, and the label was interned by the first header
+  char first_copy[] = "first";
+  char *first_label = first->label;
+  pool.Free(first);
+  MemBlockInfo *fourth = pool.Allocate(first_copy, 4);
+  cout << fourth->label << " " << fourth->alloc_num << ", same record " << (fourth == first ? "yes" : "no")
+       << ", same label storage " << (fourth->label == first_label ? "yes" : "no") << endl;
+
+  for (unsigned i = 0; i < 6; i++) pool.Allocate("more", 5 + i);
+  cout << "Capacity " << pool.GetCapacity() << endl;
+
+  pool.Free(second);
+  pool.Free(third);
+  pool.Free(fourth);
+
+  // Through the allocator, every header is returned to the pool by Free or the destructor
+  OAConfig config(false, 4, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
+  ObjectAllocator oa(sizeof(Student), config);
+  void *blocks[10];
+  for (unsigned i = 0; i < 10; i++) blocks[i] = oa.Allocate(i % 2 ? "odd" : long_label.c_str());
+  for (unsigned i = 0; i < 10; i += 2) oa.Free(blocks[i]);
+  cout << "Leaks: " << oa.DumpMemoryInUse(DumpCallback2) << endl;
+}
+
+void TestLabelStats() {
+  OAConfig config(false, 8, 0, false, 0, OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
+  ObjectAllocator oa(sizeof(Student), config);
+  const char *subsystems[] = {"render", "audio", "physics"};
+
+  std::vector<void *> blocks;
+  for (unsigned i = 0; i < 60; i++) {
+    std::string label = subsystems[i % 3]; // a new copy every time, interned by contents
+    blocks.push_back(oa.Allocate(i % 10 == 9 ? nullptr : label.c_str()));
+  }
+  for (unsigned i = 0; i < blocks.size(); i += 4) oa.Free(blocks[i]);
+
+  for (const LabelStats &stats : oa.GetLabelStats()) {
+    cout << (stats.Label_ != nullptr ? stats.Label_ : "(none)") << ": " << stats.LiveObjects_ << " objects, "
+         << stats.LiveBytes_ << " bytes, " << stats.Allocations_ << " allocations" << endl;
+  }
+}
+
+void TestStatsSnapshots() {
+  OAConfig config(false, 64, 0, false, 0, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+  ObjectAllocator oa(sizeof(Student), config);
+
+  std::vector<void *> blocks;
+  for (unsigned i = 0; i < 100; i++) blocks.push_back(oa.Allocate());
+  OAStats before = oa.GetStats();
+  for (unsigned i = 0; i < 40; i++) oa.Free(blocks[i]);
+  for (unsigned i = 0; i < 10; i++) blocks[i] = oa.Allocate();
+
+  OAStats delta = oa.GetStats().Since(before);
+  cout << "Delta: " << delta.Allocations_ << " allocations, " << delta.Deallocations_ << " deallocations, "
+       << delta.ObjectsInUse_ << " in use" << endl;
+
+  config.ConcurrentFreeList_ = true;
+  ObjectAllocator shared(sizeof(Student), config);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < 4; t++) {
+    workers.push_back(std::thread([&shared]() {
+      std::vector<void *> mine;
+      for (unsigned round = 0; round < 10; round++) {
+        for (unsigned i = 0; i < 50; i++) mine.push_back(shared.Allocate());
+        for (unsigned i = 0; i < 30; i++) {
+          shared.Free(mine.back());
+          mine.pop_back();
+        }
+      }
+    }));
+  }
+  for (std::thread &worker : workers) worker.join();
+
+  OAStats totals = shared.GetStats();
+  cout << "Concurrent: " << totals.Allocations_ << " allocations, " << totals.Deallocations_ << " deallocations, "
+       << totals.ObjectsInUse_ << " in use" << endl;
+}
+
+const void *flight_block = nullptr;
+
+void FlightCallback(const FlightEvent *events, unsigned count) {
+  const char *names[] = {"allocate", "free", "page allocate", "page free"};
+
+  cout << "Flight recorder, last " << count << " events:" << endl;
+  for (unsigned i = 0; i < count; i++) {
+    cout << "  " << names[events[i].Type_] << " #" << events[i].AllocNum_
+         << (events[i].Address_ == flight_block ? " (the block)" : "")
+         << (events[i].Thread_ == events[0].Thread_ ? "" : " (other thread)") << endl;
+  }
+}
+
+void TestFlightRecorder() {
+  OAConfig config(false, 4, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+  config.FlightRecorder_ = 12;
+  config.FlightRecorderDump_ = FlightCallback;
+  ObjectAllocator oa(sizeof(Student), config);
+
+  std::vector<void *> blocks;
+  for (unsigned i = 0; i < 6; i++) blocks.push_back(oa.Allocate());
+  flight_block = blocks[2];
+  oa.Free(blocks[2]);
+  oa.Free(blocks[4]);
+
+  try {
+    oa.Free(blocks[2]);
+  } catch (const OAException &e) {
+    cout << "Exception " << e.code() << ": " << e.what() << endl;
+  }
+
+  std::vector<FlightEvent> events = oa.GetRecentEvents();
+  bool ordered = true;
+  for (size_t i = 1; i < events.size(); i++) ordered = ordered && events[i - 1].Timestamp_ <= events[i].Timestamp_;
+  cout << "Recorded " << events.size() << " events, " << (ordered ? "in order" : "out of order") << endl;
+}
+
+void TestAllocationTrace() {
+  const char *path = "driver_trace.oat";
+
+  {
+    TraceWriter writer(path, sizeof(Student));
+    OAConfig config(false, 8, 0, true, 0, OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
+    config.TraceWriter_ = &writer;
+    ObjectAllocator oa(sizeof(Student), config);
+
+    std::vector<void *> blocks;
+    for (unsigned i = 0; i < 10; i++) blocks.push_back(oa.Allocate(i % 2 ? "odd" : "even"));
+    for (unsigned i = 0; i < 10; i += 3) oa.Free(blocks[i]);
+    void *batch[4];
+    oa.AllocateBatch(4, batch, "batch");
+    oa.FreeBatch(batch, 4);
+
+    // A free the allocator rejects leaves no record
+    try {
+      oa.Free(blocks[0]);
+    } catch (const OAException &e) {
+      cout << "Second free: " << (e.code() == OAException::E_MULTIPLE_FREE ? "multiple free" : "wrong code") << endl;
+    }
+
+    writer.Flush();
+    cout << "Recorded " << writer.GetRecords() << " records, " << (writer.Good() ? "good" : "bad") << endl;
+  }
+
+  TraceReader reader(path);
+  AllocationTrace::Record record;
+  cout << "Object size " << reader.GetObjectSize() << ":";
+  while (reader.Next(record)) {
+    const char *label = reader.GetLabel(record.Label_);
+    cout << " " << (record.Type_ == AllocationTrace::trAllocate ? "+" : "-") << record.Object_
+         << (label != nullptr ? label : "");
+  }
+  cout << endl << "Trace " << (reader.Good() ? "well formed" : "malformed") << endl;
+
+  std::remove(path);
+}
+
+void TestShardedAllocator() {
+  const unsigned shards = 4;
+  const unsigned per_thread = 1000;
+
+  try {
+    OAConfig config(false, 32, 0, true, 4, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+    ShardedObjectAllocator sa(sizeof(Student), config, shards);
+    std::vector<void *> blocks(shards * per_thread);
+    std::vector<int> failed(shards, 0);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < shards; t++) {
+      workers.emplace_back([&sa, &blocks, &failed, t]() {
+        try {
+          for (unsigned i = t * per_thread; i < (t + 1) * per_thread; i++) {
+            blocks[i] = sa.Allocate();
+            static_cast<Student *>(blocks[i])->ID = t;
+          }
+        } catch (const OAException &) {
+          failed[t] = 1;
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+    workers.clear();
+
+    // Every thread frees what the next one allocated, so frees reach shards other than the caller's
+    for (unsigned t = 0; t < shards; t++) {
+      workers.emplace_back([&sa, &blocks, &failed, t]() {
+        unsigned source = (t + 1) % shards;
+
+        try {
+          for (unsigned i = source * per_thread; i < (source + 1) * per_thread; i++) {
+            if (static_cast<Student *>(blocks[i])->ID != static_cast<long long>(source)) failed[t] = 1;
+            sa.Free(blocks[i]);
+          }
+        } catch (const OAException &) {
+          failed[t] = 1;
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+
+    for (unsigned t = 0; t < shards; t++)
+      if (failed[t]) cout << "Exception or overlapping blocks during TestShardedAllocator." << endl;
+
+    OAStats stats = sa.GetStats();
+    OAStats sum;
+    for (unsigned i = 0; i < sa.GetShardCount(); i++) {
+      OAStats shard = sa.GetShardStats(i);
+      sum.ObjectsInUse_ += shard.ObjectsInUse_;
+      sum.PagesInUse_ += shard.PagesInUse_;
+      sum.Allocations_ += shard.Allocations_;
+      sum.Deallocations_ += shard.Deallocations_;
+    }
+
+    cout << "Shards: " << sa.GetShardCount() << ", Objects in use: " << stats.ObjectsInUse_
+         << ", Allocs: " << stats.Allocations_ << ", Frees: " << stats.Deallocations_ << endl;
+    cout << "Shard stats add up: "
+         << (sum.ObjectsInUse_ == stats.ObjectsInUse_ && sum.PagesInUse_ == stats.PagesInUse_ &&
+                     sum.Allocations_ == stats.Allocations_ && sum.Deallocations_ == stats.Deallocations_
+                 ? "yes"
+                 : "no")
+         << endl;
+
+    unsigned pages = stats.PagesInUse_;
+    cout << "Every page freed: " << (sa.FreeEmptyPages() == pages ? "yes" : "no")
+         << ", Pages in use: " << sa.GetStats().PagesInUse_ << endl;
+
+    // The freed pages left the page map, a block from one of them is unknown now
+    try {
+      sa.Free(blocks[0]);
+    } catch (const OAException &e) {
+      cout << "Free on a freed page: " << (e.code() == OAException::E_BAD_BOUNDARY ? "bad boundary" : e.what())
+           << endl;
+    }
+
+    // The owning shard still runs its own debug checks
+    void *block = sa.Allocate();
+    sa.Free(block);
+    try {
+      sa.Free(block);
+    } catch (const OAException &e) {
+      cout << "Second free: " << (e.code() == OAException::E_MULTIPLE_FREE ? "multiple free" : e.what()) << endl;
+    }
+
+    // Without pages the shard that allocated an object is remembered, so every shard gets its own frees back
+    config.UseCPPMemManager_ = true;
+    ShardedObjectAllocator bypass(sizeof(Student), config, shards);
+    workers.clear();
+
+    for (unsigned t = 0; t < shards; t++) {
+      workers.emplace_back([&bypass, &blocks, &failed, t]() {
+        try {
+          for (unsigned i = t * per_thread; i < (t + 1) * per_thread; i++) blocks[i] = bypass.Allocate();
+        } catch (const OAException &) {
+          failed[t] = 1;
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+
+    for (void *object : blocks) bypass.Free(object);
+
+    bool balanced = true;
+    for (unsigned i = 0; i < bypass.GetShardCount(); i++) {
+      OAStats shard = bypass.GetShardStats(i);
+      balanced = balanced && shard.ObjectsInUse_ == 0 && shard.Allocations_ == shard.Deallocations_;
+    }
+    cout << "Bypass shards back to 0 in use: " << (balanced ? "yes" : "no") << endl;
+
+    try {
+      bypass.Free(blocks[0]);
+    } catch (const OAException &e) {
+      cout << "Bypass free of a freed object: " << (e.code() == OAException::E_BAD_BOUNDARY ? "bad boundary" : e.what())
+           << endl;
+    }
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestShardedAllocator." << endl;
+  }
+}
+
+// Position of a block counting from the oldest page, so two allocators that grew the same way can be compared
+size_t BlockPosition(const ObjectAllocator *oa, const void *block) {
+  const char *address = static_cast<const char *>(block);
+  size_t page_size = oa->GetStats().PageSize_;
+  size_t offset = 0;
+  size_t newer_pages = 0;
+  size_t pages = 0;
+
+  // The newest page is at the head of the page list
+  for (const GenericObject *page = static_cast<const GenericObject *>(oa->GetPageList()); page != nullptr;
+       page = page->Next, pages++) {
+    const char *start = reinterpret_cast<const char *>(page);
+
+    if (address >= start && address < start + page_size) {
+      offset = static_cast<size_t>(address - start);
+      newer_pages = pages;
+    }
+  }
+
+  return (pages - 1 - newer_pages) * page_size + offset;
+}
+
+void TestBatches() {
+  const unsigned count = 10;
+
+  try {
+    OAConfig config(false, 4, 3, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
+    ObjectAllocator singles(sizeof(Student), config);
+    ObjectAllocator batches(sizeof(Student), config);
+    void *single[count];
+    void *batch[count];
+
+    for (unsigned i = 0; i < count; i++) single[i] = singles.Allocate("single");
+    batches.AllocateBatch(count, batch, "batch");
+
+    bool same_order = true;
+    for (unsigned i = 0; i < count; i++)
+      if (BlockPosition(&singles, single[i]) != BlockPosition(&batches, batch[i])) same_order = false;
+
+    OAStats stats = batches.GetStats();
+    cout << "Same order as Allocate: " << (same_order ? "yes" : "no") << endl;
+    cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", Pages: " << stats.PagesInUse_
+         << endl;
+
+    // Only two objects are left before MaxPages_, so the batch takes none of them
+    void *more[3];
+    try {
+      batches.AllocateBatch(3, more, "batch");
+    } catch (const OAException &e) {
+      cout << "Batch past MaxPages_: " << (e.code() == OAException::E_NO_PAGES ? "no pages" : e.what()) << endl;
+    }
+
+    stats = batches.GetStats();
+    cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", Pages: " << stats.PagesInUse_
+         << endl;
+
+    // The repeated object stops the batch, the ones before it stay freed
+    void *twice[] = {batch[0], batch[1], batch[0]};
+    try {
+      batches.FreeBatch(twice, 3);
+    } catch (const OAException &e) {
+      cout << "Batch freeing an object twice: "
+           << (e.code() == OAException::E_MULTIPLE_FREE ? "multiple free" : e.what()) << endl;
+    }
+
+    cout << "In use: " << batches.GetStats().ObjectsInUse_ << endl;
+
+    batches.FreeBatch(batch + 2, count - 2);
+    singles.FreeBatch(single, count);
+    cout << "Leaks: " << batches.DumpMemoryInUse(DumpCallback2) + singles.DumpMemoryInUse(DumpCallback2) << endl;
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestBatches." << endl;
+  }
+}
+
+void PrintCacheStats(const ThreadCachedAllocator &tca) {
+  OAStats stats = tca.GetStats();
+  cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", Allocs: " << stats.Allocations_
+       << ", Frees: " << stats.Deallocations_ << ", Hits: " << stats.CacheHits_ << ", Refills: " << stats.CacheRefills_
+       << endl;
+}
+
+void TestThreadCache() {
+  try {
+    OAConfig config(false, 64, 0);
+    std::unique_ptr<ThreadCachedAllocator> tca(new ThreadCachedAllocator(sizeof(Student), config, 8));
+
+    // The client's view while a thread holds blocks in its magazine: cached blocks are free, not in use
+    std::promise<void> holding;
+    std::promise<void> checked;
+    std::thread holder([&tca, &holding, &checked]() {
+      void *blocks[5];
+      for (unsigned i = 0; i < 5; i++) blocks[i] = tca->Allocate();
+      tca->Free(blocks[3]);
+      tca->Free(blocks[4]);
+
+      holding.set_value();
+      checked.get_future().wait();
+
+      for (unsigned i = 0; i < 3; i++) tca->Free(blocks[i]);
+    });
+
+    holding.get_future().wait();
+    PrintCacheStats(*tca);
+    checked.set_value();
+    holder.join();
+
+    // The exiting thread flushed its magazine, so nothing keeps the page alive
+    PrintCacheStats(*tca);
+    cout << "Pages freed after the thread exited: " << tca->FreeEmptyPages() << endl;
+
+    // The next thread adopts the orphaned magazine, its counters carry on
+    std::thread adopter([&tca]() {
+      void *blocks[10];
+      for (unsigned i = 0; i < 10; i++) blocks[i] = tca->Allocate();
+      for (unsigned i = 0; i < 10; i++) tca->Free(blocks[i]);
+    });
+    adopter.join();
+    PrintCacheStats(*tca);
+
+    // A thread still holding a magazine of a destroyed allocator must neither flush into it nor mistake a new one
+    // for it
+    std::promise<void> cached;
+    std::promise<void> replaced;
+    std::thread survivor([&tca, &cached, &replaced]() {
+      tca->Free(tca->Allocate());
+
+      cached.set_value();
+      replaced.get_future().wait();
+
+      tca->Free(tca->Allocate());
+    });
+
+    cached.get_future().wait();
+    tca.reset(new ThreadCachedAllocator(sizeof(Student), config, 8));
+    replaced.set_value();
+    survivor.join();
+
+    PrintCacheStats(*tca);
+    cout << "Pages freed after the thread exited: " << tca->FreeEmptyPages() << endl;
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestThreadCache." << endl;
+  }
+}
+
+void TestOccupancyBitmap() {
+  try {
+    // The bitmap has to agree with the free list it replaces, with and without headers behind it
+    const OAConfig::HBLOCK_TYPE headers[] = {OAConfig::hbNone, OAConfig::hbBasic};
+
+    for (OAConfig::HBLOCK_TYPE header : headers) {
+      OAConfig config(false, 4, 0, true, 2, OAConfig::HeaderBlockInfo(header));
+      ObjectAllocator listed(sizeof(Student), config);
+      config.OccupancyBitmap_ = true;
+      ObjectAllocator mapped(sizeof(Student), config);
+
+      const unsigned count = 10;
+      void *pl[count];
+      void *pm[count];
+      for (unsigned i = 0; i < count; i++) {
+        pl[i] = listed.Allocate();
+        pm[i] = mapped.Allocate();
+      }
+      for (unsigned i = 0; i < count; i += 3) {
+        listed.Free(pl[i]);
+        mapped.Free(pm[i]);
+      }
+
+      cout << (header == OAConfig::hbNone ? "No headers" : "Basic headers") << ", list / bitmap" << endl;
+
+      int codes[2][2] = {{-1, -1}, {-1, -1}};
+      ObjectAllocator *allocators[2] = {&listed, &mapped};
+      void **blocks[2] = {pl, pm};
+      for (unsigned a = 0; a < 2; a++) {
+        try {
+          allocators[a]->Free(blocks[a][3]);
+        } catch (const OAException &e) {
+          codes[a][0] = e.code();
+        }
+        try {
+          allocators[a]->Free(static_cast<char *>(blocks[a][4]) + 1);
+        } catch (const OAException &e) {
+          codes[a][1] = e.code();
+        }
+      }
+      cout << "Second free: " << (codes[0][0] == OAException::E_MULTIPLE_FREE ? "multiple free" : "missed") << " / "
+           << (codes[1][0] == OAException::E_MULTIPLE_FREE ? "multiple free" : "missed") << endl;
+      cout << "Inside a block: " << (codes[0][1] == OAException::E_BAD_BOUNDARY ? "bad boundary" : "missed") << " / "
+           << (codes[1][1] == OAException::E_BAD_BOUNDARY ? "bad boundary" : "missed") << endl;
+
+      // Both dump the same blocks, in the same order
+      swept_blocks.clear();
+      unsigned leaks_listed = listed.DumpMemoryInUse(SweepCallback);
+      std::vector<const void *> dumped_listed = swept_blocks;
+      swept_blocks.clear();
+      unsigned leaks_mapped = mapped.DumpMemoryInUse(SweepCallback);
+
+      bool same = dumped_listed.size() == swept_blocks.size();
+      for (size_t i = 0; same && i < dumped_listed.size(); i++)
+        same = BlockPosition(&listed, dumped_listed[i]) == BlockPosition(&mapped, swept_blocks[i]);
+      cout << "Leaks: " << leaks_listed << " / " << leaks_mapped << ", same blocks: " << (same ? "yes" : "no") << endl;
+
+      // A page freed and allocated again starts with every bit clear
+      for (unsigned i = 0; i < count; i++) {
+        if (i % 3 == 0) continue;
+        listed.Free(pl[i]);
+        mapped.Free(pm[i]);
+      }
+      cout << "Pages freed: " << listed.FreeEmptyPages() << " / " << mapped.FreeEmptyPages() << endl;
+
+      void *fresh = mapped.Allocate();
+      mapped.Free(fresh);
+      try {
+        mapped.Free(fresh);
+      } catch (const OAException &e) {
+        cout << "Second free after trimming: "
+             << (e.code() == OAException::E_MULTIPLE_FREE ? "multiple free" : "wrong code") << endl;
+      }
+      cout << "Leaks after trimming: " << mapped.DumpMemoryInUse(DumpCallback2) << endl;
+    }
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestOccupancyBitmap." << endl;
+  }
+}
+
+void TestFullestPageFirst() {
+  try {
+    OAConfig config(false, 4, 0, true, 2);
+    config.PagePolicy_ = OAConfig::ppFullestPageFirst;
+    ObjectAllocator oa(sizeof(Student), config);
+
+    // Pages A, B and C, oldest first, then A keeps 1 block, B keeps 3 and C keeps 2
+    const unsigned count = 12;
+    void *blocks[count];
+    for (unsigned i = 0; i < count; i++) blocks[i] = oa.Allocate();
+
+    const unsigned freed[] = {0, 1, 2, 4, 8, 9};
+    for (unsigned index : freed) oa.Free(blocks[index]);
+
+    OAStats stats = oa.GetStats();
+    cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", Pages: " << stats.PagesInUse_
+         << endl;
+
+    // Each page's 4 blocks were allocated one after the other
+    auto page_of = [&blocks](const void *block) {
+      for (unsigned i = 0; i < count; i++)
+        if (blocks[i] == block) return "ABC"[i / 4];
+      return '?';
+    };
+
+    // GetFreeList is the free list of the page the next allocation comes from
+    unsigned listed = 0;
+    bool one_page = true;
+    for (const GenericObject *block = static_cast<const GenericObject *>(oa.GetFreeList()); block != nullptr;
+         block = block->Next, listed++) {
+      one_page = one_page && page_of(block) == 'B';
+    }
+    cout << "Free list: " << listed << " block(s), all on page B: " << (one_page ? "yes" : "no") << endl;
+
+    void *next = oa.Allocate();
+    cout << "Allocated from page " << page_of(next) << endl;
+
+    // With B full the fullest partial page is C, an emptied page is only used once no partial one is left
+    oa.Free(blocks[3]);
+    next = oa.Allocate();
+    cout << "Allocated from page " << page_of(next) << ", then " << page_of(oa.Allocate()) << endl;
+
+    try {
+      oa.Free(blocks[0]);
+    } catch (const OAException &e) {
+      cout << "Second free: " << (e.code() == OAException::E_MULTIPLE_FREE ? "multiple free" : "wrong code") << endl;
+    }
+
+    // Trimming drops the empty pages with their free lists, what is left keeps allocating
+    cout << "Pages freed: " << oa.FreeEmptyPages() << endl;
+    stats = oa.GetStats();
+    cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", Pages: " << stats.PagesInUse_
+         << endl;
+
+    std::vector<void *> more;
+    for (unsigned i = 0; i < 6; i++) more.push_back(oa.Allocate());
+    stats = oa.GetStats();
+    cout << "After 6 more, in use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_
+         << ", Pages: " << stats.PagesInUse_ << endl;
+    cout << "Leaks: " << oa.DumpMemoryInUse(DumpCallback2) << ", Corrupted: " << oa.ValidatePages(DumpCallback2)
+         << endl;
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestFullestPageFirst." << endl;
+  }
+}
+
+void TestRemoteDoubleFree() {
+  try {
+    OAConfig config(false, 4, 0, true, 2, OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+    config.RemoteFreeQueue_ = true;
+    ObjectAllocator oa(sizeof(Student), config);
+
+    const unsigned count = 3;
+    void *blocks[count];
+    for (unsigned i = 0; i < count; i++) blocks[i] = oa.Allocate();
+    oa.Free(blocks[0]);
+
+    // A block the owner already freed and an address inside a block, both freed by another thread
+    std::thread([&oa, &blocks] {
+      oa.Free(blocks[0]);
+      oa.Free(static_cast<char *>(blocks[1]) + 1);
+    }).join();
+
+    // Each drain drops the free that can't be applied and stops there
+    for (unsigned i = 0; i < 2; i++) {
+      try {
+        unsigned drained = oa.DrainRemoteFrees();
+        cout << "Drained: " << drained << endl;
+      } catch (const OAException &e) {
+        cout << "Drain: "
+             << (e.code() == OAException::E_MULTIPLE_FREE  ? "multiple free"
+                 : e.code() == OAException::E_BAD_BOUNDARY ? "bad boundary"
+                                                           : e.what())
+             << endl;
+      }
+    }
+
+    // The queued frees never touched the blocks, so the owner's free list is whole
+    unsigned listed = 0;
+    for (const GenericObject *block = static_cast<const GenericObject *>(oa.GetFreeList()); block != nullptr;
+         block = block->Next) {
+      listed++;
+    }
+
+    OAStats stats = oa.GetStats();
+    cout << "In use: " << stats.ObjectsInUse_ << ", Free: " << stats.FreeObjects_ << ", on the free list: " << listed
+         << endl;
+    cout << "Corrupted: " << oa.ValidatePages(DumpCallback2) << endl;
+
+    std::thread([&oa, &blocks] { oa.Free(blocks[1]); }).join();
+    cout << "Drained: " << oa.DrainRemoteFrees() << ", Leaks: " << oa.DumpMemoryInUse(DumpCallback2) << endl;
+  } catch (const OAException &e) {
+    if (SHOW_EXCEPTIONS)
+      cout << e.what() << endl;
+    else
+      cout << "Exception thrown in TestRemoteDoubleFree." << endl;
+  }
+}
+
 void StressFreeChecking(const OAConfig::HeaderBlockInfo &header) {
   unsigned objects;
   unsigned pages;
@@ -1863,6 +3117,121 @@ int main(int argc, char **argv) {
       TestFreeEmptyPages4();
       cout << endl;
       break;
+    case 22:
+      cout << "============================== Test stress using concurrent allocator..." << endl;
+      StressConcurrent(8);
+      cout << endl;
+      break;
+    case 23:
+      cout << "============================== Test stress using remote frees..." << endl;
+      StressRemoteFree(8);
+      cout << endl;
+      break;
+    case 24:
+      cout << "============================== Test compile-time allocator..." << endl;
+      TestStaticAllocator();
+      cout << endl;
+      break;
+    case 25:
+      cout << "============================== Test typed pool..." << endl;
+      TestTypedPool();
+      cout << endl;
+      break;
+    case 26:
+      cout << "============================== Test size classes..." << endl;
+      TestSizeClasses();
+      cout << endl;
+      break;
+    case 27:
+      cout << "============================== Test page providers..." << endl;
+      TestPageProviders();
+      cout << endl;
+      break;
+    case 28:
+      cout << "============================== Test aligned pages..." << endl;
+      TestAlignedPages();
+      cout << endl;
+      break;
+    case 29:
+      cout << "============================== Test lazy page formatting..." << endl;
+      TestLazyPages();
+      cout << endl;
+      break;
+    case 30:
+      cout << "============================== Test pattern kernels..." << endl;
+      TestPatternKernels();
+      cout << endl;
+      break;
+    case 31:
+      cout << "============================== Test sampled debug checks..." << endl;
+      TestSampledDebug();
+      cout << endl;
+      break;
+    case 32:
+      cout << "============================== Test parallel sweeps..." << endl;
+      TestParallelSweeps();
+      cout << endl;
+      break;
+    case 33:
+      cout << "============================== Test heap scrubber..." << endl;
+      TestScrubber();
+      cout << endl;
+      break;
+    case 34:
+      cout << "============================== Test header pool..." << endl;
+      TestHeaderPool();
+      cout << endl;
+      break;
+    case 35:
+      cout << "============================== Test label stats..." << endl;
+      TestLabelStats();
+      cout << endl;
+      break;
+    case 36:
+      cout << "============================== Test stats snapshots..." << endl;
+      TestStatsSnapshots();
+      cout << endl;
+      break;
+    case 37:
+      cout << "============================== Test flight recorder..." << endl;
+      TestFlightRecorder();
+      cout << endl;
+      break;
+    case 38:
+      cout << "============================== Test allocation trace..." << endl;
+      TestAllocationTrace();
+      cout << endl;
+      break;
+    case 39:
+      cout << "============================== Test sharded allocator..." << endl;
+      TestShardedAllocator();
+      cout << endl;
+      break;
+    case 40:
+      cout << "============================== Test batches..." << endl;
+      TestBatches();
+      cout << endl;
+      break;
+    case 41:
+      cout << "============================== Test thread cache..." << endl;
+      TestThreadCache();
+      cout << endl;
+      break;
+    case 42:
+      cout << "============================== Test occupancy bitmap..." << endl;
+      TestOccupancyBitmap();
+      cout << endl;
+      break;
+    case 43:
+      cout << "============================== Test fullest page first..." << endl;
+      TestFullestPageFirst();
+      cout << endl;
+      break;
+    case 44:
+      cout << "============================== Test remote double free..." << endl;
+      TestRemoteDoubleFree();
+      cout << endl;
+      break;
     default:
       cout << "============================== Students..." << endl;
       DoStudents(0, false);
@@ -0,0 +1,327 @@
+/**
+ * \file replay.cpp
+ * \author Edgar Jose Donoso Mansilla (e.donosomansilla)
+ * \course CS280
+ * \term Spring 2025
+ *
+ * \brief Replays an allocation trace (see AllocationTrace.h) against an ObjectAllocator configuration, the C++ memory
+ * manager and malloc, so ObjectsPerPage_ and MaxPages_ can be tuned from real workloads
+ */
+
+#include "AllocationTrace.h"
+#include "ObjectAllocator.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+  /*!
+    A loaded trace, checked so every replay sees a valid sequence
+  */
+  struct Trace {
+    std::vector<AllocationTrace::Record> records; //!< The allocations and frees, in order
+    std::vector<const char *> labels; //!< Indexed by label id
+    std::vector<std::string> label_storage; //!< Owns the label strings
+    size_t object_size; //!< From the trace
+    unsigned slots; //!< Object numbers used, the size of the replay table
+    unsigned most_live; //!< Peak of live objects in the trace
+    uint64_t allocations; //!< trAllocate records
+    uint64_t nanoseconds; //!< How long the capture took
+  };
+
+  /*!
+    What one replay measured
+  */
+  struct Result {
+    double seconds; //!< Time spent replaying
+    uint64_t replayed; //!< Records replayed before the end or the failure
+    unsigned most_objects; //!< MostObjects_ (or the peak of live objects)
+    unsigned pages; //!< Peak PagesInUse_, 0 if the back end has no pages
+    size_t page_size; //!< PageSize_
+    std::string error; //!< Why the replay stopped early, empty if it didn't
+  };
+
+  /*!
+   * \brief Loads and checks a trace
+   *
+   * \param path The trace file
+   * \param trace Receives the trace
+   * \return Whether the trace could be read and is consistent
+   */
+  bool trace_load(const char *path, Trace &trace) {
+    TraceReader reader(path);
+    std::vector<bool> live;
+    unsigned live_count = 0;
+
+    trace.object_size = reader.GetObjectSize();
+    trace.slots = 0;
+    trace.most_live = 0;
+    trace.allocations = 0;
+    trace.nanoseconds = 0;
+
+    AllocationTrace::Record record;
+    while (reader.Next(record)) {
+      if (record.Object_ >= live.size()) {
+        live.resize(record.Object_ + 1, false);
+      }
+
+      // Every object is allocated before it is freed, and freed before its number is reused
+      bool allocate = record.Type_ == AllocationTrace::trAllocate;
+      if (live[record.Object_] == allocate) {
+        std::cerr << "Record " << trace.records.size() << " " << (allocate ? "allocates" : "frees") << " object "
+                  << record.Object_ << " twice" << std::endl;
+        return false;
+      }
+
+      live[record.Object_] = allocate;
+      live_count = allocate ? live_count + 1 : live_count - 1;
+      trace.most_live = live_count > trace.most_live ? live_count : trace.most_live;
+      trace.allocations += allocate ? 1 : 0;
+      trace.nanoseconds += record.Nanoseconds_;
+      trace.records.push_back(record);
+    }
+
+    if (!reader.Good()) {
+      std::cerr << "Can't read the trace " << path << std::endl;
+      return false;
+    }
+
+    trace.slots = static_cast<unsigned>(live.size());
+
+    // The reader is done growing its label table, so the strings can be copied once
+    for (unsigned id = 0; id == 0 || reader.GetLabel(id) != nullptr; id++) {
+      trace.label_storage.push_back(id == 0 ? std::string() : reader.GetLabel(id));
+    }
+    for (unsigned id = 0; id < trace.label_storage.size(); id++) {
+      trace.labels.push_back(id == 0 ? nullptr : trace.label_storage[id].c_str());
+    }
+
+    return true;
+  }
+
+  /*!
+   * \brief Replays a trace against an allocator
+   *
+   * \param trace The trace
+   * \param config The configuration of the allocator
+   * \return The measurements
+   */
+  Result replay_allocator(const Trace &trace, const OAConfig &config) {
+    Result result = {0.0, 0, 0, 0, 0, std::string()};
+    std::vector<void *> objects(trace.slots, nullptr);
+
+    try {
+      ObjectAllocator allocator(trace.object_size, config);
+      auto start = std::chrono::steady_clock::now();
+
+      try {
+        for (const AllocationTrace::Record &record : trace.records) {
+          if (record.Type_ == AllocationTrace::trAllocate) {
+            objects[record.Object_] = allocator.Allocate(trace.labels[record.Label_]);
+          } else {
+            allocator.Free(objects[record.Object_]);
+            objects[record.Object_] = nullptr;
+          }
+
+          result.replayed++;
+        }
+
+      } catch (const OAException &e) {
+        result.error = e.what();
+      }
+
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      // Pages are never released during the replay, so the final count is the peak
+      OAStats stats = allocator.GetStats();
+      result.most_objects = stats.MostObjects_;
+      result.pages = config.UseCPPMemManager_ ? 0 : stats.PagesInUse_;
+      result.page_size = stats.PageSize_;
+
+      for (void *object : objects) {
+        if (object != nullptr) {
+          allocator.Free(object);
+        }
+      }
+
+    } catch (const OAException &e) {
+      result.error = e.what();
+    }
+
+    return result;
+  }
+
+  /*!
+   * \brief Replays a trace against malloc and free
+   *
+   * \param trace The trace
+   * \return The measurements
+   */
+  Result replay_malloc(const Trace &trace) {
+    Result result = {0.0, 0, 0, 0, 0, std::string()};
+    std::vector<void *> objects(trace.slots, nullptr);
+    unsigned live = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (const AllocationTrace::Record &record : trace.records) {
+      if (record.Type_ == AllocationTrace::trAllocate) {
+        objects[record.Object_] = malloc(trace.object_size);
+
+        if (objects[record.Object_] == nullptr) {
+          result.error = "malloc returned nullptr.";
+          break;
+        }
+
+        live++;
+        result.most_objects = live > result.most_objects ? live : result.most_objects;
+
+      } else {
+        free(objects[record.Object_]);
+        objects[record.Object_] = nullptr;
+        live--;
+      }
+
+      result.replayed++;
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (void *object : objects) {
+      free(object);
+    }
+
+    return result;
+  }
+
+  /*!
+   * \brief Prints the measurements of one back end
+   *
+   * \param name The back end
+   * \param result Its measurements
+   * \param records How many records the trace has
+   */
+  void print_result(const char *name, const Result &result, size_t records) {
+    double rate = result.seconds > 0.0 ? static_cast<double>(result.replayed) / result.seconds / 1e6 : 0.0;
+
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << rate << " Mops/s" << std::setw(10) << result.seconds * 1e3 << " ms"
+              << "  most objects " << result.most_objects;
+
+    if (result.pages != 0) {
+      std::cout << "  peak pages " << result.pages << " (" << result.pages * result.page_size << " bytes)";
+    }
+    std::cout << std::endl;
+
+    if (!result.error.empty()) {
+      std::cout << "            stopped after " << result.replayed << " of " << records << " records: " << result.error
+                << std::endl;
+    }
+  }
+
+  /*!
+   * \brief Prints how to call the program
+   *
+   * \param program The name of the program
+   */
+  void print_usage(const char *program) {
+    std::cerr << "Usage: " << program << " <trace> [options]\n"
+              << "  --objects-per-page=N  ObjectsPerPage_ (256)\n"
+              << "  --max-pages=N         MaxPages_ (0, unlimited)\n"
+              << "  --debug               DebugOn_\n"
+              << "  --pad=N               PadBytes_\n"
+              << "  --header=TYPE         none, basic, extended or external\n"
+              << "  --alignment=N         Alignment_\n"
+              << "  --bitmap              OccupancyBitmap_\n"
+              << "  --fullest-page-first  PagePolicy_ = ppFullestPageFirst\n"
+              << "  --aligned-pages       AlignedPages_\n"
+              << "  --lazy                LazyPageFormat_\n";
+  }
+
+  /*!
+   * \brief Applies a command line option to the configuration
+   *
+   * \param option The option
+   * \param config The configuration to change
+   * \return Whether the option is known
+   */
+  bool parse_option(const std::string &option, OAConfig &config) {
+    size_t equals = option.find('=');
+    std::string name = option.substr(0, equals);
+    std::string value = equals != std::string::npos ? option.substr(equals + 1) : std::string();
+    unsigned number = static_cast<unsigned>(std::strtoul(value.c_str(), nullptr, 10));
+
+    if (name == "--objects-per-page") {
+      config.ObjectsPerPage_ = number;
+    } else if (name == "--max-pages") {
+      config.MaxPages_ = number;
+    } else if (name == "--debug") {
+      config.DebugOn_ = true;
+    } else if (name == "--pad") {
+      config.PadBytes_ = number;
+    } else if (name == "--alignment") {
+      config.Alignment_ = number;
+    } else if (name == "--bitmap") {
+      config.OccupancyBitmap_ = true;
+    } else if (name == "--fullest-page-first") {
+      config.PagePolicy_ = OAConfig::ppFullestPageFirst;
+    } else if (name == "--aligned-pages") {
+      config.AlignedPages_ = true;
+    } else if (name == "--lazy") {
+      config.LazyPageFormat_ = true;
+    } else if (name == "--header") {
+      const char *types[] = {"none", "basic", "extended", "external"};
+
+      for (unsigned type = 0; type < 4; type++) {
+        if (value == types[type]) {
+          config.HBlockInfo_ = OAConfig::HeaderBlockInfo(static_cast<OAConfig::HBLOCK_TYPE>(type));
+          return true;
+        }
+      }
+      return false;
+    } else {
+      return false;
+    }
+
+    return true;
+  }
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  OAConfig config(false, 256, 0);
+  for (int i = 2; i < argc; i++) {
+    if (!parse_option(argv[i], config)) {
+      std::cerr << "Unknown option " << argv[i] << "\n";
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  Trace trace;
+  if (!trace_load(argv[1], trace)) {
+    return 1;
+  }
+
+  std::cout << "Trace " << argv[1] << ": " << trace.records.size() << " records (" << trace.allocations
+            << " allocations), object size " << trace.object_size << ", peak live " << trace.most_live
+            << ", captured over " << std::fixed << std::setprecision(2)
+            << static_cast<double>(trace.nanoseconds) / 1e6 << " ms" << std::endl;
+
+  OAConfig cpp_config(config);
+  cpp_config.UseCPPMemManager_ = true;
+
+  print_result("custom", replay_allocator(trace, config), trace.records.size());
+  print_result("new/delete", replay_allocator(trace, cpp_config), trace.records.size());
+  print_result("malloc", replay_malloc(trace), trace.records.size());
+
+  return 0;
+}